@@ -0,0 +1,74 @@
+#include "compressed.h"
+
+#include <cstring>
+
+namespace {
+
+// Returns position of the next 00 00 01 start code or size if there's none
+size_t next_start_code(const uint8_t* data, size_t size, size_t from) {
+	for (size_t i = from; i + 2 < size; ++i) {
+		if (!data[i] && !data[i+1] && data[i+2] == 1)
+			return i;
+	}
+	return size;
+}
+
+}
+
+bool parse_annexb_frame(const uint8_t* data, size_t size, bool hevc, std::vector<uint8_t>& parameter_sets) {
+	static const uint8_t start_code[] = {0, 0, 0, 1};
+	bool keyframe = false;
+	std::vector<uint8_t> sets;
+	size_t code = next_start_code(data, size, 0);
+	while (code < size) {
+		const size_t nal = code + 3;
+		const size_t next = next_start_code(data, size, nal);
+		// Trailing zeros belong to the following 4 byte start code
+		size_t end = next;
+		while (end > nal && !data[end-1]) --end;
+		if (nal < end) {
+			const uint8_t type = hevc ? (data[nal] >> 1) & 0x3F : data[nal] & 0x1F;
+			const bool parameter_set = hevc ? (type >= 32 && type <= 34) : (type == 7 || type == 8);
+			keyframe |= hevc ? (type >= 16 && type <= 21) : type == 5;
+			if (parameter_set) {
+				sets.insert(sets.end(), start_code, start_code + sizeof(start_code));
+				sets.insert(sets.end(), data + nal, data + end);
+			}
+		}
+		code = next;
+	}
+	if (!sets.empty())
+		parameter_sets.swap(sets);
+	return keyframe;
+}
+
+void build_ndi_compressed_packet(std::vector<uint8_t>& packet, uint32_t fourcc, const uint8_t* data, size_t size,
+		int64_t pts, bool keyframe, const std::vector<uint8_t>& extra_data) {
+	const size_t extra_size = keyframe ? extra_data.size() : 0;
+	packet.resize(sizeof(ndi_compressed_packet_t) + size + extra_size);
+	ndi_compressed_packet_t header;
+	header.version = ndi_compressed_packet_version_0;
+	header.fourCC = fourcc;
+	header.pts = pts;
+	header.dts = pts;
+	header.reserved = 0;
+	header.flags = keyframe ? ndi_compressed_packet_flags_keyframe : 0;
+	header.data_size = static_cast<uint32_t>(size);
+	header.extra_data_size = static_cast<uint32_t>(extra_size);
+	std::memcpy(packet.data(), &header, sizeof(header));
+	std::memcpy(packet.data() + sizeof(header), data, size);
+	if (extra_size)
+		std::memcpy(packet.data() + sizeof(header) + size, extra_data.data(), extra_size);
+}
+
+bool send_ndi_compressed_frame(const NDIlib_v5* lib, NDIlib_send_instance_t sender, NDIlib_video_frame_v2_t& frame,
+		uint32_t fourcc, const uint8_t* data, size_t size, int64_t pts,
+		std::vector<uint8_t>& packet, std::vector<uint8_t>& parameter_sets) {
+	const bool keyframe = parse_annexb_frame(data, size, fourcc == ndi_compressed_fourcc_hevc, parameter_sets);
+	build_ndi_compressed_packet(packet, fourcc, data, size, pts, keyframe, parameter_sets);
+	frame.FourCC = static_cast<NDIlib_FourCC_video_type_e>(fourcc);
+	frame.data_size_in_bytes = static_cast<int>(packet.size());
+	frame.p_data = packet.data();
+	lib->send_send_video_v2(sender, &frame);
+	return keyframe;
+}
@@ -0,0 +1,44 @@
+#ifndef _NDI_COMPRESSED_H_
+#define _NDI_COMPRESSED_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <Processing.NDI.Lib.h>
+
+// Compressed (NDI|HX) passthrough, it needs only the NDI headers, so it can be tested against a stub library.
+
+// Header of compressed (NDI|HX) video packets, as defined in the NDI Advanced SDK.
+// It's placed in p_data of the video frame, followed by the bitstream and extra data.
+#pragma pack(push, 1)
+struct ndi_compressed_packet_t {
+	uint32_t version;
+	uint32_t fourCC;
+	int64_t pts;
+	int64_t dts;
+	uint64_t reserved;
+	uint32_t flags;
+	uint32_t data_size;
+	uint32_t extra_data_size;
+};
+#pragma pack(pop)
+
+const uint32_t ndi_compressed_packet_version_0 = 44;
+const uint32_t ndi_compressed_packet_flags_keyframe = 1;
+const uint32_t ndi_compressed_fourcc_h264 = NDI_LIB_FOURCC('H', '2', '6', '4');
+const uint32_t ndi_compressed_fourcc_hevc = NDI_LIB_FOURCC('H', 'E', 'V', 'C');
+
+// Scans Annex-B stream, returns true for keyframes and stores found parameter sets (SPS/PPS/VPS)
+bool parse_annexb_frame(const uint8_t* data, size_t size, bool hevc, std::vector<uint8_t>& parameter_sets);
+// Fills packet with compressed packet header, the bitstream and extra data
+void build_ndi_compressed_packet(std::vector<uint8_t>& packet, uint32_t fourcc, const uint8_t* data, size_t size,
+		int64_t pts, bool keyframe, const std::vector<uint8_t>& extra_data);
+// Packs the Annex-B frame to packet and sends it, parameter sets are kept between the calls and repeated on keyframes.
+// Other fields of frame (resolution, timecode, metadata, frame rate) have to be set by the caller.
+// Returns true for keyframes.
+bool send_ndi_compressed_frame(const NDIlib_v5* lib, NDIlib_send_instance_t sender, NDIlib_video_frame_v2_t& frame,
+		uint32_t fourcc, const uint8_t* data, size_t size, int64_t pts,
+		std::vector<uint8_t>& packet, std::vector<uint8_t>& parameter_sets);
+
+#endif
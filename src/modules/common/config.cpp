@@ -0,0 +1,149 @@
+#include "config.h"
+
+#include "../../../libs/json.hpp"
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <fstream>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+namespace {
+
+const char* dicaffeine_config_dir = "/etc/dicaffeine";
+const char* dicaffeine_config_name = "dserver.json";
+const int watcher_poll_ms = 500;
+
+class dicaffeine_config_t {
+public:
+	~dicaffeine_config_t() {
+		stop_ = true;
+		if (watcher_.joinable())
+			watcher_.join();
+	}
+
+	bool get_extra_ips(std::string& extra_ips) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (!parsed_) {
+			found_ = parse(extra_ips_);
+			parsed_ = true;
+		}
+		extra_ips = extra_ips_;
+		return found_;
+	}
+
+	size_t watch(std::function<void(const std::string&)> callback) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (!parsed_) {
+			found_ = parse(extra_ips_);
+			parsed_ = true;
+		}
+		// Watcher runs only when somebody is interested
+		if (!watcher_.joinable())
+			watcher_ = std::thread(&dicaffeine_config_t::watcher, this);
+		callbacks_[++last_id_] = std::move(callback);
+		return last_id_;
+	}
+
+	void unwatch(size_t id) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		callbacks_.erase(id);
+	}
+
+private:
+	static bool parse(std::string& extra_ips) {
+		try	{
+			std::ifstream cfg_file(std::string(dicaffeine_config_dir) + "/" + dicaffeine_config_name);
+			nlohmann::json cfg_json;
+			cfg_file >> cfg_json;
+			extra_ips = cfg_json.value("extra_ips", "");
+			return true;
+		} catch(const std::exception&) {
+			return false;
+		}
+	}
+
+	void reload() {
+		std::string extra_ips;
+		const bool found = parse(extra_ips);
+		std::unique_lock<std::mutex> lock(mutex_);
+		found_ = found;
+		if (!found || extra_ips == extra_ips_)
+			return;
+		extra_ips_ = extra_ips;
+		for (auto& callback: callbacks_)
+			callback.second(extra_ips_);
+	}
+
+	void watcher() {
+		const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd < 0)
+			return;
+		int wd = -1;
+		alignas(inotify_event) char buffer[4096];
+		while (!stop_) {
+			// Directory missing at start (or removed later) is retried every poll interval, the file may be there once it appears.
+			// Watching the directory catches also files replaced by rename.
+			if (wd < 0) {
+				wd = inotify_add_watch(fd, dicaffeine_config_dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF | IN_MOVE_SELF);
+				if (wd >= 0)
+					reload();
+			}
+			pollfd pfd = {fd, POLLIN, 0};
+			if (poll(&pfd, 1, watcher_poll_ms) <= 0)
+				continue;
+			bool changed = false;
+			ssize_t len;
+			while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+				for (char* ptr = buffer; ptr < buffer + len; ) {
+					const auto event = reinterpret_cast<const inotify_event*>(ptr);
+					if (event->len && std::string(event->name) == dicaffeine_config_name)
+						changed = true;
+					if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+						if (wd >= 0 && !(event->mask & IN_IGNORED))
+							inotify_rm_watch(fd, wd);
+						wd = -1;
+					}
+					ptr += sizeof(inotify_event) + event->len;
+				}
+			}
+			if (changed)
+				reload();
+		}
+		if (wd >= 0)
+			inotify_rm_watch(fd, wd);
+		close(fd);
+	}
+
+	std::mutex mutex_;
+	bool parsed_ = false;
+	bool found_ = false;
+	std::string extra_ips_;
+	std::map<size_t, std::function<void(const std::string&)>> callbacks_;
+	size_t last_id_ = 0;
+	std::atomic<bool> stop_{false};
+	std::thread watcher_;
+};
+
+dicaffeine_config_t& get_config() {
+	static dicaffeine_config_t config;
+	return config;
+}
+
+}
+
+bool get_dicaffeine_extra_ips(std::string& extra_ips) {
+	return get_config().get_extra_ips(extra_ips);
+}
+
+size_t watch_dicaffeine_extra_ips(std::function<void(const std::string&)> callback) {
+	return get_config().watch(std::move(callback));
+}
+
+void unwatch_dicaffeine_extra_ips(size_t id) {
+	get_config().unwatch(id);
+}
@@ -0,0 +1,15 @@
+#ifndef _NDI_CONFIG_H_
+#define _NDI_CONFIG_H_
+
+#include <string>
+#include <functional>
+
+// Reads extra_ips from Dicaffeine configuration, returns false if the configuration is missing.
+// The file is parsed only once per process, later changes are picked up by the watcher.
+bool get_dicaffeine_extra_ips(std::string& extra_ips);
+// Registers callback called from the watcher thread whenever extra_ips changes, returns id of the callback
+size_t watch_dicaffeine_extra_ips(std::function<void(const std::string&)> callback);
+// Removes the callback, it's guaranteed not to be running after return
+void unwatch_dicaffeine_extra_ips(size_t id);
+
+#endif
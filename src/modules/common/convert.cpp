@@ -0,0 +1,806 @@
+#include "convert.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define NDI_CONVERT_X86 1
+// Undefined upper lanes in the AVX-512 intrinsics of GCC 12 are reported as uninitialized values
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#elif defined(__ARM_NEON)
+#define NDI_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Fixed point (13bit) coefficients for limited range YUV -> RGB
+struct yuv_to_rgb_t {
+	int32_t y, rv, gu, gv, bu;
+};
+// Fixed point (8bit) coefficients for RGB -> limited range YUV
+struct rgb_to_yuv_t {
+	int32_t yr, yg, yb, ur, ug, ub, vr, vg, vb;
+};
+
+const yuv_to_rgb_t yuv_to_rgb_bt601 = {9539, 13075, 3209, 6660, 16525};
+const yuv_to_rgb_t yuv_to_rgb_bt709 = {9539, 14686, 1747, 4366, 17305};
+const rgb_to_yuv_t rgb_to_yuv_bt601 = {66, 129, 25, -38, -74, 112, 112, -94, -18};
+const rgb_to_yuv_t rgb_to_yuv_bt709 = {47, 157, 16, -26, -87, 112, 112, -102, -10};
+
+const yuv_to_rgb_t& get_yuv_to_rgb(color_matrix_t matrix) {
+	return matrix == color_matrix_t::bt709 ? yuv_to_rgb_bt709 : yuv_to_rgb_bt601;
+}
+
+const rgb_to_yuv_t& get_rgb_to_yuv(color_matrix_t matrix) {
+	return matrix == color_matrix_t::bt709 ? rgb_to_yuv_bt709 : rgb_to_yuv_bt601;
+}
+
+inline uint8_t clip8(int32_t value) {
+	return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+// Scalar kernels, the vectorized ones compute exactly the same and leave the ends of the rows to them.
+// R and B are byte offsets of the red and blue components in the 32bit pixel, missing alpha is opaque.
+template<int R, int B>
+void yuv422_to_rgb32_scalar(const uint8_t* src, const uint8_t* alpha, uint8_t* dst, size_t width, const yuv_to_rgb_t& c) {
+	for (size_t i = 0; i < width / 2; ++i) {
+		const int32_t u  = src[4*i] - 128;
+		const int32_t y0 = (src[4*i+1] - 16) * c.y + 4096;
+		const int32_t v  = src[4*i+2] - 128;
+		const int32_t y1 = (src[4*i+3] - 16) * c.y + 4096;
+		const int32_t r = c.rv * v;
+		const int32_t g = -c.gu * u - c.gv * v;
+		const int32_t b = c.bu * u;
+		dst[8*i+R]   = clip8((y0 + r) >> 13);
+		dst[8*i+1]   = clip8((y0 + g) >> 13);
+		dst[8*i+B]   = clip8((y0 + b) >> 13);
+		dst[8*i+3]   = alpha ? alpha[2*i] : 255;
+		dst[8*i+4+R] = clip8((y1 + r) >> 13);
+		dst[8*i+5]   = clip8((y1 + g) >> 13);
+		dst[8*i+4+B] = clip8((y1 + b) >> 13);
+		dst[8*i+7]   = alpha ? alpha[2*i+1] : 255;
+	}
+}
+
+template<int R, int B>
+void rgb32_to_yuv422_scalar(const uint8_t* src, uint8_t* dst, size_t width, const rgb_to_yuv_t& c) {
+	for (size_t i = 0; i < width / 2; ++i) {
+		const int32_t r0 = src[8*i+R], g0 = src[8*i+1], b0 = src[8*i+B];
+		const int32_t r1 = src[8*i+4+R], g1 = src[8*i+5], b1 = src[8*i+4+B];
+		// Chroma is computed from the sum of both pixels, so the rounding constant is doubled
+		const int32_t r = r0 + r1, g = g0 + g1, b = b0 + b1;
+		dst[4*i]   = clip8(((c.ur * r + c.ug * g + c.ub * b + 256) >> 9) + 128);
+		dst[4*i+1] = clip8(((c.yr * r0 + c.yg * g0 + c.yb * b0 + 128) >> 8) + 16);
+		dst[4*i+2] = clip8(((c.vr * r + c.vg * g + c.vb * b + 256) >> 9) + 128);
+		dst[4*i+3] = clip8(((c.yr * r1 + c.yg * g1 + c.yb * b1 + 128) >> 8) + 16);
+	}
+}
+
+// STEP is distance between chroma samples, 1 for planar and 2 for semi-planar formats (v is then uv + 1)
+template<int STEP>
+void planes_to_yuv422_scalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, size_t width) {
+	for (size_t i = 0; i < width / 2; ++i) {
+		dst[4*i]   = u[STEP*i];
+		dst[4*i+1] = y[2*i];
+		dst[4*i+2] = v[STEP*i];
+		dst[4*i+3] = y[2*i+1];
+	}
+}
+
+template<int STEP>
+void yuv422_to_planes_scalar(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, size_t width) {
+	for (size_t i = 0; i < width / 2; ++i) {
+		u[STEP*i]  = (src0[4*i] + src1[4*i] + 1) >> 1;
+		v[STEP*i]  = (src0[4*i+2] + src1[4*i+2] + 1) >> 1;
+		y0[2*i]    = src0[4*i+1];
+		y0[2*i+1]  = src0[4*i+3];
+		y1[2*i]    = src1[4*i+1];
+		y1[2*i+1]  = src1[4*i+3];
+	}
+}
+
+void nv12_split_uv_scalar(const uint8_t* uv, uint8_t* u, uint8_t* v, size_t width) {
+	for (size_t i = 0; i < width; ++i) {
+		u[i] = uv[2*i];
+		v[i] = uv[2*i+1];
+	}
+}
+
+void p216_to_uyvy_scalar(const uint16_t* y, const uint16_t* uv, uint8_t* dst, size_t width) {
+	for (size_t i = 0; i < width / 2; ++i) {
+		dst[4*i]   = std::min((uv[2*i] + 128) >> 8, 255);
+		dst[4*i+1] = std::min((y[2*i] + 128) >> 8, 255);
+		dst[4*i+2] = std::min((uv[2*i+1] + 128) >> 8, 255);
+		dst[4*i+3] = std::min((y[2*i+1] + 128) >> 8, 255);
+	}
+}
+
+void uyvy_to_p216_scalar(const uint8_t* src, uint16_t* y, uint16_t* uv, size_t width) {
+	for (size_t i = 0; i < width / 2; ++i) {
+		uv[2*i]   = src[4*i] << 8;
+		y[2*i]    = src[4*i+1] << 8;
+		uv[2*i+1] = src[4*i+2] << 8;
+		y[2*i+1]  = src[4*i+3] << 8;
+	}
+}
+
+#ifdef NDI_CONVERT_X86
+
+// The x86 kernels keep one pixel in every 32bit lane, so the arithmetic is the same as in the scalar ones.
+// UYVY is loaded as 32bit pixel pairs (U Y0 V Y1), each of them copied to the lanes of both its pixels.
+// GCC jumps to the scalar rest of the row without vzeroupper, so the AVX kernels clear the upper halves themselves,
+// otherwise the SSE code running after them on the thread gets much slower.
+
+__attribute__((target("sse4.1")))
+inline __m128i clip8_sse41(__m128i value) {
+	return _mm_min_epi32(_mm_max_epi32(value, _mm_setzero_si128()), _mm_set1_epi32(255));
+}
+
+template<int R, int B>
+__attribute__((target("sse4.1")))
+void yuv422_to_rgb32_sse41(const uint8_t* src, const uint8_t* alpha, uint8_t* dst, size_t width, const yuv_to_rgb_t& c) {
+	const __m128i mask = _mm_set1_epi32(255);
+	size_t i = 0;
+	for (; i + 4 <= width; i += 4) {
+		const __m128i pairs = _mm_shuffle_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + 2*i)), 0x50);
+		const __m128i u = _mm_sub_epi32(_mm_and_si128(pairs, mask), _mm_set1_epi32(128));
+		const __m128i v = _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(pairs, 16), mask), _mm_set1_epi32(128));
+		// Luma of the odd pixels is the last byte of the pair
+		const __m128i luma = _mm_and_si128(_mm_blend_epi16(_mm_srli_epi32(pairs, 8), _mm_srli_epi32(pairs, 24), 0xcc), mask);
+		const __m128i y = _mm_add_epi32(_mm_mullo_epi32(_mm_sub_epi32(luma, _mm_set1_epi32(16)), _mm_set1_epi32(c.y)), _mm_set1_epi32(4096));
+		const __m128i r = _mm_srai_epi32(_mm_add_epi32(y, _mm_mullo_epi32(v, _mm_set1_epi32(c.rv))), 13);
+		const __m128i g = _mm_srai_epi32(_mm_sub_epi32(_mm_sub_epi32(y, _mm_mullo_epi32(u, _mm_set1_epi32(c.gu))),
+				_mm_mullo_epi32(v, _mm_set1_epi32(c.gv))), 13);
+		const __m128i b = _mm_srai_epi32(_mm_add_epi32(y, _mm_mullo_epi32(u, _mm_set1_epi32(c.bu))), 13);
+		__m128i a = _mm_set1_epi32(255);
+		if (alpha) {
+			int32_t values;
+			std::memcpy(&values, alpha + i, 4);
+			a = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(values));
+		}
+		const __m128i pixels = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(clip8_sse41(r), 8*R), _mm_slli_epi32(clip8_sse41(g), 8)),
+				_mm_or_si128(_mm_slli_epi32(clip8_sse41(b), 8*B), _mm_slli_epi32(a, 24)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4*i), pixels);
+	}
+	yuv422_to_rgb32_scalar<R, B>(src + 2*i, alpha ? alpha + i : nullptr, dst + 4*i, width - i, c);
+}
+
+// Chroma of the pixel pairs is computed in the lanes of the even pixels
+template<int R, int B>
+__attribute__((target("sse4.1")))
+void rgb32_to_yuv422_sse41(const uint8_t* src, uint8_t* dst, size_t width, const rgb_to_yuv_t& c) {
+	const __m128i mask = _mm_set1_epi32(255);
+	size_t i = 0;
+	for (; i + 4 <= width; i += 4) {
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4*i));
+		const __m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 8*R), mask);
+		const __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+		const __m128i b = _mm_and_si128(_mm_srli_epi32(pixels, 8*B), mask);
+		const __m128i y = clip8_sse41(_mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(r, _mm_set1_epi32(c.yr)),
+				_mm_mullo_epi32(g, _mm_set1_epi32(c.yg))), _mm_add_epi32(_mm_mullo_epi32(b, _mm_set1_epi32(c.yb)), _mm_set1_epi32(128))), 8),
+				_mm_set1_epi32(16)));
+		const __m128i rs = _mm_add_epi32(r, _mm_srli_epi64(r, 32));
+		const __m128i gs = _mm_add_epi32(g, _mm_srli_epi64(g, 32));
+		const __m128i bs = _mm_add_epi32(b, _mm_srli_epi64(b, 32));
+		const __m128i u = clip8_sse41(_mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(rs, _mm_set1_epi32(c.ur)),
+				_mm_mullo_epi32(gs, _mm_set1_epi32(c.ug))), _mm_add_epi32(_mm_mullo_epi32(bs, _mm_set1_epi32(c.ub)), _mm_set1_epi32(256))), 9),
+				_mm_set1_epi32(128)));
+		const __m128i v = clip8_sse41(_mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(rs, _mm_set1_epi32(c.vr)),
+				_mm_mullo_epi32(gs, _mm_set1_epi32(c.vg))), _mm_add_epi32(_mm_mullo_epi32(bs, _mm_set1_epi32(c.vb)), _mm_set1_epi32(256))), 9),
+				_mm_set1_epi32(128)));
+		const __m128i pairs = _mm_or_si128(_mm_or_si128(u, _mm_slli_epi32(y, 8)), _mm_or_si128(_mm_slli_epi32(v, 16), _mm_slli_epi32(_mm_srli_epi64(y, 32), 24)));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 2*i), _mm_shuffle_epi32(pairs, 0x08));
+	}
+	rgb32_to_yuv422_scalar<R, B>(src + 4*i, dst + 2*i, width - i, c);
+}
+
+template<int STEP>
+__attribute__((target("sse4.1")))
+void planes_to_yuv422_sse41(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, size_t width) {
+	size_t i = 0;
+	for (; i + 16 <= width; i += 16) {
+		const __m128i luma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i));
+		const __m128i chroma = STEP == 1
+				? _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + i/2)), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + i/2)))
+				: _mm_loadu_si128(reinterpret_cast<const __m128i*>(u + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2*i), _mm_unpacklo_epi8(chroma, luma));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2*i + 16), _mm_unpackhi_epi8(chroma, luma));
+	}
+	planes_to_yuv422_scalar<STEP>(y + i, u + STEP*i/2, v + STEP*i/2, dst + 2*i, width - i);
+}
+
+template<int STEP>
+__attribute__((target("sse4.1")))
+void yuv422_to_planes_sse41(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, size_t width) {
+	const __m128i luma = _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1);
+	// U and V of 4 pixel pairs after each other for planar output, interleaved for semi-planar one
+	const __m128i chroma = STEP == 1
+			? _mm_setr_epi8(0, 4, 8, 12, 2, 6, 10, 14, -1, -1, -1, -1, -1, -1, -1, -1)
+			: _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1);
+	size_t i = 0;
+	for (; i + 16 <= width; i += 16) {
+		const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + 2*i));
+		const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + 2*i + 16));
+		const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + 2*i));
+		const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + 2*i + 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(y0 + i), _mm_unpacklo_epi64(_mm_shuffle_epi8(a0, luma), _mm_shuffle_epi8(a1, luma)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(y1 + i), _mm_unpacklo_epi64(_mm_shuffle_epi8(b0, luma), _mm_shuffle_epi8(b1, luma)));
+		const __m128i c0 = _mm_shuffle_epi8(_mm_avg_epu8(a0, b0), chroma);
+		const __m128i c1 = _mm_shuffle_epi8(_mm_avg_epu8(a1, b1), chroma);
+		if (STEP == 1) {
+			const __m128i uv = _mm_unpacklo_epi32(c0, c1);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(u + i/2), uv);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(v + i/2), _mm_srli_si128(uv, 8));
+		} else {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(u + i), _mm_unpacklo_epi64(c0, c1));
+		}
+	}
+	yuv422_to_planes_scalar<STEP>(src0 + 2*i, src1 + 2*i, y0 + i, y1 + i, u + STEP*i/2, v + STEP*i/2, width - i);
+}
+
+__attribute__((target("sse4.1")))
+void nv12_split_uv_sse41(const uint8_t* uv, uint8_t* u, uint8_t* v, size_t width) {
+	const __m128i even = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i odd = _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1);
+	size_t i = 0;
+	for (; i + 16 <= width; i += 16) {
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + 2*i));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + 2*i + 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(u + i), _mm_unpacklo_epi64(_mm_shuffle_epi8(a, even), _mm_shuffle_epi8(b, even)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(v + i), _mm_unpacklo_epi64(_mm_shuffle_epi8(a, odd), _mm_shuffle_epi8(b, odd)));
+	}
+	nv12_split_uv_scalar(uv + 2*i, u + i, v + i, width - i);
+}
+
+// Saturating add keeps the rounding of the top values at 255, like the scalar kernel
+__attribute__((target("sse4.1")))
+void p216_to_uyvy_sse41(const uint16_t* y, const uint16_t* uv, uint8_t* dst, size_t width) {
+	const __m128i round = _mm_set1_epi16(128);
+	size_t i = 0;
+	for (; i + 8 <= width; i += 8) {
+		const __m128i luma = _mm_srli_epi16(_mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i)), round), 8);
+		const __m128i chroma = _mm_srli_epi16(_mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + i)), round), 8);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2*i), _mm_unpacklo_epi8(_mm_packus_epi16(chroma, chroma), _mm_packus_epi16(luma, luma)));
+	}
+	p216_to_uyvy_scalar(y + i, uv + i, dst + 2*i, width - i);
+}
+
+__attribute__((target("sse4.1")))
+void uyvy_to_p216_sse41(const uint8_t* src, uint16_t* y, uint16_t* uv, size_t width) {
+	const __m128i luma = _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i chroma = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 8 <= width; i += 8) {
+		const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2*i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(y + i), _mm_unpacklo_epi8(zero, _mm_shuffle_epi8(pixels, luma)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(uv + i), _mm_unpacklo_epi8(zero, _mm_shuffle_epi8(pixels, chroma)));
+	}
+	uyvy_to_p216_scalar(src + 2*i, y + i, uv + i, width - i);
+}
+
+__attribute__((target("avx2")))
+inline __m256i clip8_avx2(__m256i value) {
+	return _mm256_min_epi32(_mm256_max_epi32(value, _mm256_setzero_si256()), _mm256_set1_epi32(255));
+}
+
+template<int R, int B>
+__attribute__((target("avx2")))
+void yuv422_to_rgb32_avx2(const uint8_t* src, const uint8_t* alpha, uint8_t* dst, size_t width, const yuv_to_rgb_t& c) {
+	const __m256i mask = _mm256_set1_epi32(255);
+	const __m256i spread = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	size_t i = 0;
+	for (; i + 8 <= width; i += 8) {
+		const __m256i pairs = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2*i))), spread);
+		const __m256i u = _mm256_sub_epi32(_mm256_and_si256(pairs, mask), _mm256_set1_epi32(128));
+		const __m256i v = _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(pairs, 16), mask), _mm256_set1_epi32(128));
+		const __m256i luma = _mm256_and_si256(_mm256_blend_epi32(_mm256_srli_epi32(pairs, 8), _mm256_srli_epi32(pairs, 24), 0xaa), mask);
+		const __m256i y = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(luma, _mm256_set1_epi32(16)), _mm256_set1_epi32(c.y)),
+				_mm256_set1_epi32(4096));
+		const __m256i r = _mm256_srai_epi32(_mm256_add_epi32(y, _mm256_mullo_epi32(v, _mm256_set1_epi32(c.rv))), 13);
+		const __m256i g = _mm256_srai_epi32(_mm256_sub_epi32(_mm256_sub_epi32(y, _mm256_mullo_epi32(u, _mm256_set1_epi32(c.gu))),
+				_mm256_mullo_epi32(v, _mm256_set1_epi32(c.gv))), 13);
+		const __m256i b = _mm256_srai_epi32(_mm256_add_epi32(y, _mm256_mullo_epi32(u, _mm256_set1_epi32(c.bu))), 13);
+		const __m256i a = alpha ? _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(alpha + i))) : mask;
+		const __m256i pixels = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(clip8_avx2(r), 8*R), _mm256_slli_epi32(clip8_avx2(g), 8)),
+				_mm256_or_si256(_mm256_slli_epi32(clip8_avx2(b), 8*B), _mm256_slli_epi32(a, 24)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4*i), pixels);
+	}
+	_mm256_zeroupper();
+	yuv422_to_rgb32_scalar<R, B>(src + 2*i, alpha ? alpha + i : nullptr, dst + 4*i, width - i, c);
+}
+
+template<int R, int B>
+__attribute__((target("avx2")))
+void rgb32_to_yuv422_avx2(const uint8_t* src, uint8_t* dst, size_t width, const rgb_to_yuv_t& c) {
+	const __m256i mask = _mm256_set1_epi32(255);
+	const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+	size_t i = 0;
+	for (; i + 8 <= width; i += 8) {
+		const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4*i));
+		const __m256i r = _mm256_and_si256(_mm256_srli_epi32(pixels, 8*R), mask);
+		const __m256i g = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask);
+		const __m256i b = _mm256_and_si256(_mm256_srli_epi32(pixels, 8*B), mask);
+		const __m256i y = clip8_avx2(_mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(
+				_mm256_mullo_epi32(r, _mm256_set1_epi32(c.yr)), _mm256_mullo_epi32(g, _mm256_set1_epi32(c.yg))),
+				_mm256_add_epi32(_mm256_mullo_epi32(b, _mm256_set1_epi32(c.yb)), _mm256_set1_epi32(128))), 8), _mm256_set1_epi32(16)));
+		const __m256i rs = _mm256_add_epi32(r, _mm256_srli_epi64(r, 32));
+		const __m256i gs = _mm256_add_epi32(g, _mm256_srli_epi64(g, 32));
+		const __m256i bs = _mm256_add_epi32(b, _mm256_srli_epi64(b, 32));
+		const __m256i u = clip8_avx2(_mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(
+				_mm256_mullo_epi32(rs, _mm256_set1_epi32(c.ur)), _mm256_mullo_epi32(gs, _mm256_set1_epi32(c.ug))),
+				_mm256_add_epi32(_mm256_mullo_epi32(bs, _mm256_set1_epi32(c.ub)), _mm256_set1_epi32(256))), 9), _mm256_set1_epi32(128)));
+		const __m256i v = clip8_avx2(_mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(
+				_mm256_mullo_epi32(rs, _mm256_set1_epi32(c.vr)), _mm256_mullo_epi32(gs, _mm256_set1_epi32(c.vg))),
+				_mm256_add_epi32(_mm256_mullo_epi32(bs, _mm256_set1_epi32(c.vb)), _mm256_set1_epi32(256))), 9), _mm256_set1_epi32(128)));
+		const __m256i pairs = _mm256_or_si256(_mm256_or_si256(u, _mm256_slli_epi32(y, 8)),
+				_mm256_or_si256(_mm256_slli_epi32(v, 16), _mm256_slli_epi32(_mm256_srli_epi64(y, 32), 24)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2*i), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(pairs, even)));
+	}
+	_mm256_zeroupper();
+	rgb32_to_yuv422_scalar<R, B>(src + 4*i, dst + 2*i, width - i, c);
+}
+
+__attribute__((target("avx512f")))
+inline __m512i clip8_avx512(__m512i value) {
+	return _mm512_min_epi32(_mm512_max_epi32(value, _mm512_setzero_si512()), _mm512_set1_epi32(255));
+}
+
+template<int R, int B>
+__attribute__((target("avx512f")))
+void yuv422_to_rgb32_avx512(const uint8_t* src, const uint8_t* alpha, uint8_t* dst, size_t width, const yuv_to_rgb_t& c) {
+	const __m512i mask = _mm512_set1_epi32(255);
+	const __m512i spread = _mm512_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7);
+	size_t i = 0;
+	for (; i + 16 <= width; i += 16) {
+		const __m512i pairs = _mm512_permutexvar_epi32(spread, _mm512_castsi256_si512(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2*i))));
+		const __m512i u = _mm512_sub_epi32(_mm512_and_si512(pairs, mask), _mm512_set1_epi32(128));
+		const __m512i v = _mm512_sub_epi32(_mm512_and_si512(_mm512_srli_epi32(pairs, 16), mask), _mm512_set1_epi32(128));
+		const __m512i luma = _mm512_and_si512(_mm512_mask_blend_epi32(0xaaaa, _mm512_srli_epi32(pairs, 8), _mm512_srli_epi32(pairs, 24)), mask);
+		const __m512i y = _mm512_add_epi32(_mm512_mullo_epi32(_mm512_sub_epi32(luma, _mm512_set1_epi32(16)), _mm512_set1_epi32(c.y)),
+				_mm512_set1_epi32(4096));
+		const __m512i r = _mm512_srai_epi32(_mm512_add_epi32(y, _mm512_mullo_epi32(v, _mm512_set1_epi32(c.rv))), 13);
+		const __m512i g = _mm512_srai_epi32(_mm512_sub_epi32(_mm512_sub_epi32(y, _mm512_mullo_epi32(u, _mm512_set1_epi32(c.gu))),
+				_mm512_mullo_epi32(v, _mm512_set1_epi32(c.gv))), 13);
+		const __m512i b = _mm512_srai_epi32(_mm512_add_epi32(y, _mm512_mullo_epi32(u, _mm512_set1_epi32(c.bu))), 13);
+		const __m512i a = alpha ? _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(alpha + i))) : mask;
+		const __m512i pixels = _mm512_or_si512(_mm512_or_si512(_mm512_slli_epi32(clip8_avx512(r), 8*R), _mm512_slli_epi32(clip8_avx512(g), 8)),
+				_mm512_or_si512(_mm512_slli_epi32(clip8_avx512(b), 8*B), _mm512_slli_epi32(a, 24)));
+		_mm512_storeu_si512(dst + 4*i, pixels);
+	}
+	_mm256_zeroupper();
+	yuv422_to_rgb32_scalar<R, B>(src + 2*i, alpha ? alpha + i : nullptr, dst + 4*i, width - i, c);
+}
+
+template<int R, int B>
+__attribute__((target("avx512f")))
+void rgb32_to_yuv422_avx512(const uint8_t* src, uint8_t* dst, size_t width, const rgb_to_yuv_t& c) {
+	const __m512i mask = _mm512_set1_epi32(255);
+	size_t i = 0;
+	for (; i + 16 <= width; i += 16) {
+		const __m512i pixels = _mm512_loadu_si512(src + 4*i);
+		const __m512i r = _mm512_and_si512(_mm512_srli_epi32(pixels, 8*R), mask);
+		const __m512i g = _mm512_and_si512(_mm512_srli_epi32(pixels, 8), mask);
+		const __m512i b = _mm512_and_si512(_mm512_srli_epi32(pixels, 8*B), mask);
+		const __m512i y = clip8_avx512(_mm512_add_epi32(_mm512_srai_epi32(_mm512_add_epi32(_mm512_add_epi32(
+				_mm512_mullo_epi32(r, _mm512_set1_epi32(c.yr)), _mm512_mullo_epi32(g, _mm512_set1_epi32(c.yg))),
+				_mm512_add_epi32(_mm512_mullo_epi32(b, _mm512_set1_epi32(c.yb)), _mm512_set1_epi32(128))), 8), _mm512_set1_epi32(16)));
+		const __m512i rs = _mm512_add_epi32(r, _mm512_srli_epi64(r, 32));
+		const __m512i gs = _mm512_add_epi32(g, _mm512_srli_epi64(g, 32));
+		const __m512i bs = _mm512_add_epi32(b, _mm512_srli_epi64(b, 32));
+		const __m512i u = clip8_avx512(_mm512_add_epi32(_mm512_srai_epi32(_mm512_add_epi32(_mm512_add_epi32(
+				_mm512_mullo_epi32(rs, _mm512_set1_epi32(c.ur)), _mm512_mullo_epi32(gs, _mm512_set1_epi32(c.ug))),
+				_mm512_add_epi32(_mm512_mullo_epi32(bs, _mm512_set1_epi32(c.ub)), _mm512_set1_epi32(256))), 9), _mm512_set1_epi32(128)));
+		const __m512i v = clip8_avx512(_mm512_add_epi32(_mm512_srai_epi32(_mm512_add_epi32(_mm512_add_epi32(
+				_mm512_mullo_epi32(rs, _mm512_set1_epi32(c.vr)), _mm512_mullo_epi32(gs, _mm512_set1_epi32(c.vg))),
+				_mm512_add_epi32(_mm512_mullo_epi32(bs, _mm512_set1_epi32(c.vb)), _mm512_set1_epi32(256))), 9), _mm512_set1_epi32(128)));
+		const __m512i pairs = _mm512_or_si512(_mm512_or_si512(u, _mm512_slli_epi32(y, 8)),
+				_mm512_or_si512(_mm512_slli_epi32(v, 16), _mm512_slli_epi32(_mm512_srli_epi64(y, 32), 24)));
+		// Pairs are in the low halves of the 64bit lanes
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2*i), _mm512_cvtepi64_epi32(pairs));
+	}
+	_mm256_zeroupper();
+	rgb32_to_yuv422_scalar<R, B>(src + 4*i, dst + 2*i, width - i, c);
+}
+
+#endif
+
+#ifdef NDI_CONVERT_NEON
+
+// Saturating narrowing clips ((y + chroma) >> 13) of 8 pixels to 8 bits
+inline uint8x8_t clip8_neon(int32x4_t y_low, int32x4_t y_high, int32x4_t chroma_low, int32x4_t chroma_high) {
+	return vqmovun_s16(vcombine_s16(vqmovn_s32(vshrq_n_s32(vaddq_s32(y_low, chroma_low), 13)),
+			vqmovn_s32(vshrq_n_s32(vaddq_s32(y_high, chroma_high), 13))));
+}
+
+// Even and odd pixels of 8 pixel pairs as 16 pixels
+inline uint8x16_t zip_pixels_neon(uint8x8_t even, uint8x8_t odd) {
+	const uint8x8x2_t pixels = vzip_u8(even, odd);
+	return vcombine_u8(pixels.val[0], pixels.val[1]);
+}
+
+template<int R, int B>
+void yuv422_to_rgb32_neon(const uint8_t* src, const uint8_t* alpha, uint8_t* dst, size_t width, const yuv_to_rgb_t& c) {
+	size_t i = 0;
+	for (; i + 16 <= width; i += 16) {
+		// U, Y0, V and Y1 of 8 pixel pairs
+		const uint8x8x4_t pairs = vld4_u8(src + 2*i);
+		const int16x8_t u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(pairs.val[0])), vdupq_n_s16(128));
+		const int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(pairs.val[2])), vdupq_n_s16(128));
+		const int16x8_t y0 = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(pairs.val[1])), vdupq_n_s16(16));
+		const int16x8_t y1 = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(pairs.val[3])), vdupq_n_s16(16));
+		const int32x4_t round = vdupq_n_s32(4096);
+		const int32x4_t y0_low = vmlal_n_s16(round, vget_low_s16(y0), c.y), y0_high = vmlal_n_s16(round, vget_high_s16(y0), c.y);
+		const int32x4_t y1_low = vmlal_n_s16(round, vget_low_s16(y1), c.y), y1_high = vmlal_n_s16(round, vget_high_s16(y1), c.y);
+		// Chroma terms are shared by both pixels of the pair
+		const int32x4_t r_low = vmull_n_s16(vget_low_s16(v), c.rv), r_high = vmull_n_s16(vget_high_s16(v), c.rv);
+		const int32x4_t g_low = vmlal_n_s16(vmull_n_s16(vget_low_s16(u), -c.gu), vget_low_s16(v), -c.gv);
+		const int32x4_t g_high = vmlal_n_s16(vmull_n_s16(vget_high_s16(u), -c.gu), vget_high_s16(v), -c.gv);
+		const int32x4_t b_low = vmull_n_s16(vget_low_s16(u), c.bu), b_high = vmull_n_s16(vget_high_s16(u), c.bu);
+		uint8x16x4_t pixels;
+		pixels.val[R] = zip_pixels_neon(clip8_neon(y0_low, y0_high, r_low, r_high), clip8_neon(y1_low, y1_high, r_low, r_high));
+		pixels.val[1] = zip_pixels_neon(clip8_neon(y0_low, y0_high, g_low, g_high), clip8_neon(y1_low, y1_high, g_low, g_high));
+		pixels.val[B] = zip_pixels_neon(clip8_neon(y0_low, y0_high, b_low, b_high), clip8_neon(y1_low, y1_high, b_low, b_high));
+		pixels.val[3] = alpha ? vld1q_u8(alpha + i) : vdupq_n_u8(255);
+		vst4q_u8(dst + 4*i, pixels);
+	}
+	yuv422_to_rgb32_scalar<R, B>(src + 2*i, alpha ? alpha + i : nullptr, dst + 4*i, width - i, c);
+}
+
+// Luma fits to 16 bits, all its coefficients are positive
+inline uint8x8_t luma_neon(uint8x8_t r, uint8x8_t g, uint8x8_t b, const rgb_to_yuv_t& c) {
+	uint16x8_t sum = vmull_u8(r, vdup_n_u8(c.yr));
+	sum = vmlal_u8(sum, g, vdup_n_u8(c.yg));
+	sum = vmlal_u8(sum, b, vdup_n_u8(c.yb));
+	return vadd_u8(vrshrn_n_u16(sum, 8), vdup_n_u8(16));
+}
+
+// Chroma from sums of the pixel pairs
+inline uint8x8_t chroma_neon(int16x8_t r, int16x8_t g, int16x8_t b, int32_t cr, int32_t cg, int32_t cb) {
+	const int32x4_t round = vdupq_n_s32(256);
+	const int32x4_t low = vmlal_n_s16(vmlal_n_s16(vmlal_n_s16(round, vget_low_s16(r), cr), vget_low_s16(g), cg), vget_low_s16(b), cb);
+	const int32x4_t high = vmlal_n_s16(vmlal_n_s16(vmlal_n_s16(round, vget_high_s16(r), cr), vget_high_s16(g), cg), vget_high_s16(b), cb);
+	const int16x8_t value = vcombine_s16(vqmovn_s32(vshrq_n_s32(low, 9)), vqmovn_s32(vshrq_n_s32(high, 9)));
+	return vqmovun_s16(vaddq_s16(value, vdupq_n_s16(128)));
+}
+
+template<int R, int B>
+void rgb32_to_yuv422_neon(const uint8_t* src, uint8_t* dst, size_t width, const rgb_to_yuv_t& c) {
+	size_t i = 0;
+	for (; i + 16 <= width; i += 16) {
+		const uint8x8x4_t first = vld4_u8(src + 4*i);
+		const uint8x8x4_t second = vld4_u8(src + 4*i + 32);
+		// Components of the even pixels in val[0], of the odd ones in val[1]
+		const uint8x8x2_t r = vuzp_u8(first.val[R], second.val[R]);
+		const uint8x8x2_t g = vuzp_u8(first.val[1], second.val[1]);
+		const uint8x8x2_t b = vuzp_u8(first.val[B], second.val[B]);
+		const int16x8_t rs = vreinterpretq_s16_u16(vaddl_u8(r.val[0], r.val[1]));
+		const int16x8_t gs = vreinterpretq_s16_u16(vaddl_u8(g.val[0], g.val[1]));
+		const int16x8_t bs = vreinterpretq_s16_u16(vaddl_u8(b.val[0], b.val[1]));
+		uint8x8x4_t pairs;
+		pairs.val[0] = chroma_neon(rs, gs, bs, c.ur, c.ug, c.ub);
+		pairs.val[1] = luma_neon(r.val[0], g.val[0], b.val[0], c);
+		pairs.val[2] = chroma_neon(rs, gs, bs, c.vr, c.vg, c.vb);
+		pairs.val[3] = luma_neon(r.val[1], g.val[1], b.val[1], c);
+		vst4_u8(dst + 2*i, pairs);
+	}
+	rgb32_to_yuv422_scalar<R, B>(src + 4*i, dst + 2*i, width - i, c);
+}
+
+template<int STEP>
+void planes_to_yuv422_neon(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* dst, size_t width) {
+	size_t i = 0;
+	for (; i + 16 <= width; i += 16) {
+		const uint8x8x2_t luma = vld2_u8(y + i);
+		uint8x8x4_t pairs;
+		if (STEP == 1) {
+			pairs.val[0] = vld1_u8(u + i/2);
+			pairs.val[2] = vld1_u8(v + i/2);
+		} else {
+			const uint8x8x2_t chroma = vld2_u8(u + i);
+			pairs.val[0] = chroma.val[0];
+			pairs.val[2] = chroma.val[1];
+		}
+		pairs.val[1] = luma.val[0];
+		pairs.val[3] = luma.val[1];
+		vst4_u8(dst + 2*i, pairs);
+	}
+	planes_to_yuv422_scalar<STEP>(y + i, u + STEP*i/2, v + STEP*i/2, dst + 2*i, width - i);
+}
+
+template<int STEP>
+void yuv422_to_planes_neon(const uint8_t* src0, const uint8_t* src1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, size_t width) {
+	size_t i = 0;
+	for (; i + 16 <= width; i += 16) {
+		const uint8x8x4_t a = vld4_u8(src0 + 2*i);
+		const uint8x8x4_t b = vld4_u8(src1 + 2*i);
+		uint8x8x2_t luma;
+		luma.val[0] = a.val[1];
+		luma.val[1] = a.val[3];
+		vst2_u8(y0 + i, luma);
+		luma.val[0] = b.val[1];
+		luma.val[1] = b.val[3];
+		vst2_u8(y1 + i, luma);
+		uint8x8x2_t chroma;
+		chroma.val[0] = vrhadd_u8(a.val[0], b.val[0]);
+		chroma.val[1] = vrhadd_u8(a.val[2], b.val[2]);
+		if (STEP == 1) {
+			vst1_u8(u + i/2, chroma.val[0]);
+			vst1_u8(v + i/2, chroma.val[1]);
+		} else {
+			vst2_u8(u + i, chroma);
+		}
+	}
+	yuv422_to_planes_scalar<STEP>(src0 + 2*i, src1 + 2*i, y0 + i, y1 + i, u + STEP*i/2, v + STEP*i/2, width - i);
+}
+
+void nv12_split_uv_neon(const uint8_t* uv, uint8_t* u, uint8_t* v, size_t width) {
+	size_t i = 0;
+	for (; i + 16 <= width; i += 16) {
+		const uint8x16x2_t chroma = vld2q_u8(uv + 2*i);
+		vst1q_u8(u + i, chroma.val[0]);
+		vst1q_u8(v + i, chroma.val[1]);
+	}
+	nv12_split_uv_scalar(uv + 2*i, u + i, v + i, width - i);
+}
+
+// Saturating rounding shift is min((x + 128) >> 8, 255) of the scalar kernel
+void p216_to_uyvy_neon(const uint16_t* y, const uint16_t* uv, uint8_t* dst, size_t width) {
+	size_t i = 0;
+	for (; i + 16 <= width; i += 16) {
+		const uint16x8x2_t luma = vld2q_u16(y + i);
+		const uint16x8x2_t chroma = vld2q_u16(uv + i);
+		uint8x8x4_t pairs;
+		pairs.val[0] = vqrshrn_n_u16(chroma.val[0], 8);
+		pairs.val[1] = vqrshrn_n_u16(luma.val[0], 8);
+		pairs.val[2] = vqrshrn_n_u16(chroma.val[1], 8);
+		pairs.val[3] = vqrshrn_n_u16(luma.val[1], 8);
+		vst4_u8(dst + 2*i, pairs);
+	}
+	p216_to_uyvy_scalar(y + i, uv + i, dst + 2*i, width - i);
+}
+
+void uyvy_to_p216_neon(const uint8_t* src, uint16_t* y, uint16_t* uv, size_t width) {
+	size_t i = 0;
+	for (; i + 16 <= width; i += 16) {
+		const uint8x8x4_t pairs = vld4_u8(src + 2*i);
+		uint16x8x2_t values;
+		values.val[0] = vshll_n_u8(pairs.val[1], 8);
+		values.val[1] = vshll_n_u8(pairs.val[3], 8);
+		vst2q_u16(y + i, values);
+		values.val[0] = vshll_n_u8(pairs.val[0], 8);
+		values.val[1] = vshll_n_u8(pairs.val[2], 8);
+		vst2q_u16(uv + i, values);
+	}
+	uyvy_to_p216_scalar(src + 2*i, y + i, uv + i, width - i);
+}
+
+#endif
+
+struct convert_kernels_t {
+	void (*uyvy_to_bgra)(const uint8_t*, const uint8_t*, uint8_t*, size_t, const yuv_to_rgb_t&);
+	void (*uyvy_to_rgba)(const uint8_t*, const uint8_t*, uint8_t*, size_t, const yuv_to_rgb_t&);
+	void (*bgra_to_uyvy)(const uint8_t*, uint8_t*, size_t, const rgb_to_yuv_t&);
+	void (*rgba_to_uyvy)(const uint8_t*, uint8_t*, size_t, const rgb_to_yuv_t&);
+	void (*i420_to_uyvy)(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, size_t);
+	void (*nv12_to_uyvy)(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, size_t);
+	void (*uyvy_to_i420)(const uint8_t*, const uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, size_t);
+	void (*uyvy_to_nv12)(const uint8_t*, const uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, size_t);
+	void (*nv12_split_uv)(const uint8_t*, uint8_t*, uint8_t*, size_t);
+	void (*p216_to_uyvy)(const uint16_t*, const uint16_t*, uint8_t*, size_t);
+	void (*uyvy_to_p216)(const uint8_t*, uint16_t*, uint16_t*, size_t);
+	const char* name;
+};
+
+// Kernel sets supported by the CPU, the best one first. Conversions without arithmetic are bound by the memory,
+// so the wider sets use the SSE4.1 kernels for them.
+std::vector<convert_kernels_t> get_supported_kernels() {
+	std::vector<convert_kernels_t> sets;
+#ifdef NDI_CONVERT_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		sets.push_back({yuv422_to_rgb32_avx512<2, 0>, yuv422_to_rgb32_avx512<0, 2>, rgb32_to_yuv422_avx512<2, 0>, rgb32_to_yuv422_avx512<0, 2>,
+				planes_to_yuv422_sse41<1>, planes_to_yuv422_sse41<2>, yuv422_to_planes_sse41<1>, yuv422_to_planes_sse41<2>,
+				nv12_split_uv_sse41, p216_to_uyvy_sse41, uyvy_to_p216_sse41, "avx512"});
+	if (__builtin_cpu_supports("avx2"))
+		sets.push_back({yuv422_to_rgb32_avx2<2, 0>, yuv422_to_rgb32_avx2<0, 2>, rgb32_to_yuv422_avx2<2, 0>, rgb32_to_yuv422_avx2<0, 2>,
+				planes_to_yuv422_sse41<1>, planes_to_yuv422_sse41<2>, yuv422_to_planes_sse41<1>, yuv422_to_planes_sse41<2>,
+				nv12_split_uv_sse41, p216_to_uyvy_sse41, uyvy_to_p216_sse41, "avx2"});
+	if (__builtin_cpu_supports("sse4.1"))
+		sets.push_back({yuv422_to_rgb32_sse41<2, 0>, yuv422_to_rgb32_sse41<0, 2>, rgb32_to_yuv422_sse41<2, 0>, rgb32_to_yuv422_sse41<0, 2>,
+				planes_to_yuv422_sse41<1>, planes_to_yuv422_sse41<2>, yuv422_to_planes_sse41<1>, yuv422_to_planes_sse41<2>,
+				nv12_split_uv_sse41, p216_to_uyvy_sse41, uyvy_to_p216_sse41, "sse4.1"});
+#endif
+#ifdef NDI_CONVERT_NEON
+	sets.push_back({yuv422_to_rgb32_neon<2, 0>, yuv422_to_rgb32_neon<0, 2>, rgb32_to_yuv422_neon<2, 0>, rgb32_to_yuv422_neon<0, 2>,
+			planes_to_yuv422_neon<1>, planes_to_yuv422_neon<2>, yuv422_to_planes_neon<1>, yuv422_to_planes_neon<2>,
+			nv12_split_uv_neon, p216_to_uyvy_neon, uyvy_to_p216_neon, "neon"});
+#endif
+	sets.push_back({yuv422_to_rgb32_scalar<2, 0>, yuv422_to_rgb32_scalar<0, 2>, rgb32_to_yuv422_scalar<2, 0>, rgb32_to_yuv422_scalar<0, 2>,
+			planes_to_yuv422_scalar<1>, planes_to_yuv422_scalar<2>, yuv422_to_planes_scalar<1>, yuv422_to_planes_scalar<2>,
+			nv12_split_uv_scalar, p216_to_uyvy_scalar, uyvy_to_p216_scalar, "scalar"});
+	return sets;
+}
+
+convert_kernels_t& get_kernels() {
+	static convert_kernels_t kernels = get_supported_kernels().front();
+	return kernels;
+}
+
+void copy_plane(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, size_t line_size, size_t height) {
+	if (src_stride == line_size && dst_stride == line_size) {
+		std::memcpy(dst, src, line_size * height);
+		return;
+	}
+	for (size_t line = 0; line < height; ++line)
+		std::memcpy(dst + line * dst_stride, src + line * src_stride, line_size);
+}
+
+}
+
+color_matrix_t default_color_matrix(size_t width, size_t height) {
+	return (width > 1024 || height > 576) ? color_matrix_t::bt709 : color_matrix_t::bt601;
+}
+
+const char* convert_kernel_name() {
+	return get_kernels().name;
+}
+
+std::vector<std::string> get_convert_kernel_names() {
+	std::vector<std::string> names;
+	for (const auto& kernels: get_supported_kernels())
+		names.push_back(kernels.name);
+	return names;
+}
+
+bool set_convert_kernels(const std::string& name) {
+	for (const auto& kernels: get_supported_kernels()) {
+		if (name == kernels.name) {
+			get_kernels() = kernels;
+			return true;
+		}
+	}
+	return false;
+}
+
+void uyvy_to_bgra(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, size_t width, size_t height, color_matrix_t matrix) {
+	const auto& c = get_yuv_to_rgb(matrix);
+	const auto row = get_kernels().uyvy_to_bgra;
+	for (size_t line = 0; line < height; ++line)
+		row(src + line * src_stride, nullptr, dst + line * dst_stride, width, c);
+}
+
+void uyvy_to_rgba(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, size_t width, size_t height, color_matrix_t matrix) {
+	const auto& c = get_yuv_to_rgb(matrix);
+	const auto row = get_kernels().uyvy_to_rgba;
+	for (size_t line = 0; line < height; ++line)
+		row(src + line * src_stride, nullptr, dst + line * dst_stride, width, c);
+}
+
+void bgra_to_uyvy(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, size_t width, size_t height, color_matrix_t matrix) {
+	const auto& c = get_rgb_to_yuv(matrix);
+	const auto row = get_kernels().bgra_to_uyvy;
+	for (size_t line = 0; line < height; ++line)
+		row(src + line * src_stride, dst + line * dst_stride, width, c);
+}
+
+void rgba_to_uyvy(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, size_t width, size_t height, color_matrix_t matrix) {
+	const auto& c = get_rgb_to_yuv(matrix);
+	const auto row = get_kernels().rgba_to_uyvy;
+	for (size_t line = 0; line < height; ++line)
+		row(src + line * src_stride, dst + line * dst_stride, width, c);
+}
+
+void i420_to_uyvy(const uint8_t* src_y, size_t y_stride, const uint8_t* src_u, const uint8_t* src_v, size_t uv_stride,
+		uint8_t* dst, size_t dst_stride, size_t width, size_t height) {
+	const auto row = get_kernels().i420_to_uyvy;
+	// Chroma lines are repeated for both luma lines
+	for (size_t line = 0; line < height; ++line)
+		row(src_y + line * y_stride, src_u + (line / 2) * uv_stride, src_v + (line / 2) * uv_stride, dst + line * dst_stride, width);
+}
+
+void uyvy_to_i420(const uint8_t* src, size_t src_stride, uint8_t* dst_y, size_t y_stride, uint8_t* dst_u, uint8_t* dst_v, size_t uv_stride,
+		size_t width, size_t height) {
+	const auto row = get_kernels().uyvy_to_i420;
+	for (size_t line = 0; line < height; line += 2) {
+		// Last odd line is paired with itself
+		const size_t next = std::min(line + 1, height - 1);
+		row(src + line * src_stride, src + next * src_stride, dst_y + line * y_stride, dst_y + next * y_stride,
+				dst_u + (line / 2) * uv_stride, dst_v + (line / 2) * uv_stride, width);
+	}
+}
+
+void nv12_to_uyvy(const uint8_t* src_y, size_t y_stride, const uint8_t* src_uv, size_t uv_stride,
+		uint8_t* dst, size_t dst_stride, size_t width, size_t height) {
+	const auto row = get_kernels().nv12_to_uyvy;
+	for (size_t line = 0; line < height; ++line) {
+		const uint8_t* uv = src_uv + (line / 2) * uv_stride;
+		row(src_y + line * y_stride, uv, uv + 1, dst + line * dst_stride, width);
+	}
+}
+
+void uyvy_to_nv12(const uint8_t* src, size_t src_stride, uint8_t* dst_y, size_t y_stride, uint8_t* dst_uv, size_t uv_stride,
+		size_t width, size_t height) {
+	const auto row = get_kernels().uyvy_to_nv12;
+	for (size_t line = 0; line < height; line += 2) {
+		const size_t next = std::min(line + 1, height - 1);
+		uint8_t* uv = dst_uv + (line / 2) * uv_stride;
+		row(src + line * src_stride, src + next * src_stride, dst_y + line * y_stride, dst_y + next * y_stride, uv, uv + 1, width);
+	}
+}
+
+void nv12_split_uv(const uint8_t* src_uv, size_t uv_stride, uint8_t* dst_u, size_t u_stride, uint8_t* dst_v, size_t v_stride,
+		size_t width, size_t height) {
+	const auto row = get_kernels().nv12_split_uv;
+	for (size_t line = 0; line < height; ++line)
+		row(src_uv + line * uv_stride, dst_u + line * u_stride, dst_v + line * v_stride, width);
+}
+
+void uyva_split(const uint8_t* src, size_t src_stride, const uint8_t* src_alpha, size_t alpha_stride,
+		uint8_t* dst, size_t dst_stride, uint8_t* dst_alpha, size_t dst_alpha_stride, size_t width, size_t height) {
+	copy_plane(src, src_stride, dst, dst_stride, width * 2, height);
+	if (dst_alpha)
+		copy_plane(src_alpha, alpha_stride, dst_alpha, dst_alpha_stride, width, height);
+}
+
+void uyva_merge(const uint8_t* src, size_t src_stride, const uint8_t* src_alpha, size_t alpha_stride,
+		uint8_t* dst, size_t dst_stride, uint8_t* dst_alpha, size_t dst_alpha_stride, size_t width, size_t height) {
+	copy_plane(src, src_stride, dst, dst_stride, width * 2, height);
+	if (src_alpha) {
+		copy_plane(src_alpha, alpha_stride, dst_alpha, dst_alpha_stride, width, height);
+	} else {
+		// Missing alpha is opaque
+		for (size_t line = 0; line < height; ++line)
+			std::memset(dst_alpha + line * dst_alpha_stride, 255, width);
+	}
+}
+
+void uyva_to_bgra(const uint8_t* src, size_t src_stride, const uint8_t* src_alpha, size_t alpha_stride,
+		uint8_t* dst, size_t dst_stride, size_t width, size_t height, color_matrix_t matrix) {
+	const auto& c = get_yuv_to_rgb(matrix);
+	const auto row = get_kernels().uyvy_to_bgra;
+	for (size_t line = 0; line < height; ++line)
+		row(src + line * src_stride, src_alpha + line * alpha_stride, dst + line * dst_stride, width, c);
+}
+
+void uyva_to_rgba(const uint8_t* src, size_t src_stride, const uint8_t* src_alpha, size_t alpha_stride,
+		uint8_t* dst, size_t dst_stride, size_t width, size_t height, color_matrix_t matrix) {
+	const auto& c = get_yuv_to_rgb(matrix);
+	const auto row = get_kernels().uyvy_to_rgba;
+	for (size_t line = 0; line < height; ++line)
+		row(src + line * src_stride, src_alpha + line * alpha_stride, dst + line * dst_stride, width, c);
+}
+
+void p216_to_y16(const uint8_t* src_y, size_t y_stride, uint8_t* dst, size_t dst_stride, size_t width, size_t height) {
+	copy_plane(src_y, y_stride, dst, dst_stride, width * 2, height);
+}
+
+void y16_to_p216(const uint8_t* src, size_t src_stride, uint8_t* dst_y, size_t y_stride, uint8_t* dst_uv, size_t uv_stride,
+		size_t width, size_t height) {
+	copy_plane(src, src_stride, dst_y, y_stride, width * 2, height);
+	// Neutral chroma
+	for (size_t line = 0; line < height; ++line) {
+		auto uv = reinterpret_cast<uint16_t*>(dst_uv + line * uv_stride);
+		std::fill(uv, uv + width, static_cast<uint16_t>(0x8000));
+	}
+}
+
+void p216_to_uyvy(const uint8_t* src_y, size_t y_stride, const uint8_t* src_uv, size_t uv_stride,
+		uint8_t* dst, size_t dst_stride, size_t width, size_t height) {
+	const auto row = get_kernels().p216_to_uyvy;
+	for (size_t line = 0; line < height; ++line)
+		row(reinterpret_cast<const uint16_t*>(src_y + line * y_stride), reinterpret_cast<const uint16_t*>(src_uv + line * uv_stride),
+				dst + line * dst_stride, width);
+}
+
+void uyvy_to_p216(const uint8_t* src, size_t src_stride, uint8_t* dst_y, size_t y_stride, uint8_t* dst_uv, size_t uv_stride,
+		size_t width, size_t height) {
+	const auto row = get_kernels().uyvy_to_p216;
+	for (size_t line = 0; line < height; ++line)
+		row(src + line * src_stride, reinterpret_cast<uint16_t*>(dst_y + line * y_stride), reinterpret_cast<uint16_t*>(dst_uv + line * uv_stride),
+				width);
+}
@@ -0,0 +1,70 @@
+#ifndef _NDI_CONVERT_H_
+#define _NDI_CONVERT_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Pixel conversions between NDI FourCCs and yuri raw formats.
+// All strides are in bytes, widths are expected to be even for 4:2:x formats and heights for 4:2:0.
+// Row kernels are picked by the CPU features when the library is loaded (AVX-512, AVX2, SSE4.1 or NEON),
+// the scalar ones are used otherwise and for the ends of the rows. All of them give the same output.
+
+enum class color_matrix_t {
+	bt601,
+	bt709
+};
+
+// Returns matrix usually used for given resolution (BT.709 for HD and larger)
+color_matrix_t default_color_matrix(size_t width, size_t height);
+// Returns name of the instruction set used by the conversion kernels
+const char* convert_kernel_name();
+// Names of the instruction sets supported by the CPU, the one selected by default first
+std::vector<std::string> get_convert_kernel_names();
+// Switches the kernels to the named instruction set, returns false when the CPU doesn't support it.
+// Meant for tests and benchmarks, it mustn't be called while other threads convert.
+bool set_convert_kernels(const std::string& name);
+
+// UYVY <-> 32bit RGB, alpha is set to 255 when converting from UYVY and ignored otherwise
+void uyvy_to_bgra(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, size_t width, size_t height, color_matrix_t matrix);
+void uyvy_to_rgba(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, size_t width, size_t height, color_matrix_t matrix);
+void bgra_to_uyvy(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, size_t width, size_t height, color_matrix_t matrix);
+void rgba_to_uyvy(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride, size_t width, size_t height, color_matrix_t matrix);
+
+// Planar (I420/YV12) and semi-planar (NV12) 4:2:0 <-> UYVY, chroma is averaged vertically when subsampling
+void i420_to_uyvy(const uint8_t* src_y, size_t y_stride, const uint8_t* src_u, const uint8_t* src_v, size_t uv_stride,
+		uint8_t* dst, size_t dst_stride, size_t width, size_t height);
+void uyvy_to_i420(const uint8_t* src, size_t src_stride, uint8_t* dst_y, size_t y_stride, uint8_t* dst_u, uint8_t* dst_v, size_t uv_stride,
+		size_t width, size_t height);
+void nv12_to_uyvy(const uint8_t* src_y, size_t y_stride, const uint8_t* src_uv, size_t uv_stride,
+		uint8_t* dst, size_t dst_stride, size_t width, size_t height);
+void uyvy_to_nv12(const uint8_t* src, size_t src_stride, uint8_t* dst_y, size_t y_stride, uint8_t* dst_uv, size_t uv_stride,
+		size_t width, size_t height);
+
+// Splits interleaved UV plane of NV12 to separate U and V planes of I420, width is in chroma samples
+void nv12_split_uv(const uint8_t* src_uv, size_t uv_stride, uint8_t* dst_u, size_t u_stride, uint8_t* dst_v, size_t v_stride,
+		size_t width, size_t height);
+
+// UYVA is UYVY plane followed by 8bit alpha plane with its own stride
+void uyva_split(const uint8_t* src, size_t src_stride, const uint8_t* src_alpha, size_t alpha_stride,
+		uint8_t* dst, size_t dst_stride, uint8_t* dst_alpha, size_t dst_alpha_stride, size_t width, size_t height);
+void uyva_merge(const uint8_t* src, size_t src_stride, const uint8_t* src_alpha, size_t alpha_stride,
+		uint8_t* dst, size_t dst_stride, uint8_t* dst_alpha, size_t dst_alpha_stride, size_t width, size_t height);
+// UYVA -> BGRA/RGBA keeping the alpha
+void uyva_to_bgra(const uint8_t* src, size_t src_stride, const uint8_t* src_alpha, size_t alpha_stride,
+		uint8_t* dst, size_t dst_stride, size_t width, size_t height, color_matrix_t matrix);
+void uyva_to_rgba(const uint8_t* src, size_t src_stride, const uint8_t* src_alpha, size_t alpha_stride,
+		uint8_t* dst, size_t dst_stride, size_t width, size_t height, color_matrix_t matrix);
+
+// P216 (16bit luma plane followed by interleaved 16bit UV plane) <-> yuri formats.
+// Yuri has no 16bit 4:2:2 format, so luma is exchanged as y16 and full picture as 8bit UYVY.
+void p216_to_y16(const uint8_t* src_y, size_t y_stride, uint8_t* dst, size_t dst_stride, size_t width, size_t height);
+void y16_to_p216(const uint8_t* src, size_t src_stride, uint8_t* dst_y, size_t y_stride, uint8_t* dst_uv, size_t uv_stride,
+		size_t width, size_t height);
+void p216_to_uyvy(const uint8_t* src_y, size_t y_stride, const uint8_t* src_uv, size_t uv_stride,
+		uint8_t* dst, size_t dst_stride, size_t width, size_t height);
+void uyvy_to_p216(const uint8_t* src, size_t src_stride, uint8_t* dst_y, size_t y_stride, uint8_t* dst_uv, size_t uv_stride,
+		size_t width, size_t height);
+
+#endif
@@ -0,0 +1,90 @@
+#include "copy.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+void stream_copy_block(uint8_t* dst, const uint8_t* src, size_t size) {
+#if defined(__SSE2__)
+	// Head is copied normally to align the destination for streaming stores
+	const size_t head = std::min(size, (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15);
+	std::memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	size -= head;
+	const size_t blocks = size / 64;
+	for (size_t i = 0; i < blocks; ++i) {
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+		const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+		const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+		src += 64;
+		dst += 64;
+	}
+	std::memcpy(dst, src, size - blocks * 64);
+#else
+	std::memcpy(dst, src, size);
+#endif
+}
+
+void stream_fence() {
+#if defined(__SSE2__)
+	// Streaming stores are weakly ordered, they have to be visible before the frame is passed on
+	_mm_sfence();
+#endif
+}
+
+void stream_copy_lines(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride, size_t line_size, size_t height) {
+	if (dst_stride == line_size && src_stride == line_size) {
+		stream_copy_block(dst, src, line_size * height);
+	} else {
+		for (size_t line = 0; line < height; ++line)
+			stream_copy_block(dst + line * dst_stride, src + line * src_stride, line_size);
+	}
+	stream_fence();
+}
+
+}
+
+void stream_copy(void* dst, const void* src, size_t size) {
+	if (size < stream_copy_threshold) {
+		std::memcpy(dst, src, size);
+		return;
+	}
+	stream_copy_block(static_cast<uint8_t*>(dst), static_cast<const uint8_t*>(src), size);
+	stream_fence();
+}
+
+void stream_copy_plane(void* dst, size_t dst_stride, const void* src, size_t src_stride, size_t line_size, size_t height, row_workers_t* workers) {
+	auto dst_data = static_cast<uint8_t*>(dst);
+	auto src_data = static_cast<const uint8_t*>(src);
+	const size_t total = line_size * height;
+	if (total < stream_copy_threshold) {
+		if (dst_stride == line_size && src_stride == line_size) {
+			std::memcpy(dst_data, src_data, total);
+		} else {
+			for (size_t line = 0; line < height; ++line)
+				std::memcpy(dst_data + line * dst_stride, src_data + line * src_stride, line_size);
+		}
+		return;
+	}
+	if (!workers || workers->threads() < 2 || total < stream_copy_split_threshold) {
+		stream_copy_lines(dst_data, dst_stride, src_data, src_stride, line_size, height);
+		return;
+	}
+	// Blocks of whole lines of about stream_copy_threshold bytes, every block is fenced by the thread that copied it
+	workers->parallel_rows(height, std::max<size_t>(stream_copy_threshold / line_size, 1), [&](size_t start, size_t end) {
+		stream_copy_lines(dst_data + start * dst_stride, dst_stride, src_data + start * src_stride, src_stride, line_size, end - start);
+	});
+}
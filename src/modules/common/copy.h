@@ -0,0 +1,19 @@
+#ifndef _NDI_COPY_H_
+#define _NDI_COPY_H_
+
+#include <cstddef>
+
+class row_workers_t;
+
+// Copies smaller than this are left to memcpy, streaming stores pay off only when the data doesn't fit in cache
+const size_t stream_copy_threshold = 1 << 20;
+// Plane copies larger than this may be split between threads
+const size_t stream_copy_split_threshold = 8 << 20;
+
+// Copies large block with non-temporal stores, so the destination doesn't evict the cache
+void stream_copy(void* dst, const void* src, size_t size);
+// Copies height lines of line_size bytes between buffers with different strides.
+// Planes larger than stream_copy_split_threshold are split between the workers.
+void stream_copy_plane(void* dst, size_t dst_stride, const void* src, size_t src_stride, size_t line_size, size_t height, row_workers_t* workers = nullptr);
+
+#endif
@@ -0,0 +1,198 @@
+#include "frame_pool.h"
+
+#include "yuri/core/frame/raw_frame_types.h"
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t buffer_alignment = 64;
+const size_t hugepage_size = 2 << 20;
+const size_t default_max_idle_bytes = 512 << 20;
+
+struct pool_buffer_t {
+	uint8_t* data;
+	size_t size;
+	size_t allocated;
+	bool hugepages;
+};
+
+pool_buffer_t allocate_buffer(size_t size, bool hugepages) {
+	if (hugepages) {
+		const size_t allocated = (size + hugepage_size - 1) / hugepage_size * hugepage_size;
+		void* data = mmap(nullptr, allocated, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (data != MAP_FAILED) {
+			// Transparent huge pages, it's only a hint
+			madvise(data, allocated, MADV_HUGEPAGE);
+			return {static_cast<uint8_t*>(data), size, allocated, true};
+		}
+	}
+	void* data = nullptr;
+	if (posix_memalign(&data, buffer_alignment, size))
+		throw std::bad_alloc();
+	return {static_cast<uint8_t*>(data), size, size, false};
+}
+
+int current_numa_node() {
+#ifdef SYS_getcpu
+	unsigned cpu = 0, node = 0;
+	if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+		return static_cast<int>(node);
+#endif
+	return 0;
+}
+
+void free_buffer(const pool_buffer_t& buffer) {
+	if (buffer.hugepages)
+		munmap(buffer.data, buffer.allocated);
+	else
+		free(buffer.data);
+}
+
+class frame_pool_t {
+public:
+	// Buffers with and without huge pages are kept apart, so a request for huge pages doesn't get a normal buffer
+	using key_t = std::tuple<yuri::format_t, size_t, size_t, int, bool>;
+
+	frame_pool_t():max_idle_bytes_(default_max_idle_bytes),hugepages_(false),idle_bytes_(0),uses_(0),
+	hits_(0),misses_(0),dropped_(0) {
+		if (auto env_limit = std::getenv("NDI_FRAME_POOL_LIMIT"))
+			max_idle_bytes_ = std::strtoull(env_limit, nullptr, 10) << 20;
+		if (auto env_hugepages = std::getenv("NDI_FRAME_POOL_HUGEPAGES"))
+			hugepages_ = std::string(env_hugepages) == "1";
+	}
+
+	~frame_pool_t() {
+		for (auto& bucket: buckets_)
+			for (auto& buffer: bucket.second.buffers)
+				free_buffer(buffer);
+	}
+
+	// Returns whether new buffers requested with hugepages flag should use huge pages
+	bool use_hugepages(bool hugepages) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		return hugepages || hugepages_;
+	}
+
+	pool_buffer_t acquire(const key_t& key, size_t size) {
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			auto& bucket = buckets_[key];
+			bucket.last_used = ++uses_;
+			if (!bucket.buffers.empty()) {
+				auto buffer = bucket.buffers.back();
+				bucket.buffers.pop_back();
+				idle_bytes_ -= buffer.allocated;
+				hits_++;
+				return buffer;
+			}
+		}
+		misses_++;
+		return allocate_buffer(size, std::get<4>(key));
+	}
+
+	void release(const key_t& key, const pool_buffer_t& buffer) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		// Make room by dropping buffers of least recently used resolutions
+		while (idle_bytes_ + buffer.allocated > max_idle_bytes_ && evict_lru(key)) {}
+		if (idle_bytes_ + buffer.allocated > max_idle_bytes_) {
+			lock.unlock();
+			dropped_++;
+			free_buffer(buffer);
+			return;
+		}
+		buckets_[key].buffers.push_back(buffer);
+		idle_bytes_ += buffer.allocated;
+	}
+
+	void configure(size_t max_idle_bytes, bool hugepages) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		max_idle_bytes_ = max_idle_bytes;
+		hugepages_ = hugepages;
+		while (idle_bytes_ > max_idle_bytes_ && evict_lru(key_t{})) {}
+	}
+
+	frame_pool_stats_t get_stats() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		return {hits_, misses_, dropped_, idle_bytes_, max_idle_bytes_, hugepages_};
+	}
+
+private:
+	struct bucket_t {
+		std::vector<pool_buffer_t> buffers;
+		uint64_t last_used = 0;
+	};
+
+	// Has to be called with the mutex locked, returns false if there's nothing to evict
+	bool evict_lru(const key_t& keep) {
+		auto lru = buckets_.end();
+		for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+			if (it->first == keep || it->second.buffers.empty())
+				continue;
+			if (lru == buckets_.end() || it->second.last_used < lru->second.last_used)
+				lru = it;
+		}
+		if (lru == buckets_.end())
+			return false;
+		for (auto& buffer: lru->second.buffers) {
+			idle_bytes_ -= buffer.allocated;
+			free_buffer(buffer);
+			dropped_++;
+		}
+		buckets_.erase(lru);
+		return true;
+	}
+
+	std::mutex mutex_;
+	std::map<key_t, bucket_t> buckets_;
+	size_t max_idle_bytes_;
+	bool hugepages_;
+	size_t idle_bytes_;
+	uint64_t uses_;
+	std::atomic<size_t> hits_;
+	std::atomic<size_t> misses_;
+	std::atomic<size_t> dropped_;
+};
+
+// Frames keep the pool alive, so it can outlive this static
+std::shared_ptr<frame_pool_t> get_frame_pool() {
+	static auto pool = std::make_shared<frame_pool_t>();
+	return pool;
+}
+
+}
+
+yuri::core::pRawVideoFrame create_pooled_frame(yuri::format_t format, yuri::resolution_t resolution, bool hugepages) {
+	const auto& fi = yuri::core::raw_format::get_format_info(format);
+	// Planes are laid out one after another in a single buffer
+	size_t size = 0;
+	for (const auto& plane: fi.planes) {
+		const size_t bpp = plane.bit_depth.first / plane.bit_depth.second;
+		size += bpp * (resolution.width / plane.sub_x) / 8 * (resolution.height / plane.sub_y);
+	}
+	auto pool = get_frame_pool();
+	const frame_pool_t::key_t key {format, resolution.width, resolution.height, current_numa_node(), pool->use_hugepages(hugepages)};
+	auto buffer = pool->acquire(key, size);
+	return yuri::core::RawVideoFrame::create_empty(format, resolution, buffer.data, size,
+			[pool, key, buffer](uint8_t*) { pool->release(key, buffer); });
+}
+
+void configure_frame_pool(size_t max_idle_bytes, bool hugepages) {
+	get_frame_pool()->configure(max_idle_bytes, hugepages);
+}
+
+frame_pool_stats_t get_frame_pool_stats() {
+	return get_frame_pool()->get_stats();
+}
@@ -0,0 +1,27 @@
+#ifndef _NDI_FRAME_POOL_H_
+#define _NDI_FRAME_POOL_H_
+
+#include "yuri/core/frame/RawVideoFrame.h"
+
+// Pool of frame buffers bucketed by format and resolution, buffers return to the pool when their frame is released.
+// It's built as a shared library, so all modules of the process share a single pool.
+// Limits can be set with NDI_FRAME_POOL_LIMIT (idle megabytes kept) and NDI_FRAME_POOL_HUGEPAGES (1 to back buffers by huge pages).
+// Buffers are also bucketed by NUMA node of the allocating thread, so they're reused only on the node where they were faulted in.
+
+struct frame_pool_stats_t {
+	size_t hits;
+	size_t misses;
+	size_t dropped;
+	size_t idle_bytes;
+	size_t max_idle_bytes;
+	bool hugepages;
+};
+
+// Creates frame with pooled buffer, planes of multi-plane formats share one buffer.
+// New buffers use huge pages when requested here or globally.
+yuri::core::pRawVideoFrame create_pooled_frame(yuri::format_t format, yuri::resolution_t resolution, bool hugepages = false);
+// Sets maximal size of idle buffers kept in the pool and whether new buffers use huge pages
+void configure_frame_pool(size_t max_idle_bytes, bool hugepages);
+frame_pool_stats_t get_frame_pool_stats();
+
+#endif
@@ -0,0 +1,133 @@
+#include "thread_placement.h"
+
+#include "yuri/exception/Exception.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace {
+
+// From linux/mempolicy.h
+const int mpol_preferred = 1;
+
+std::vector<int> get_node_cpus(int node) {
+	std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+	std::string list;
+	if (!std::getline(cpulist, list))
+		return {};
+	return parse_cpu_list(list);
+}
+
+bool set_affinity(const std::vector<int>& cpus, std::string& error) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (auto cpu: cpus)
+		if (cpu >= 0 && cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &set);
+	if (auto ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+		error += std::string("Failed to set CPU affinity: ") + std::strerror(ret) + ". ";
+		return false;
+	}
+	return true;
+}
+
+int get_policy(const std::string& policy) {
+	if (policy == "fifo") return SCHED_FIFO;
+	if (policy == "rr") return SCHED_RR;
+	if (policy == "other" || policy.empty()) return SCHED_OTHER;
+	throw yuri::exception::Exception("Unknown scheduling policy \"" + policy + "\", use other, fifo or rr.");
+}
+
+bool set_scheduling(int policy, int priority, std::string& error) {
+	sched_param param;
+	param.sched_priority = policy == SCHED_OTHER ? 0 : priority;
+	if (auto ret = pthread_setschedparam(pthread_self(), policy, &param)) {
+		error += std::string("Failed to set scheduling policy: ") + std::strerror(ret);
+		error += ret == EPERM ? " (realtime scheduling needs CAP_SYS_NICE or rtprio limit). " : ". ";
+		return false;
+	}
+	return true;
+}
+
+bool set_memory_node(int node, std::string& error) {
+#ifdef SYS_set_mempolicy
+	// Preferred instead of bind, so a full node doesn't end in OOM
+	std::vector<unsigned long> mask(node / (8 * sizeof(unsigned long)) + 1, 0);
+	mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+	if (syscall(SYS_set_mempolicy, mpol_preferred, mask.data(), mask.size() * 8 * sizeof(unsigned long) + 1) != 0) {
+		error += std::string("Failed to set memory policy: ") + std::strerror(errno) + ". ";
+		return false;
+	}
+	return true;
+#else
+	(void)node;
+	error += "Memory policy is not supported on this platform. ";
+	return false;
+#endif
+}
+
+}
+
+std::vector<int> parse_cpu_list(const std::string& list) {
+	std::vector<int> cpus;
+	std::stringstream ss(list);
+	std::string item;
+	while (std::getline(ss, item, ',')) {
+		if (item.empty())
+			continue;
+		try {
+			const auto dash = item.find('-');
+			const int first = std::stoi(item.substr(0, dash));
+			const int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+			if (first < 0 || last < first)
+				throw yuri::exception::Exception("Wrong CPU range \"" + item + "\".");
+			for (int cpu = first; cpu <= last; ++cpu)
+				cpus.push_back(cpu);
+		} catch (const std::logic_error&) {
+			throw yuri::exception::Exception("Wrong CPU list \"" + list + "\".");
+		}
+	}
+	return cpus;
+}
+
+void check_thread_placement(const thread_placement_t& placement) {
+	parse_cpu_list(placement.cpus);
+	const int policy = get_policy(placement.policy);
+	if (policy != SCHED_OTHER && (placement.priority < sched_get_priority_min(policy) || placement.priority > sched_get_priority_max(policy)))
+		throw yuri::exception::Exception("Priority " + std::to_string(placement.priority) + " is out of range for policy \"" + placement.policy + "\".");
+}
+
+bool apply_thread_placement(const thread_placement_t& placement, std::string& error) {
+	bool ok = true;
+	if (!placement.name.empty())
+		pthread_setname_np(pthread_self(), placement.name.substr(0, 15).c_str());
+	auto cpus = parse_cpu_list(placement.cpus);
+	if (cpus.empty() && placement.numa_node >= 0) {
+		cpus = get_node_cpus(placement.numa_node);
+		if (cpus.empty()) {
+			error += "Unknown NUMA node " + std::to_string(placement.numa_node) + ". ";
+			ok = false;
+		}
+	}
+	if (!cpus.empty())
+		ok = set_affinity(cpus, error) && ok;
+	if (placement.numa_node >= 0)
+		ok = set_memory_node(placement.numa_node, error) && ok;
+	// Default policy is left untouched, so the inherited one stays
+	const int policy = get_policy(placement.policy);
+	if (policy != SCHED_OTHER)
+		ok = set_scheduling(policy, placement.priority, error) && ok;
+	return ok;
+}
+
+std::string get_placement_key(const thread_placement_t& placement) {
+	return placement.cpus + "/" + std::to_string(placement.numa_node) + "/" + placement.policy + "/"
+		+ std::to_string(placement.priority) + "/" + placement.name;
+}
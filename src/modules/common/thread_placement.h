@@ -0,0 +1,30 @@
+#ifndef _NDI_THREAD_PLACEMENT_H_
+#define _NDI_THREAD_PLACEMENT_H_
+
+#include <string>
+#include <vector>
+
+// Placement of a processing thread, empty values keep the defaults
+struct thread_placement_t {
+	// CPU list, e.g. "0-3,8"
+	std::string cpus;
+	// Memory of the thread is preferably allocated on this node, its CPUs are used when cpus are empty
+	int numa_node = -1;
+	// Scheduling policy [other/fifo/rr], priority (1-99) is used only for the realtime ones
+	std::string policy = "other";
+	int priority = 0;
+	// Name shown in top/ps, truncated to 15 characters
+	std::string name;
+};
+
+// Parses CPU list in the kernel format ("0-3,8"), throws on malformed list
+std::vector<int> parse_cpu_list(const std::string& list);
+// Throws if the placement isn't valid, so it can be checked before the thread starts
+void check_thread_placement(const thread_placement_t& placement);
+// Applies placement to the calling thread, threads started later inherit it.
+// Returns false and fills error if some of the settings couldn't be applied.
+bool apply_thread_placement(const thread_placement_t& placement, std::string& error);
+// Identifies the placement, threads with equal keys can be shared
+std::string get_placement_key(const thread_placement_t& placement);
+
+#endif
@@ -0,0 +1,152 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct job_t {
+	const std::function<void(size_t, size_t)>* fn;
+	size_t rows;
+	size_t block_rows;
+	std::atomic<size_t> next{0};
+	std::atomic<size_t> done{0};
+	// Time spent in fn by all the threads, in ns
+	std::atomic<int64_t> busy{0};
+	std::mutex mutex;
+	std::condition_variable finished;
+
+	// Takes blocks until there's nothing left
+	void work() {
+		size_t start;
+		while ((start = next.fetch_add(block_rows)) < rows) {
+			const size_t end = std::min(start + block_rows, rows);
+			const auto begin = std::chrono::steady_clock::now();
+			(*fn)(start, end);
+			// Added before the rows are marked as done, so the caller sees it when it returns
+			busy += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+			if (done.fetch_add(end - start) + end - start == rows) {
+				std::lock_guard<std::mutex> _(mutex);
+				finished.notify_all();
+			}
+		}
+	}
+};
+
+}
+
+class row_pool_t {
+public:
+	explicit row_pool_t(const std::function<void()>& init):init_(init) {}
+
+	~row_pool_t() {
+		{
+			std::lock_guard<std::mutex> _(mutex_);
+			stop_ = true;
+		}
+		queued_.notify_all();
+		for (auto& worker: workers_)
+			worker.join();
+	}
+
+	void run(const std::shared_ptr<job_t>& job, size_t helpers) {
+		{
+			std::lock_guard<std::mutex> _(mutex_);
+			while (workers_.size() < helpers)
+				workers_.emplace_back([this] { worker(); });
+			for (size_t i = 0; i < helpers; ++i)
+				jobs_.push_back(job);
+		}
+		if (helpers == 1)
+			queued_.notify_one();
+		else
+			queued_.notify_all();
+	}
+
+private:
+	void worker() {
+		if (init_)
+			init_();
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true) {
+			queued_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+			if (stop_)
+				return;
+			// Job is kept alive by the queue entry, even if the caller has already finished it
+			auto job = std::move(jobs_.front());
+			jobs_.pop_front();
+			lock.unlock();
+			job->work();
+			job.reset();
+			lock.lock();
+		}
+	}
+
+	std::function<void()> init_;
+	std::mutex mutex_;
+	std::condition_variable queued_;
+	std::deque<std::shared_ptr<job_t>> jobs_;
+	std::vector<std::thread> workers_;
+	bool stop_ = false;
+};
+
+std::shared_ptr<row_pool_t> get_row_pool(const std::string& key, const std::function<void()>& init) {
+	// Pools are released with their last user, the registry keeps only weak references
+	static std::mutex mutex;
+	static std::map<std::string, std::weak_ptr<row_pool_t>> pools;
+	std::lock_guard<std::mutex> _(mutex);
+	for (auto it = pools.begin(); it != pools.end();) {
+		if (it->second.expired())
+			it = pools.erase(it);
+		else
+			++it;
+	}
+	auto pool = pools[key].lock();
+	if (!pool) {
+		pool = std::make_shared<row_pool_t>(init);
+		pools[key] = pool;
+	}
+	return pool;
+}
+
+row_workers_t::row_workers_t(std::shared_ptr<row_pool_t> pool, size_t threads):pool_(std::move(pool)),threads_(threads),busy_(0.0) {
+}
+
+void row_workers_t::parallel_rows(size_t rows, size_t block_rows, const std::function<void(size_t, size_t)>& fn) {
+	if (!rows)
+		return;
+	block_rows = std::max<size_t>(block_rows, 1);
+	const size_t blocks = (rows + block_rows - 1) / block_rows;
+	const size_t threads = pool_ ? std::min(threads_, blocks) : 1;
+	if (threads < 2) {
+		const auto begin = std::chrono::steady_clock::now();
+		fn(0, rows);
+		busy_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		return;
+	}
+	auto job = std::make_shared<job_t>();
+	job->fn = &fn;
+	job->rows = rows;
+	job->block_rows = block_rows;
+	pool_->run(job, threads - 1);
+	job->work();
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->finished.wait(lock, [&] { return job->done.load() == rows; });
+	busy_ += job->busy.load() * 1e-9;
+}
+
+double row_workers_t::busy_time() const {
+	return busy_;
+}
+
+size_t row_workers_t::threads() const {
+	return pool_ ? std::max<size_t>(threads_, 1) : 1;
+}
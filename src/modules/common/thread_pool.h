@@ -0,0 +1,34 @@
+#ifndef _NDI_THREAD_POOL_H_
+#define _NDI_THREAD_POOL_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Worker threads sharing one placement
+class row_pool_t;
+
+// Returns the pool for the placement key, callers with the same key share the workers.
+// Workers of a new pool run init before taking any rows, so it can apply the placement the key stands for.
+std::shared_ptr<row_pool_t> get_row_pool(const std::string& key, const std::function<void()>& init);
+
+// Splits work of one frame between the calling thread and threads - 1 workers of the pool
+class row_workers_t {
+public:
+	row_workers_t(std::shared_ptr<row_pool_t> pool, size_t threads);
+
+	// Processes rows [0, rows) by fn(start, end) in blocks of block_rows rows. Blocks are taken from a shared
+	// counter, so faster threads take over the work of slower ones. Returns after all rows were processed.
+	void parallel_rows(size_t rows, size_t block_rows, const std::function<void(size_t, size_t)>& fn);
+	// Time spent in fn by all the threads (in seconds), i.e. the single threaded cost of the work done so far
+	double busy_time() const;
+	size_t threads() const;
+
+private:
+	std::shared_ptr<row_pool_t> pool_;
+	size_t threads_;
+	double busy_;
+};
+
+#endif
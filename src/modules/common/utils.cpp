@@ -1,11 +1,37 @@
 #include "utils.h"
 
+#include "yuri/core/frame/compressed_frame_types.h"
+#include "yuri/exception/InitializationFailed.h"
+
 #include <stdlib.h>
 #include <dlfcn.h>
+#include <cstring>
+#include <cmath>
+#include <mutex>
 
 using namespace yuri::core::raw_format;
 
-const NDIlib_v5* load_ndi_library(std::string ndi_path) {
+namespace {
+
+// NDI runtime shared by all nodes in the process
+struct ndi_runtime_t {
+	std::mutex mutex;
+	std::string path;
+	void* handle = nullptr;
+	const NDIlib_v5* library = nullptr;
+	size_t references = 0;
+};
+
+ndi_runtime_t& get_ndi_runtime() {
+	static ndi_runtime_t runtime;
+	return runtime;
+}
+
+// Has to be called with the runtime mutex locked
+const NDIlib_v5* load_ndi_library_locked(ndi_runtime_t& runtime, std::string ndi_path) {
+	// Library is loaded only once, later paths are ignored
+	if (runtime.library)
+		return runtime.library;
 	// Check if we know the path
 	if (!ndi_path.length()) {
 		auto env_ndi_path = std::getenv("NDI_PATH");
@@ -16,12 +42,62 @@ const NDIlib_v5* load_ndi_library(std::string ndi_path) {
 	const NDIlib_v5* (*NDIlib_v5_load)(void) = nullptr;
 	if (hNDIlib)
 		*((void**)&NDIlib_v5_load) = dlsym(hNDIlib, "NDIlib_v5_load");
-	if (!NDIlib_v5_load) {
+	const NDIlib_v5* library = NDIlib_v5_load ? NDIlib_v5_load() : nullptr;
+	if (!library || !library->initialize || !library->destroy) {
 		if (hNDIlib)
 			dlclose(hNDIlib);
-		throw yuri::exception::Exception("Could not load NDI library version 5 from location: \""+ndi_path+"\", please download the correct library version.");
+		throw yuri::exception::InitializationFailed("Could not load NDI library version 5 from location: \""+ndi_path+"\", please download the correct library version.");
 	}
-	return NDIlib_v5_load();
+	runtime.path = ndi_path;
+	runtime.handle = hNDIlib;
+	runtime.library = library;
+	return library;
+}
+
+const NDIlib_v5* acquire_ndi_library(const std::string& ndi_path) {
+	auto& runtime = get_ndi_runtime();
+	std::unique_lock<std::mutex> lock(runtime.mutex);
+	auto library = load_ndi_library_locked(runtime, ndi_path);
+	if (!runtime.references) {
+		if (!library->initialize())
+			throw yuri::exception::InitializationFailed("Failed to initialize NDI library.");
+	}
+	runtime.references++;
+	return library;
+}
+
+void release_ndi_library() {
+	auto& runtime = get_ndi_runtime();
+	std::unique_lock<std::mutex> lock(runtime.mutex);
+	if (!runtime.references)
+		return;
+	if (!--runtime.references)
+		runtime.library->destroy();
+}
+
+}
+
+const NDIlib_v5* load_ndi_library(std::string ndi_path) {
+	auto& runtime = get_ndi_runtime();
+	std::unique_lock<std::mutex> lock(runtime.mutex);
+	return load_ndi_library_locked(runtime, ndi_path);
+}
+
+ndi_library_handle::ndi_library_handle(const std::string& ndi_path) {
+	acquire(ndi_path);
+}
+
+ndi_library_handle::~ndi_library_handle() {
+	if (library_)
+		release_ndi_library();
+}
+
+const NDIlib_v5* ndi_library_handle::acquire(const std::string& ndi_path) {
+	auto library = acquire_ndi_library(ndi_path);
+	if (library_)
+		release_ndi_library();
+	library_ = library;
+	return library_;
 }
 
 std::map<NDIlib_FourCC_type_e, yuri::format_t> ndi_to_yuri_pixmap = {
@@ -56,4 +132,91 @@ NDIlib_FourCC_type_e yuri_format_to_ndi(yuri::format_t fmt) {
 	auto it = yuri_to_ndi_pixmap.find(fmt);
 	if (it == yuri_to_ndi_pixmap.end()) throw yuri::exception::Exception("No NDI format found.");
 	return it->second;
-}
\ No newline at end of file
+}
+void fps_to_ndi_rate(double fps, int& numerator, int& denominator) {
+	// Pick the closer one of integer and NTSC rate, if it's close enough
+	const double integer = std::round(fps);
+	const double ntsc_numerator = std::round(fps * 1.001);
+	const double ntsc = ntsc_numerator / 1.001;
+	const double tolerance = 0.005 * fps;
+	const bool prefer_integer = std::abs(fps - integer) <= std::abs(fps - ntsc);
+	if (prefer_integer && std::abs(fps - integer) < tolerance) {
+		numerator = static_cast<int>(integer);
+		denominator = 1;
+	} else if (!prefer_integer && std::abs(fps - ntsc) < tolerance) {
+		numerator = static_cast<int>(ntsc_numerator) * 1000;
+		denominator = 1001;
+	} else {
+		numerator = static_cast<int>(std::round(fps * 1000));
+		denominator = 1000;
+	}
+}
+
+namespace {
+
+const size_t min_estimate_intervals = 8;
+// Relative change of the rate taken without waiting
+const double rate_change_tolerance = 0.01;
+// Frames a close estimate has to be stable for before it's taken
+const size_t rate_change_frames = 60;
+
+}
+
+frame_rate_estimator::frame_rate_estimator(size_t window)
+:window_(window),sum_(0),has_last_(false),numerator_(0),denominator_(1),candidate_numerator_(0),candidate_denominator_(1),
+candidate_frames_(0) {
+}
+
+bool frame_rate_estimator::add_frame(const yuri::timestamp_t& timestamp) {
+	if (!has_last_) {
+		last_ = timestamp;
+		has_last_ = true;
+		return false;
+	}
+	const int64_t interval = (timestamp - last_).value;
+	last_ = timestamp;
+	if (interval <= 0 || interval > 1000000) {
+		// Discontinuity in the stream, start over
+		intervals_.clear();
+		sum_ = 0;
+		return false;
+	}
+	intervals_.push_back(interval);
+	sum_ += interval;
+	if (intervals_.size() > window_) {
+		sum_ -= intervals_.front();
+		intervals_.pop_front();
+	}
+	// Rough estimate is good enough to start with, it gets refined as the window fills
+	if (intervals_.size() < min_estimate_intervals)
+		return false;
+	int numerator, denominator;
+	fps_to_ndi_rate(1e6 * intervals_.size() / sum_, numerator, denominator);
+	if (numerator == numerator_ && denominator == denominator_) {
+		candidate_frames_ = 0;
+		return false;
+	}
+	if (numerator_ > 0) {
+		const double current = static_cast<double>(numerator_) / denominator_;
+		const double estimate = static_cast<double>(numerator) / denominator;
+		if (std::abs(estimate - current) <= rate_change_tolerance * current) {
+			if (numerator != candidate_numerator_ || denominator != candidate_denominator_) {
+				candidate_numerator_ = numerator;
+				candidate_denominator_ = denominator;
+				candidate_frames_ = 0;
+			}
+			if (++candidate_frames_ < rate_change_frames)
+				return false;
+		}
+	}
+	candidate_frames_ = 0;
+	numerator_ = numerator;
+	denominator_ = denominator;
+	return true;
+}
+
+uint32_t yuri_compressed_format_to_ndi(yuri::format_t fmt) {
+	if (fmt == yuri::core::compressed_frame::h264) return ndi_compressed_fourcc_h264;
+	if (fmt == yuri::core::compressed_frame::h265) return ndi_compressed_fourcc_hevc;
+	return 0;
+}
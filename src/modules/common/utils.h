@@ -6,17 +6,68 @@
 #include <string>
 #include <iostream>
 #include <exception>
+#include <deque>
 
 #include "yuri/exception/Exception.h"
 #include "yuri/core/utils/new_types.h"
+#include "yuri/core/utils/time_types.h"
 #include "yuri/core/frame/raw_frame_types.h"
 
 #include <Processing.NDI.Lib.h>
 
+#include "compressed.h"
+
 typedef unsigned char byte;
 
+// Loads NDI library, it's loaded only once per process and never unloaded
 const NDIlib_v5* load_ndi_library(std::string ndi_path = "");
+
+// Reference to the initialized NDI library, the library is destroyed when the last handle releases it.
+// Members of this type release the reference even if the constructor of their node throws.
+class ndi_library_handle {
+public:
+	ndi_library_handle() = default;
+	explicit ndi_library_handle(const std::string& ndi_path);
+	~ndi_library_handle();
+	ndi_library_handle(const ndi_library_handle&) = delete;
+	ndi_library_handle& operator=(const ndi_library_handle&) = delete;
+	// Loads and initializes the library, throws InitializationFailed when it fails
+	const NDIlib_v5* acquire(const std::string& ndi_path = "");
+	const NDIlib_v5* get() const { return library_; }
+private:
+	const NDIlib_v5* library_ = nullptr;
+};
 yuri::format_t ndi_format_to_yuri (NDIlib_FourCC_type_e fmt);
 NDIlib_FourCC_type_e yuri_format_to_ndi(yuri::format_t fmt);
 
+// Converts fps to exact NDI rational rate, recognizes NTSC (N*1000/1001) rates
+void fps_to_ndi_rate(double fps, int& numerator, int& denominator);
+
+// Estimates exact frame rate from frame timestamps.
+// Estimates close to the current rate (like 30 and 30000/1001) replace it only after they're stable for a number of frames,
+// so a jittery source doesn't flip the signalled rate. Bigger changes are taken right away.
+class frame_rate_estimator {
+public:
+	frame_rate_estimator(size_t window = 120);
+	// Returns true when the estimated rate has changed
+	bool add_frame(const yuri::timestamp_t& timestamp);
+	bool valid() const { return numerator_ > 0; }
+	int numerator() const { return numerator_; }
+	int denominator() const { return denominator_; }
+private:
+	size_t window_;
+	std::deque<int64_t> intervals_;
+	int64_t sum_;
+	yuri::timestamp_t last_;
+	bool has_last_;
+	int numerator_;
+	int denominator_;
+	int candidate_numerator_;
+	int candidate_denominator_;
+	size_t candidate_frames_;
+};
+
+// Returns compressed NDI FourCC for yuri compressed format or 0 if not supported
+uint32_t yuri_compressed_format_to_ndi(yuri::format_t fmt);
+
 #endif
\ No newline at end of file
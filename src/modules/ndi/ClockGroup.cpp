@@ -0,0 +1,68 @@
+/*
+ * ClockGroup.cpp
+ */
+
+#include "ClockGroup.h"
+
+#include <thread>
+#include <cmath>
+
+namespace yuri {
+namespace ndi {
+
+namespace {
+
+std::mutex groups_mutex;
+std::map<std::string, std::weak_ptr<ClockGroup>> groups;
+
+}
+
+std::shared_ptr<ClockGroup> ClockGroup::join(const std::string& name) {
+	std::unique_lock<std::mutex> lock(groups_mutex);
+	auto group = groups[name].lock();
+	if (!group) {
+		group = std::make_shared<ClockGroup>(name);
+		groups[name] = group;
+	}
+	return group;
+}
+
+ClockGroup::ClockGroup(const std::string& name)
+:name_(name),epoch_(std::chrono::steady_clock::now()),numerator_(0),denominator_(1) {
+	using namespace std::chrono;
+	base_timecode_ = duration_cast<duration<int64_t, std::ratio<1, 10000000>>>(system_clock::now().time_since_epoch()).count();
+}
+
+int64_t ClockGroup::tick_time(uint64_t tick, int64_t units) const {
+	// Split to whole seconds and the rest to avoid overflow
+	const int64_t periods = static_cast<int64_t>(tick) * denominator_;
+	return (periods / numerator_) * units + ((periods % numerator_) * units) / numerator_;
+}
+
+int64_t ClockGroup::wait_tick(uint64_t& tick, int numerator, int denominator) {
+	using namespace std::chrono;
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (!numerator_ && numerator > 0 && denominator > 0) {
+			numerator_ = numerator;
+			denominator_ = denominator;
+		} else if (!numerator_) {
+			numerator_ = 30000;
+			denominator_ = 1001;
+		}
+	}
+	const int64_t second = 1000000000;
+	const int64_t elapsed = duration_cast<nanoseconds>(steady_clock::now() - epoch_).count();
+	// First tick that is not in the past, the estimate is corrected using exact tick times
+	uint64_t next = static_cast<uint64_t>(std::ceil(static_cast<long double>(elapsed) * numerator_ / (static_cast<long double>(denominator_) * second)));
+	while (next > 0 && tick_time(next - 1, second) >= elapsed) --next;
+	while (tick_time(next, second) < elapsed) ++next;
+	if (next <= tick)
+		next = tick + 1;
+	tick = next;
+	std::this_thread::sleep_until(epoch_ + nanoseconds(tick_time(tick, second)));
+	return base_timecode_ + tick_time(tick, 10000000);
+}
+
+}
+}
@@ -0,0 +1,51 @@
+/*
+ * ClockGroup.h
+ */
+
+#ifndef CLOCKGROUP_H_
+#define CLOCKGROUP_H_
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+namespace yuri {
+namespace ndi {
+
+/*!
+ * Clock shared by outputs in one process. All members compute ticks from
+ * the same epoch, so sends released on a tick are frame aligned and get
+ * the same timecode.
+ */
+class ClockGroup {
+public:
+	// Returns group with the given name, it's created by the first member
+	static std::shared_ptr<ClockGroup> join(const std::string& name);
+
+	ClockGroup(const std::string& name);
+	const std::string& get_name() const { return name_; }
+	/*!
+	 * Sleeps until the next tick after the tick passed in and updates it.
+	 * The rate is set by the first call in the group, later calls use it.
+	 * Returns timecode of the tick (in 100ns units).
+	 */
+	int64_t wait_tick(uint64_t& tick, int numerator, int denominator);
+private:
+	// Time of the tick since epoch in units per second
+	int64_t tick_time(uint64_t tick, int64_t units) const;
+
+	std::string name_;
+	std::mutex mutex_;
+	std::chrono::steady_clock::time_point epoch_;
+	int64_t base_timecode_;
+	int numerator_;
+	int denominator_;
+};
+
+}
+}
+
+#endif /* CLOCKGROUP_H_ */
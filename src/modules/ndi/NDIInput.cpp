@@ -15,7 +15,10 @@
 #include "yuri/core/utils.h"
 
 #include "../common/utils.h"
-#include "../../../libs/json.hpp"
+#include "../common/config.h"
+#include "../common/convert.h"
+#include "../common/copy.h"
+#include "../common/frame_pool.h"
 
 #include <cassert>
 
@@ -27,7 +30,7 @@ using namespace std::chrono;
 
 namespace {
 
-const char*  extra_ips_config_file = "/etc/dicaffeine/dserver.json";
+std::atomic<bool> config_warning_logged(false);
 
 float get_event_float(const event::pBasicEvent& event) {
 	switch(event->get_type()) {
@@ -54,36 +57,54 @@ core::Parameters NDIInput::configure() {
 	p["reference_level"]["The audio reference level in dB. [-20dB - 20dB]"]=false;
 	p["event_time"]["How often will be events fired."]=1.0;
 	p["ndi_path"]["Path where to find the NDI libraries, if empty, env variable NDI_PATH is used."]="";
+	p["cpus"]["CPUs for the capture thread (e.g. \"0-3,8\"), empty for no restriction."]="";
+	p["numa_node"]["NUMA node for the capture thread and its frames, -1 to disable."]=-1;
+	p["hugepages"]["Set to true to allocate frames in huge pages."]=false;
+	p["frame_pool_limit"]["Megabytes of idle frames kept for reuse by all nodes of the process, 0 to keep the default (512 or NDI_FRAME_POOL_LIMIT)."]=0;
+	p["frame_pool_hugepages"]["Set to true to allocate frames of all nodes of the process in huge pages."]=false;
+	p["policy"]["Scheduling policy of the capture thread [other/fifo/rr]."]="other";
+	p["priority"]["Realtime priority of the capture thread (1-99), used with fifo and rr policies."]=0;
+	p["thread_name"]["Name of the capture thread, audio thread gets _a suffix, empty to keep the default."]="";
+	p["audio_cpus"]["CPUs for the audio thread, empty for the same as the capture thread."]="";
+	p["audio_policy"]["Scheduling policy of the audio thread [other/fifo/rr]."]="other";
+	p["audio_priority"]["Realtime priority of the audio thread (1-99), it should be higher than video."]=0;
 	return p;
 }
 
 NDIInput::NDIInput(log::Log &log_,core::pwThreadBase parent, const core::Parameters &parameters)
 :core::IOThread(log_,parent,0,1,std::string("NDIInput")),
 event::BasicEventProducer(log),event::BasicEventConsumer(log),
-stream_(""),backup_(""),format_("fastest"),ndi_path_(""),audio_enabled_(false),lowres_enabled_(false),
-reference_level_(0),audio_pipe_(-1),stream_fail_(0),event_time_(1_s),ptz_supported_(false),
+stream_(""),backup_(""),extra_ips_changed_(false),extra_ips_watch_(0),format_("fastest"),ndi_path_(""),audio_enabled_(false),lowres_enabled_(false),
+reference_level_(0),audio_pipe_(-1),hugepages_(false),frame_pool_limit_(0),frame_pool_hugepages_(false),stream_fail_(0),event_time_(1_s),ptz_supported_(false),
 last_pan_val_(0),last_tilt_val_(0),last_pan_speed_(0),last_tilt_speed_(0) {
 	IOTHREAD_INIT(parameters)
-	// Load NDI library
-	NDIlib_ = load_ndi_library(ndi_path_);
-	// Init NDI
-	if (!NDIlib_->initialize())
-		throw exception::InitializationFailed("Failed to initialize NDI input.");
+	// Check the placement early, it's applied when the threads start
+	if (!placement_.name.empty())
+		audio_placement_.name = placement_.name + "_a";
+	check_thread_placement(placement_);
+	check_thread_placement(audio_placement_);
+	// Pool is shared by the whole process, settings not given here are kept
+	if (frame_pool_limit_ || frame_pool_hugepages_) {
+		const auto stats = get_frame_pool_stats();
+		configure_frame_pool(frame_pool_limit_ ? frame_pool_limit_ << 20 : stats.max_idle_bytes, frame_pool_hugepages_ || stats.hugepages);
+	}
+	// Load and init NDI, the runtime is shared with other nodes
+	NDIlib_ = ndi_library_.acquire(ndi_path_);
 	// Audio pipe is for further multichannel implementation
 	audio_pipe_=(audio_enabled_?1:-1);
 	resize(0,1+(audio_enabled_?1:0));
-	// Check if there are extra ips in the config file
-	try	{
-		std::ifstream cfg_file(extra_ips_config_file);
-		nlohmann::json cfg_json;
-		cfg_file >> cfg_json;
-		extra_ips_ = cfg_json.value("extra_ips", "");
-	} catch(const std::exception& e) {
+	// Check if there are extra ips in the config file, it's parsed only once per process
+	if (!get_dicaffeine_extra_ips(extra_ips_) && !config_warning_logged.exchange(true))
 		log[log::warning] << "This module version was made for Dicaffeine installation but cannot find it's default configuration file.";
-	}
+	extra_ips_watch_ = watch_dicaffeine_extra_ips([this](const std::string& extra_ips) {
+		std::unique_lock<std::mutex> lock(extra_ips_mutex_);
+		extra_ips_ = extra_ips;
+		extra_ips_changed_ = true;
+	});
 }
 
 NDIInput::~NDIInput() {
+	unwatch_dicaffeine_extra_ips(extra_ips_watch_);
 }
 
 std::vector<core::InputDeviceInfo> NDIInput::enumerate() {
@@ -92,7 +113,8 @@ std::vector<core::InputDeviceInfo> NDIInput::enumerate() {
 	std::vector<std::string> main_param_order = {"address"};
 
 	// Find library
-	auto NDIlib = load_ndi_library();
+	ndi_library_handle library("");
+	auto NDIlib = library.get();
 
 	// Check if there are extra ips in the environment
 	auto env_ndi_extra_ips = std::getenv("NDI_EXTRA_IPS");
@@ -123,6 +145,7 @@ std::vector<core::InputDeviceInfo> NDIInput::enumerate() {
 		}
 		sleep(1_ms);
 	}
+	NDIlib->find_destroy(ndi_finder);
 	return devices;
 }
 
@@ -145,6 +168,9 @@ const NDIlib_source_t* NDIInput::get_source(std::string name, int *position) {
 }
 
 void NDIInput::sound_receiver() {
+	std::string placement_error;
+	if (!apply_thread_placement(audio_placement_, placement_error))
+		log[log::warning] << "Audio thread: " << placement_error;
 	// Yuri Audio
 	core::pRawAudioFrame y_audio_frame;
 	while (audio_running_ && audio_enabled_) {
@@ -175,21 +201,72 @@ void NDIInput::sound_receiver() {
 	}
 }
 
-void NDIInput::run() {
+core::pRawVideoFrame NDIInput::convert_video_frame(const NDIlib_video_frame_v2_t& n_video_frame) {
+	const resolution_t resolution = {(uint32_t)n_video_frame.xres, (uint32_t)n_video_frame.yres};
+	const auto stride = n_video_frame.line_stride_in_bytes;
+	const auto y_data = n_video_frame.p_data;
+	const auto uv_data = y_data + n_video_frame.yres * stride;
+	core::pRawVideoFrame y_video_frame;
+	switch (n_video_frame.FourCC) {
+	// 4:2:0 formats keep their planes, YV12 has V before U and NV12 has U and V interleaved in one plane
+	case NDIlib_FourCC_type_I420:
+	case NDIlib_FourCC_type_YV12:
+	case NDIlib_FourCC_type_NV12: {
+		y_video_frame = create_pooled_frame(core::raw_format::yuv420p, resolution, hugepages_);
+		const size_t line_size = PLANE_DATA(y_video_frame, 0).get_line_size();
+		const size_t u_line_size = PLANE_DATA(y_video_frame, 1).get_line_size();
+		const size_t v_line_size = PLANE_DATA(y_video_frame, 2).get_line_size();
+		const size_t uv_height = std::min<size_t>(PLANE_DATA(y_video_frame, 1).size() / u_line_size, (resolution.height + 1) / 2);
+		stream_copy_plane(PLANE_RAW_DATA(y_video_frame, 0), line_size, y_data, stride, std::min<size_t>(line_size, stride), resolution.height);
+		if (n_video_frame.FourCC == NDIlib_FourCC_type_NV12) {
+			nv12_split_uv(uv_data, stride, PLANE_RAW_DATA(y_video_frame, 1), u_line_size, PLANE_RAW_DATA(y_video_frame, 2), v_line_size,
+					std::min<size_t>(u_line_size, stride / 2), uv_height);
+			break;
+		}
+		const size_t uv_stride = stride / 2;
+		auto u_data = uv_data;
+		auto v_data = uv_data + (n_video_frame.yres + 1) / 2 * uv_stride;
+		if (n_video_frame.FourCC == NDIlib_FourCC_type_YV12)
+			std::swap(u_data, v_data);
+		stream_copy_plane(PLANE_RAW_DATA(y_video_frame, 1), u_line_size, u_data, uv_stride, std::min(u_line_size, uv_stride), uv_height);
+		stream_copy_plane(PLANE_RAW_DATA(y_video_frame, 2), v_line_size, v_data, uv_stride, std::min(v_line_size, uv_stride), uv_height);
+		} break;
+	default:
+		y_video_frame = create_pooled_frame(ndi_format_to_yuri(n_video_frame.FourCC), resolution, hugepages_);
+		{
+			// Frame is passed on to other threads, so there's no point in pulling it through cache
+			const size_t line_size = PLANE_DATA(y_video_frame, 0).size() / resolution.height;
+			stream_copy_plane(PLANE_RAW_DATA(y_video_frame, 0), line_size, y_data, stride, std::min<size_t>(line_size, stride), resolution.height);
+		}
+		break;
+	}
+	return y_video_frame;
+}
+
+void NDIInput::create_finder() {
+	std::unique_lock<std::mutex> lock(extra_ips_mutex_);
+	extra_ips_changed_ = false;
 	// Basic finder
 	NDIlib_find_create_t finder_desc;
 	if (extra_ips_.length()) {
 		log[log::info] << "Found extra IPs \"" << extra_ips_ << "\", adding to finder description.";
 		finder_desc.p_extra_ips = extra_ips_.c_str();
 	}
+	ndi_finder_ = NDIlib_->find_create_v2(&finder_desc);
+	if (!ndi_finder_)
+		throw exception::InitializationFailed("Failed to initialize NDI finder.");
+}
+
+void NDIInput::run() {
+	std::string placement_error;
+	if (!apply_thread_placement(placement_, placement_error))
+		log[log::warning] << placement_error;
 	// Start event timer
 	event_timer_.reset();
 
 	while (still_running()) {
 		// Init NDI finder
-		ndi_finder_ = NDIlib_->find_create_v2(&finder_desc);
-		if (!ndi_finder_)
-			throw exception::InitializationFailed("Failed to initialize NDI finder.");
+		create_finder();
 		// Keep and update stream status
 		bool stream_running = false;
 		emit_event("stream_off");
@@ -197,6 +274,12 @@ void NDIInput::run() {
 		int stream_id = -1;
 		const NDIlib_source_t* sources = nullptr;
 		while (still_running() && stream_id == -1) {
+			if (extra_ips_changed_) {
+				// Finder can't be updated, so it's replaced by a new one
+				log[log::info] << "Extra IPs changed, recreating finder.";
+				NDIlib_->find_destroy(ndi_finder_);
+				create_finder();
+			}
 			sources = get_source(stream_, &stream_id);
 			if (stream_id == -1 && backup_.length() > 0)
 				sources = get_source(backup_, &stream_id);
@@ -254,7 +337,6 @@ void NDIInput::run() {
 			NDIlib_metadata_frame_t metadata_frame;
 			NDIlib_recv_queue_t recv_queue;
 			// Yuri Video
-			yuri::format_t y_video_format;
 			core::pRawVideoFrame y_video_frame;
 			// Yuri timestamp
 			time_point<high_resolution_clock, nanoseconds> y_timestamp;
@@ -280,9 +362,7 @@ void NDIInput::run() {
 					log[log::info] << "Loosing video frames, queue: " << recv_queue.video_frames;
 					break;
 				}
-				y_video_format = ndi_format_to_yuri(n_video_frame.FourCC);
-				y_video_frame = core::RawVideoFrame::create_empty(y_video_format, {(uint32_t)n_video_frame.xres, (uint32_t)n_video_frame.yres}, true);
-				std::copy(n_video_frame.p_data, n_video_frame.p_data + n_video_frame.yres * n_video_frame.line_stride_in_bytes, PLANE_DATA(y_video_frame, 0).begin());
+				y_video_frame = convert_video_frame(n_video_frame);
 				y_timestamp = time_point<high_resolution_clock, nanoseconds>(nanoseconds(n_video_frame.timestamp*100));
 				y_timecode = n_video_frame.timecode;
 				// Free video frame as early as possible
@@ -331,7 +411,6 @@ void NDIInput::run() {
 
 		// Get it out
 		NDIlib_->recv_destroy(ndi_receiver_);
-		NDIlib_->destroy();
 		// Reset fails
 		stream_fail_ = 0;
 		// Destroy finder
@@ -347,6 +426,12 @@ void NDIInput::emit_events() {
 	emit_event("audio_dropped", perf_dropped.audio_frames);
 	emit_event("video_received", perf_total.video_frames);
 	emit_event("video_dropped", perf_dropped.video_frames);
+	// Frame pool of the process
+	const auto pool = get_frame_pool_stats();
+	emit_event("frame_pool_hits", static_cast<int64_t>(pool.hits));
+	emit_event("frame_pool_misses", static_cast<int64_t>(pool.misses));
+	emit_event("frame_pool_dropped", static_cast<int64_t>(pool.dropped));
+	emit_event("frame_pool_idle_mb", static_cast<int64_t>(pool.idle_bytes >> 20));
 }
 
 bool NDIInput::do_process_event(const std::string& event_name, const event::pBasicEvent& event) {
@@ -453,7 +538,18 @@ bool NDIInput::set_param(const core::Parameter &param) {
 			(ndi_path_, "ndi_path")
 			(audio_enabled_, "audio")
 			(lowres_enabled_, "lowres")
-			(reference_level_, "reference_level"))
+			(reference_level_, "reference_level")
+			(placement_.cpus, "cpus")
+			(placement_.numa_node, "numa_node")
+			(hugepages_, "hugepages")
+			(frame_pool_limit_, "frame_pool_limit")
+			(frame_pool_hugepages_, "frame_pool_hugepages")
+			(placement_.policy, "policy")
+			(placement_.priority, "priority")
+			(placement_.name, "thread_name")
+			(audio_placement_.cpus, "audio_cpus")
+			(audio_placement_.policy, "audio_policy")
+			(audio_placement_.priority, "audio_priority"))
 		return true;
 	return IOThread::set_param(param);
 }
@@ -10,9 +10,16 @@
 #include "yuri/core/thread/InputThread.h"
 #include "yuri/event/BasicEventConsumer.h"
 #include "yuri/event/BasicEventProducer.h"
+#include "yuri/core/frame/RawVideoFrame.h"
+
+#include "../common/thread_placement.h"
+#include "../common/utils.h"
 
 #include <Processing.NDI.Lib.h>
 
+#include <mutex>
+#include <atomic>
+
 namespace yuri {
 namespace ndi {
 
@@ -30,6 +37,8 @@ public:
 	void sound_receiver();
 private:
 	const NDIlib_source_t* get_source(std::string name, int *position);
+	void create_finder();
+	core::pRawVideoFrame convert_video_frame(const NDIlib_video_frame_v2_t& n_video_frame);
 
 	virtual bool set_param(const core::Parameter &param) override;
 	virtual bool do_process_event(const std::string& event_name, const event::pBasicEvent& event);
@@ -38,7 +47,11 @@ private:
 
 	std::string stream_;
 	std::string backup_;
+	// Updated by the config watcher
+	std::mutex extra_ips_mutex_;
 	std::string extra_ips_;
+	std::atomic<bool> extra_ips_changed_;
+	size_t extra_ips_watch_;
 	std::string format_;
 	std::string ndi_path_;
 	int nodata_timout_;
@@ -47,11 +60,17 @@ private:
 	bool lowres_enabled_;
 	int reference_level_;
 	position_t audio_pipe_;
+	thread_placement_t placement_;
+	thread_placement_t audio_placement_;
+	bool hugepages_;
+	size_t frame_pool_limit_;
+	bool frame_pool_hugepages_;
 	std::atomic<size_t> stream_fail_;
 
 	duration_t event_time_;
 	Timer event_timer_;
 
+	ndi_library_handle ndi_library_;
 	const NDIlib_v5* NDIlib_;
 	NDIlib_recv_instance_t ndi_receiver_;
 	NDIlib_find_instance_t ndi_finder_;
@@ -0,0 +1,272 @@
+/*
+ * NDIMultiOutput.cpp
+ */
+
+#include "NDIMultiOutput.h"
+
+#include "yuri/core/Module.h"
+#include "yuri/core/frame/raw_frame_types.h"
+#include "yuri/core/frame/raw_frame_params.h"
+
+#include "yuri/core/utils.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace yuri {
+namespace ndi {
+
+IOTHREAD_GENERATOR(NDIMultiOutput)
+
+core::Parameters NDIMultiOutput::configure() {
+	core::Parameters p = IOThread::configure();
+	p["streams"]["Number of streams (input pipes) to send."]=2;
+	p["stream"]["Base name of the streams, index is appended for streams without name."]="Dicaffeine";
+	p["names"]["Comma separated names of the streams."]="";
+	p["workers"]["Number of send workers shared by all streams, 0 for number of cores."]=0;
+	p["fps"]["Sets fps indicator sent in the streams, if empty, it's detected from frame timestamps."]="";
+	p["idle_skip"]["Set to true to skip sending streams without connected receivers. Connections of skipped streams are checked every event_time."]=true;
+	p["event_time"]["How often will be stream statistics fired (in seconds)."]=1.0;
+	p["ndi_path"]["Path where to find the NDI libraries, if empty, env variable NDI_PATH is used."]="";
+	return p;
+}
+
+NDIMultiOutput::NDIMultiOutput(log::Log &log_,core::pwThreadBase parent, const core::Parameters &parameters)
+:core::IOThread(log_,parent,2,0,std::string("NDIMultiOutput")),
+event::BasicEventProducer(log),event::BasicEventConsumer(log),
+streams_count_(2),stream_("Dicaffeine"),names_(""),workers_count_(0),fps_(0),idle_skip_(true),ndi_path_(""),
+event_time_(1_s),running_(false) {
+	IOTHREAD_INIT(parameters)
+	// Incoming frames wake the thread up, so there's no need to poll often
+	set_latency(1_ms);
+	if (streams_count_ < 1)
+		throw exception::InitializationFailed("At least one stream has to be sent.");
+	resize(streams_count_, 0);
+	if (!workers_count_)
+		workers_count_ = std::max(1u, std::thread::hardware_concurrency());
+	workers_count_ = std::min(workers_count_, streams_count_);
+	// Load and init NDI, the runtime is shared with other nodes
+	NDIlib_ = ndi_library_.acquire(ndi_path_);
+}
+
+NDIMultiOutput::~NDIMultiOutput() noexcept {
+}
+
+std::string NDIMultiOutput::get_stream_name(size_t index) const {
+	std::stringstream names(names_);
+	std::string name;
+	for (size_t i = 0; std::getline(names, name, ','); ++i) {
+		if (i == index && !name.empty())
+			return name;
+	}
+	return stream_ + " " + std::to_string(index + 1);
+}
+
+void NDIMultiOutput::run() {
+	try {
+		create_streams();
+	} catch (...) {
+		// Senders created before the failing one would stay published otherwise
+		destroy_streams();
+		throw;
+	}
+	running_ = true;
+	for (size_t i = 0; i < workers_count_; ++i)
+		workers_.emplace_back(&NDIMultiOutput::send_worker, this);
+	event_timer_.reset();
+
+	IOThread::run();
+
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		running_ = false;
+	}
+	cond_.notify_all();
+	for (auto& worker: workers_)
+		worker.join();
+	workers_.clear();
+	ready_.clear();
+	destroy_streams();
+}
+
+void NDIMultiOutput::create_streams() {
+	for (size_t i = 0; i < streams_count_; ++i) {
+		std::unique_ptr<stream_t> stream(new stream_t());
+		stream->name = get_stream_name(i);
+		stream->queued = false;
+		stream->sending = false;
+		stream->rate_numerator = 0;
+		stream->rate_denominator = 1;
+		if (fps_ > 0)
+			fps_to_ndi_rate(fps_, stream->rate_numerator, stream->rate_denominator);
+		stream->connections = -1;
+		stream->sent = 0;
+		stream->dropped = 0;
+		stream->non_raw_logged = false;
+		NDIlib_send_create_t NDI_send_create_desc;
+		NDI_send_create_desc.p_ndi_name = stream->name.c_str();
+		// Clocked sends would block the worker for all its streams
+		NDI_send_create_desc.clock_video = false;
+		NDI_send_create_desc.clock_audio = false;
+		stream->sender = NDIlib_->send_create(&NDI_send_create_desc);
+		if (!stream->sender)
+			throw exception::InitializationFailed("Failed to initialize NDI sender \"" + stream->name + "\".");
+		log[log::info] << "Sending stream " << i << " as \"" << stream->name << "\"";
+		streams_.push_back(std::move(stream));
+	}
+}
+
+void NDIMultiOutput::destroy_streams() {
+	for (auto& stream: streams_) {
+		// Flush the async send before releasing its frame
+		NDIlib_->send_send_video_async_v2(stream->sender, nullptr);
+		stream->in_flight.reset();
+		NDIlib_->send_destroy(stream->sender);
+	}
+	streams_.clear();
+}
+
+void NDIMultiOutput::submit_frame(size_t index, core::pRawVideoFrame frame) {
+	auto& stream = *streams_[index];
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		// Only the newest frame is kept when the workers are late
+		if (stream.pending)
+			stream.dropped++;
+		stream.pending = std::move(frame);
+		// Stream being sent is queued again by its worker
+		if (stream.queued || stream.sending)
+			return;
+		stream.queued = true;
+		ready_.push_back(index);
+	}
+	cond_.notify_one();
+}
+
+void NDIMultiOutput::send_worker() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true) {
+		cond_.wait(lock, [this]{ return !running_ || !ready_.empty(); });
+		if (!running_)
+			break;
+		const size_t index = ready_.front();
+		ready_.pop_front();
+		auto& stream = *streams_[index];
+		auto frame = std::move(stream.pending);
+		stream.pending.reset();
+		stream.queued = false;
+		stream.sending = true;
+		lock.unlock();
+		send_frame(stream, std::move(frame));
+		lock.lock();
+		stream.sending = false;
+		if (stream.pending) {
+			stream.queued = true;
+			ready_.push_back(index);
+			cond_.notify_one();
+		}
+	}
+}
+
+void NDIMultiOutput::send_frame(stream_t& stream, core::pRawVideoFrame frame) {
+	if (!frame)
+		return;
+	if (fps_ <= 0 && stream.rate.add_frame(frame->get_timestamp())) {
+		stream.rate_numerator = stream.rate.numerator();
+		stream.rate_denominator = stream.rate.denominator();
+		log[log::info] << "Detected frame rate " << stream.rate_numerator << "/" << stream.rate_denominator << " for \"" << stream.name << "\"";
+	}
+	NDIlib_video_frame_v2_t NDI_video_frame;
+	try {
+		NDI_video_frame.FourCC = yuri_format_to_ndi(frame->get_format());
+	} catch (const std::exception& e) {
+		log[log::warning] << "Dropping frame for \"" << stream.name << "\": " << e.what();
+		stream.dropped++;
+		return;
+	}
+	NDI_video_frame.xres = frame->get_width();
+	NDI_video_frame.yres = frame->get_height();
+	NDI_video_frame.line_stride_in_bytes = 0; // autodetect
+	if (stream.rate_numerator > 0) {
+		NDI_video_frame.frame_rate_N = stream.rate_numerator;
+		NDI_video_frame.frame_rate_D = stream.rate_denominator;
+	}
+	NDI_video_frame.p_data = PLANE_RAW_DATA(frame, 0);
+	NDIlib_->send_send_video_async_v2(stream.sender, &NDI_video_frame);
+	// Previous frame is released by the SDK now
+	stream.in_flight = std::move(frame);
+	stream.sent++;
+	// Connections of the streams being sent are kept current, idle ones are refreshed with the events only
+	stream.connections = NDIlib_->send_get_no_connections(stream.sender, 0);
+}
+
+bool NDIMultiOutput::step() {
+	process_events();
+	if (event_timer_.get_duration() > event_time_) {
+		emit_events();
+		event_timer_.reset();
+	}
+	for (size_t i = 0; i < streams_.size(); ++i) {
+		core::pRawVideoFrame last;
+		while (auto frame = pop_frame(i)) {
+			if (auto raw = std::dynamic_pointer_cast<core::RawVideoFrame>(frame)) {
+				if (last)
+					streams_[i]->dropped++;
+				last = std::move(raw);
+			} else {
+				// Only raw video is sent, compressed frames are counted as dropped and reported once
+				streams_[i]->dropped++;
+				if (!streams_[i]->non_raw_logged) {
+					streams_[i]->non_raw_logged = true;
+					log[log::warning] << "Dropping non-raw frames for \"" << streams_[i]->name << "\", only raw video is supported.";
+				}
+			}
+		}
+		if (!last)
+			continue;
+		// Unknown number of connections (-1) is handled as connected
+		if (idle_skip_ && streams_[i]->connections == 0)
+			continue;
+		submit_frame(i, std::move(last));
+	}
+	return true;
+}
+
+void NDIMultiOutput::emit_events() {
+	for (size_t i = 0; i < streams_.size(); ++i) {
+		auto& stream = *streams_[i];
+		// Streams skipped for having no receivers are polled only here, so they resume within event_time
+		stream.connections = NDIlib_->send_get_no_connections(stream.sender, 0);
+		const auto prefix = "stream" + std::to_string(i) + "_";
+		emit_event(prefix + "connections", static_cast<int>(stream.connections));
+		emit_event(prefix + "sent", static_cast<int64_t>(stream.sent));
+		emit_event(prefix + "dropped", static_cast<int64_t>(stream.dropped));
+	}
+}
+
+bool NDIMultiOutput::do_process_event(const std::string& event_name, const event::pBasicEvent& event) {
+	if (iequals(event_name, "quit")) {
+		request_end(core::yuri_exit_interrupted);
+		return true;
+	}
+	log[log::info] << "Got unknown event \"" << event_name << "\", timestamp: " << event->get_timestamp();
+	return false;
+}
+
+bool NDIMultiOutput::set_param(const core::Parameter &param) {
+	if (assign_parameters(param)
+			(streams_count_, "streams")
+			(stream_, "stream")
+			(names_, "names")
+			(workers_count_, "workers")
+			(fps_, "fps")
+			(idle_skip_, "idle_skip")
+			(event_time_, "event_time", [](const core::Parameter& p){ return 1_s * p.get<double>();})
+			(ndi_path_, "ndi_path")
+			)
+		return true;
+	return IOThread::set_param(param);
+}
+
+}
+}
@@ -0,0 +1,96 @@
+/*
+ * NDIMultiOutput.h
+  */
+
+#ifndef NDIMULTIOUTPUT_H_
+#define NDIMULTIOUTPUT_H_
+
+#include "yuri/core/thread/IOThread.h"
+#include "yuri/event/BasicEventConsumer.h"
+#include "yuri/event/BasicEventProducer.h"
+#include "yuri/core/frame/RawVideoFrame.h"
+
+#include "../common/utils.h"
+
+#include <Processing.NDI.Lib.h>
+
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+
+namespace yuri {
+
+namespace ndi {
+
+class NDIMultiOutput:public core::IOThread, public event::BasicEventProducer, public event::BasicEventConsumer {
+public:
+	NDIMultiOutput(log::Log &log_,core::pwThreadBase parent, const core::Parameters &parameters);
+	virtual ~NDIMultiOutput() noexcept;
+	virtual void run() override;
+	IOTHREAD_GENERATOR_DECLARATION
+	static core::Parameters configure();
+private:
+	// One published stream, pending, queued and sending are guarded by mutex_
+	struct stream_t {
+		std::string name;
+		NDIlib_send_instance_t sender;
+		core::pRawVideoFrame pending;
+		// Stream is waiting in the ready queue
+		bool queued;
+		// Stream is being sent by a worker, so no other worker takes it and its frames stay in order
+		bool sending;
+		// Frame passed to the async send has to live until the next send
+		core::pRawVideoFrame in_flight;
+		frame_rate_estimator rate;
+		int rate_numerator;
+		int rate_denominator;
+		std::atomic<int> connections;
+		std::atomic<size_t> sent;
+		std::atomic<size_t> dropped;
+		bool non_raw_logged;
+	};
+
+	bool step();
+	virtual bool set_param(const core::Parameter &param) override;
+	virtual bool do_process_event(const std::string& event_name, const event::pBasicEvent& event);
+
+	// Creates sender of every stream, streams created so far are kept in streams_ when it throws
+	void create_streams();
+	void destroy_streams();
+	void send_worker();
+	void send_frame(stream_t& stream, core::pRawVideoFrame frame);
+	void submit_frame(size_t index, core::pRawVideoFrame frame);
+	std::string get_stream_name(size_t index) const;
+
+	void emit_events();
+
+	size_t streams_count_;
+	std::string stream_;
+	std::string names_;
+	size_t workers_count_;
+	float fps_;
+	bool idle_skip_;
+	std::string ndi_path_;
+
+	duration_t event_time_;
+	Timer event_timer_;
+
+	ndi_library_handle ndi_library_;
+	const NDIlib_v5* NDIlib_;
+	std::vector<std::unique_ptr<stream_t>> streams_;
+	// Send workers shared by all the streams, idle workers take the streams from the ready queue in order
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	std::deque<size_t> ready_;
+	bool running_;
+	std::vector<std::thread> workers_;
+};
+
+}
+
+}
+
+#endif /* NDIMULTIOUTPUT_H_ */
@@ -16,48 +16,164 @@
 
 #include "yuri/core/utils.h"
 
-#include "../common/utils.h"
-
 #include <thread>
 #include <cassert>
 #include <cmath>
 #include <vector>
 #include <cstring>
+#include <chrono>
+#include <array>
 
 namespace yuri {
 namespace ndi {
 
+namespace {
+
+// Maximal number of audio frames waiting for the sender thread
+const size_t max_audio_queue = 16;
+// Maximal number of distinct serialized metadata payloads kept
+const size_t max_metadata_cache = 32;
+
+std::string escape_xml(const std::string& text) {
+	std::string escaped;
+	escaped.reserve(text.size());
+	for (auto c: text) {
+		switch (c) {
+			case '&': escaped += "&amp;"; break;
+			case '<': escaped += "&lt;"; break;
+			case '>': escaped += "&gt;"; break;
+			case '"': escaped += "&quot;"; break;
+			case '\'': escaped += "&apos;"; break;
+			default: escaped += c; break;
+		}
+	}
+	return escaped;
+}
+
+// Checks that name is an XML name usable as attribute, limited to ASCII
+bool is_xml_name(const std::string& name) {
+	if (name.empty())
+		return false;
+	for (size_t i = 0; i < name.size(); ++i) {
+		const char c = name[i];
+		const bool start = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':';
+		if (!start && (i == 0 || !((c >= '0' && c <= '9') || c == '-' || c == '.')))
+			return false;
+	}
+	return true;
+}
+
+template<size_t dim, class plane_t>
+void fill_pattern(plane_t& plane, const std::array<uint8_t, dim>& pattern) {
+	for (auto it = plane.begin(); it + dim <= plane.end(); it += dim)
+		std::copy(pattern.begin(), pattern.end(), it);
+}
+
+// Black frame sent when the input stalls for too long in hold mode
+core::pRawVideoFrame create_slate(format_t format, resolution_t resolution) {
+	using namespace core::raw_format;
+	auto frame = core::RawVideoFrame::create_empty(format, resolution);
+	switch (format) {
+		case uyvy422:
+			fill_pattern<4>(PLANE_DATA(frame, 0), {{128, 16, 128, 16}});
+			break;
+		case bgra32:
+		case rgba32:
+			fill_pattern<4>(PLANE_DATA(frame, 0), {{0, 0, 0, 255}});
+			break;
+		case yuv420p:
+			fill_pattern<1>(PLANE_DATA(frame, 0), {{16}});
+			fill_pattern<1>(PLANE_DATA(frame, 1), {{128}});
+			fill_pattern<1>(PLANE_DATA(frame, 2), {{128}});
+			break;
+		default:
+			break;
+	}
+	return frame;
+}
+
+template<typename T>
+void deinterleave(const T* src, float* dst, size_t channels, size_t samples, float scale) {
+	for (size_t c = 0; c < channels; ++c) {
+		const T* in = src + c;
+		float* out = dst + c * samples;
+		for (size_t s = 0; s < samples; ++s) {
+			out[s] = static_cast<float>(*in) * scale;
+			in += channels;
+		}
+	}
+}
+
+}
+
 IOTHREAD_GENERATOR(NDIOutput)
 
 core::Parameters NDIOutput::configure() {
 	core::Parameters p = IOThread::configure();
 	p["stream"]["Name of the stream to send."]="Dicaffeine";
 	p["audio"]["Set to true if audio should be send."]=false;
-	p["fps"]["Sets fps indicator sent in the stream"]="";
+	p["fps"]["Sets fps indicator sent in the stream, if empty, it's detected from frame timestamps."]="";
 	p["ndi_path"]["Path where to find the NDI libraries, if empty, env variable NDI_PATH is used."]="";
+	p["idle_skip"]["Set to true to skip sending when there are no receivers connected."]=true;
+	p["throttle"]["Set to true to emit throttle event (true when idle) for upstream nodes."]=false;
+	p["monitor_interval"]["How often should be connections and tally checked (in seconds)."]=0.25;
+	p["clock_video"]["Set to true to let NDI pace the video sending according to the frame rate."]=true;
+	p["timecode"]["Timecodes to send [synthesize/source/event], source uses frame timestamps, event uses timecode events."]="synthesize";
+	p["hold"]["Set to true to keep sending the last frame at constant rate when the input stalls."]=false;
+	p["hold_timeout"]["How long should be the last frame held before switching to black slate (in seconds)."]=5.0;
+	p["clock_group"]["Name of the clock group, outputs in the same group send frame aligned with matching timecodes."]="";
+	p["metadata"]["XML metadata attached to every frame, can be changed by metadata event. Values from metadata_<key> events are added as attributes, key has to be a valid XML name."]="";
+	p["cpus"]["CPUs for the send thread (e.g. \"0-3,8\"), empty for no restriction."]="";
+	p["policy"]["Scheduling policy of the send thread [other/fifo/rr]."]="other";
+	p["priority"]["Realtime priority of the send thread (1-99), used with fifo and rr policies."]=0;
+	p["thread_name"]["Name of the send thread, audio thread gets _a suffix, empty to keep the default."]="";
+	p["audio_cpus"]["CPUs for the audio thread, empty for the same as the send thread."]="";
+	p["audio_policy"]["Scheduling policy of the audio thread [other/fifo/rr]."]="other";
+	p["audio_priority"]["Realtime priority of the audio thread (1-99), it should be higher than video."]=0;
+	p["passthrough"]["Set to true to send H.264/HEVC frames as NDI|HX without reencoding (requires NDI Advanced SDK), otherwise they're dropped."]=false;
 	return p;
 }
 
 NDIOutput::NDIOutput(log::Log &log_,core::pwThreadBase parent, const core::Parameters &parameters)
 :core::IOThread(log_,parent,1,0,std::string("NDIOutput")),
 event::BasicEventProducer(log),event::BasicEventConsumer(log),
-stream_("Dicaffeine"),audio_enabled_(false),fps_(0),ndi_path_("") {
+stream_("Dicaffeine"),audio_enabled_(false),streaming_enabled_(false),fps_(0),ndi_path_(""),
+idle_skip_(true),throttle_(false),monitor_interval_(250_ms),passthrough_(false),clock_video_(true),timecode_("synthesize"),hold_(false),hold_timeout_(5_s),clock_group_name_(""),metadata_(""),
+rate_numerator_(0),rate_denominator_(1),timing_started_(false),base_timecode_(0),
+event_timecode_(NDIlib_send_timecode_synthesize),clock_tick_(0),metadata_payload_(nullptr),cmp_started_(false),audio_running_(false),monitor_running_(false),
+connections_(-1),tally_program_(false),tally_preview_(false),last_connections_(-1),
+last_tally_program_(false),last_tally_preview_(false) {
 	IOTHREAD_INIT(parameters)
-	set_latency(10_us);
+	if (!placement_.name.empty())
+		audio_placement_.name = placement_.name + "_a";
+	check_thread_placement(placement_);
+	check_thread_placement(audio_placement_);
+	// Incoming frames wake the thread up, so there's no need to poll often
+	set_latency(1_ms);
 	if (audio_enabled_) resize(2,0);
-	// Load NDI library
-	NDIlib_ = load_ndi_library(ndi_path_);
-	// Init NDI
-	if (!NDIlib_->initialize())
-		throw exception::InitializationFailed("Failed to initialize NDI input.");
+	if (fps_ > 0)
+		fps_to_ndi_rate(fps_, rate_numerator_, rate_denominator_);
+	update_metadata();
+	if (!clock_group_name_.empty()) {
+		clock_group_ = ClockGroup::join(clock_group_name_);
+		if (fps_ <= 0)
+			log[log::warning] << "Clock group \"" << clock_group_name_ << "\" used without fps, rate of the group may not match the stream.";
+	}
+	// Load and init NDI, the runtime is shared with other nodes
+	NDIlib_ = ndi_library_.acquire(ndi_path_);
 }
 
 NDIOutput::~NDIOutput() {
 }
 
 void NDIOutput::run() {
+	std::string placement_error;
+	if (!apply_thread_placement(placement_, placement_error))
+		log[log::warning] << placement_error;
 	NDIlib_send_create_t NDI_send_create_desc;
 	NDI_send_create_desc.p_ndi_name = stream_.c_str();
+	// Clock group does the pacing itself
+	NDI_send_create_desc.clock_video = clock_video_ && !clock_group_;
 	if (audio_enabled_) {
 		NDI_send_create_desc.clock_audio = true;
 	}
@@ -77,77 +193,301 @@ void NDIOutput::run() {
     NDI_connection_type.timecode        = NDIlib_send_timecode_synthesize;
     NDI_connection_type.p_data          = (char*)p_connection_str;	// should be const in header file
 	NDIlib_->send_add_connection_metadata(pNDI_send_, &NDI_connection_type);
-	std::thread th(&NDIOutput::sound_sender, this);
+	std::thread th;
+	if (audio_enabled_) {
+		audio_running_ = true;
+		th = std::thread(&NDIOutput::sound_sender, this);
+	}
+	monitor_running_ = true;
+	std::thread monitor_th(&NDIOutput::connection_monitor, this);
 	IOThread::run();
+	{
+		std::unique_lock<std::mutex> lock(audio_mutex_);
+		audio_running_ = false;
+	}
+	audio_cond_.notify_all();
+	if (th.joinable())
+		th.join();
+	monitor_running_ = false;
+	monitor_th.join();
 	stop_stream();
-	th.join();
 }
 
-void NDIOutput::sound_sender() {
-	while (running() && audio_enabled_) {
-		aframe_to_send_ = std::dynamic_pointer_cast<core::RawAudioFrame>(pop_frame(1));
-		if (streaming_enabled_ && aframe_to_send_) {
-			NDIlib_audio_frame_interleaved_16s_t NDI_audio_frame;
-			NDI_audio_frame.no_channels = aframe_to_send_->get_channel_count();
-			NDI_audio_frame.no_samples = aframe_to_send_->get_sample_count();
-			NDI_audio_frame.sample_rate = aframe_to_send_->get_sampling_frequency();
-			NDI_audio_frame.p_data = (short*)aframe_to_send_->data();
-			NDIlib_->util_send_send_audio_interleaved_16s(pNDI_send_, &NDI_audio_frame);
-			aframe_to_send_ = nullptr;
-		} else {
-			ThreadBase::sleep(10_us);
+void NDIOutput::queue_audio(core::pRawAudioFrame frame) {
+	{
+		std::unique_lock<std::mutex> lock(audio_mutex_);
+		if (audio_queue_.size() >= max_audio_queue) {
+			log[log::debug] << "Audio sender is late, dropping audio frame.";
+			audio_queue_.pop_front();
 		}
+		audio_queue_.push_back(std::move(frame));
+	}
+	audio_cond_.notify_one();
+}
+
+void NDIOutput::sound_sender() {
+	std::string placement_error;
+	if (!apply_thread_placement(audio_placement_, placement_error))
+		log[log::warning] << "Audio thread: " << placement_error;
+	std::unique_lock<std::mutex> lock(audio_mutex_);
+	while (audio_running_) {
+		audio_cond_.wait(lock, [this]{ return !audio_running_ || !audio_queue_.empty(); });
+		if (audio_queue_.empty())
+			continue;
+		auto frame = std::move(audio_queue_.front());
+		audio_queue_.pop_front();
+		lock.unlock();
+		if (streaming_enabled_)
+			send_audio(frame);
+		lock.lock();
+	}
+}
+
+void NDIOutput::connection_monitor() {
+	const auto timeout_ms = static_cast<uint32_t>(monitor_interval_.value / 1000);
+	while (monitor_running_) {
+		// Blocks until the tally changes or the interval passes
+		NDIlib_tally_t tally;
+		NDIlib_->send_get_tally(pNDI_send_, &tally, timeout_ms);
+		tally_program_ = tally.on_program;
+		tally_preview_ = tally.on_preview;
+		connections_ = NDIlib_->send_get_no_connections(pNDI_send_, 0);
+	}
+}
+
+bool NDIOutput::send_audio(const core::pRawAudioFrame& frame) {
+	const size_t channels = frame->get_channel_count();
+	const size_t samples = frame->get_sample_count();
+	if (!channels || !samples)
+		return false;
+	// NDI works natively with planar float, yuri frames are interleaved
+	audio_buffer_.resize(channels * samples);
+	float* planes = audio_buffer_.data();
+	using namespace core::raw_audio_format;
+	switch (frame->get_format()) {
+		case float_32bit:
+			deinterleave(reinterpret_cast<const float*>(frame->data()), planes, channels, samples, 1.0f);
+			break;
+		case float_64bit:
+			deinterleave(reinterpret_cast<const double*>(frame->data()), planes, channels, samples, 1.0f);
+			break;
+		case signed_32bit:
+			deinterleave(reinterpret_cast<const int32_t*>(frame->data()), planes, channels, samples, 1.0f / 2147483648.0f);
+			break;
+		case signed_16bit:
+			deinterleave(reinterpret_cast<const int16_t*>(frame->data()), planes, channels, samples, 1.0f / 32768.0f);
+			break;
+		default:
+			log[log::warning] << "Unsupported audio format " << frame->get_format() << ", dropping audio frame.";
+			return false;
 	}
+	NDIlib_audio_frame_v2_t NDI_audio_frame;
+	NDI_audio_frame.sample_rate = frame->get_sampling_frequency();
+	NDI_audio_frame.no_channels = channels;
+	NDI_audio_frame.no_samples = samples;
+	NDI_audio_frame.timecode = NDIlib_send_timecode_synthesize;
+	NDI_audio_frame.p_data = planes;
+	NDI_audio_frame.channel_stride_in_bytes = samples * sizeof(float);
+	NDIlib_->send_send_audio_v2(pNDI_send_, &NDI_audio_frame);
+	return true;
 }
 
 bool NDIOutput::step() {
-	// if (!NDIlib_->send_get_no_connections(pNDI_send_, 1000)) {
-	// 	vframe_to_send_ = std::dynamic_pointer_cast<core::RawVideoFrame>(pop_frame(0));
-	// 	streaming_enabled_ = false;
-	// 	return true;
-	// } else {
-		streaming_enabled_ = true;
-	// }
+	process_events();
+	emit_events();
+	// Unknown number of connections (-1) is handled as connected
+	streaming_enabled_ = !idle_skip_ || connections_ != 0;
+	if (!streaming_enabled_) {
+		// Nobody is listening, just drain the pipes
+		while (pop_frame(0)) {}
+		if (audio_enabled_)
+			while (pop_frame(1)) {}
+		return true;
+	}
+	if (audio_enabled_) {
+		while (auto frame = pop_frame(1)) {
+			if (auto aframe = std::dynamic_pointer_cast<core::RawAudioFrame>(frame))
+				queue_audio(std::move(aframe));
+		}
+	}
 	auto frame_to_send = pop_frame(0);
-	if (!frame_to_send)
+	if (!frame_to_send) {
+		if (hold_)
+			repeat_frame();
 		return true;
-	if (frame_to_send->get_format() == yuri::core::compressed_frame::h264) {
-		vcmpframe_to_send_ = std::dynamic_pointer_cast<core::VideoFrame>(frame_to_send);
-		log[log::info] << "Compressed frame with res " << vcmpframe_to_send_->get_resolution() << " and " << core::compressed_frame::get_format_name(vcmpframe_to_send_->get_format());
-		streaming_enabled_ = false;
+	}
+	if (auto cmp_frame = std::dynamic_pointer_cast<core::CompressedVideoFrame>(frame_to_send)) {
+		vcmpframe_to_send_ = cmp_frame;
+		send_compressed(vcmpframe_to_send_);
+		vcmpframe_to_send_.reset();
 		return true;
-	} else {
-		vframe_to_send_ = std::dynamic_pointer_cast<core::RawVideoFrame>(frame_to_send);
-		if (!vframe_to_send_)
-			return true;
-		NDIlib_video_frame_v2_t NDI_video_frame;
-		NDI_video_frame.xres = vframe_to_send_->get_width();
-		NDI_video_frame.yres = vframe_to_send_->get_height();
-		NDI_video_frame.FourCC = yuri_format_to_ndi(vframe_to_send_->get_format());
-		NDI_video_frame.line_stride_in_bytes = 0; // autodetect
-		if (fps_ > 0 && fps_ == std::ceil(fps_)) {
-			NDI_video_frame.frame_rate_N = 1000*fps_;
-			NDI_video_frame.frame_rate_D = 1000;
-		} else if (fps_ > 0) {
-			int fps = std::ceil(fps_);
-			NDI_video_frame.frame_rate_N = 1000*fps;
-			NDI_video_frame.frame_rate_D = 1001;
+	}
+	auto vframe = std::dynamic_pointer_cast<core::RawVideoFrame>(frame_to_send);
+	if (!vframe)
+		return true;
+	vframe_to_send_ = vframe;
+	last_input_time_ = timestamp_t{};
+	update_frame_rate(vframe_to_send_);
+	send_video(vframe_to_send_, get_timecode(get_source_time(vframe_to_send_)));
+	return true;
+}
+
+bool NDIOutput::send_video(const core::pRawVideoFrame& frame, int64_t timecode) {
+	NDIlib_video_frame_v2_t NDI_video_frame;
+	NDI_video_frame.xres = frame->get_width();
+	NDI_video_frame.yres = frame->get_height();
+	NDI_video_frame.FourCC = yuri_format_to_ndi(frame->get_format());
+	NDI_video_frame.line_stride_in_bytes = 0; // autodetect
+	if (clock_group_)
+		timecode = clock_group_->wait_tick(clock_tick_, rate_numerator_, rate_denominator_);
+	NDI_video_frame.timecode = timecode;
+	NDI_video_frame.p_metadata = metadata_payload_;
+	set_frame_rate(NDI_video_frame);
+	NDI_video_frame.p_data = PLANE_RAW_DATA(frame,0);
+	NDIlib_->send_send_video_v2(pNDI_send_, &NDI_video_frame);
+	last_send_time_ = timestamp_t{};
+	return true;
+}
+
+void NDIOutput::repeat_frame() {
+	if (!vframe_to_send_)
+		return;
+	// NDI default rate is used until the real one is known
+	const double rate = rate_numerator_ > 0 ? static_cast<double>(rate_numerator_) / rate_denominator_ : 30000.0 / 1001.0;
+	const auto now = timestamp_t{};
+	if (now - last_send_time_ < 1_s / rate)
+		return;
+	if (now - last_input_time_ < hold_timeout_) {
+		// Frame is sent by reference, no copy is needed
+		send_video(vframe_to_send_, NDIlib_send_timecode_synthesize);
+		return;
+	}
+	if (!slate_ || slate_->get_format() != vframe_to_send_->get_format() || !(slate_->get_resolution() == vframe_to_send_->get_resolution())) {
+		log[log::info] << "Input stalled for more than " << hold_timeout_ << ", sending slate.";
+		slate_ = create_slate(vframe_to_send_->get_format(), vframe_to_send_->get_resolution());
+	}
+	send_video(slate_, NDIlib_send_timecode_synthesize);
+}
+
+void NDIOutput::update_metadata() {
+	if (metadata_.empty() && metadata_values_.empty()) {
+		metadata_payload_ = nullptr;
+		return;
+	}
+	auto key = std::make_pair(metadata_, metadata_values_);
+	auto it = metadata_cache_.find(key);
+	if (it == metadata_cache_.end()) {
+		if (metadata_cache_.size() >= max_metadata_cache)
+			metadata_cache_.clear();
+		std::string payload;
+		if (metadata_values_.empty()) {
+			payload = metadata_;
+		} else {
+			payload = "<yuri_metadata";
+			for (const auto& value: metadata_values_)
+				payload += " " + value.first + "=\"" + escape_xml(value.second) + "\"";
+			payload += metadata_.empty() ? "/>" : ">" + metadata_ + "</yuri_metadata>";
+		}
+		it = metadata_cache_.emplace(std::move(key), std::move(payload)).first;
+	}
+	metadata_payload_ = it->second.c_str();
+}
+
+void NDIOutput::update_frame_rate(const core::pFrame& frame) {
+	// Rate set by fps parameter is fixed
+	if (fps_ > 0)
+		return;
+	if (rate_estimator_.add_frame(frame->get_timestamp())) {
+		rate_numerator_ = rate_estimator_.numerator();
+		rate_denominator_ = rate_estimator_.denominator();
+		log[log::info] << "Detected frame rate " << rate_numerator_ << "/" << rate_denominator_;
+		emit_event("fps", static_cast<double>(rate_numerator_) / rate_denominator_);
+	}
+}
+
+void NDIOutput::set_frame_rate(NDIlib_video_frame_v2_t& frame) const {
+	// Until the rate is known, NDI default is used
+	if (rate_numerator_ > 0) {
+		frame.frame_rate_N = rate_numerator_;
+		frame.frame_rate_D = rate_denominator_;
+	}
+}
+
+int64_t NDIOutput::get_source_time(const core::pFrame& frame) {
+	if (!timing_started_) {
+		first_timestamp_ = frame->get_timestamp();
+		// Receivers expect timecodes to start at the time of day
+		using namespace std::chrono;
+		base_timecode_ = duration_cast<duration<int64_t, std::ratio<1, 10000000>>>(system_clock::now().time_since_epoch()).count();
+		timing_started_ = true;
+	}
+	// NDI uses 100ns units
+	return (frame->get_timestamp() - first_timestamp_).value * 10;
+}
+
+int64_t NDIOutput::get_timecode(int64_t source_time) {
+	if (timecode_ == "source")
+		return base_timecode_ + source_time;
+	if (timecode_ == "event" && event_timecode_ != NDIlib_send_timecode_synthesize) {
+		const auto timecode = event_timecode_;
+		event_timecode_ = NDIlib_send_timecode_synthesize;
+		return timecode;
+	}
+	return NDIlib_send_timecode_synthesize;
+}
+
+bool NDIOutput::send_compressed(const core::pCompressedVideoFrame& frame) {
+	const auto fourcc = yuri_compressed_format_to_ndi(frame->get_format());
+	if (!passthrough_ || !fourcc) {
+		// Standard NDI runtime can't send compressed frames, they're dropped as before
+		if (!cmp_started_) {
+			log[log::info] << "Dropping compressed frames with res " << frame->get_resolution() << " and " << core::compressed_frame::get_format_name(frame->get_format())
+					<< (fourcc ? ", set passthrough to true to send them as NDI|HX" : "");
+			cmp_started_ = true;
 		}
-		NDIlib_tally_t NDI_tally;
-		NDIlib_->send_get_tally(pNDI_send_, &NDI_tally, 0);
-		NDI_video_frame.p_data = PLANE_RAW_DATA(vframe_to_send_,0);
-		NDIlib_->send_send_video_v2(pNDI_send_, &NDI_video_frame);
+		return false;
+	}
+	if (!cmp_started_) {
+		log[log::info] << "Passing through " << core::compressed_frame::get_format_name(frame->get_format()) << " stream with resolution " << frame->get_resolution();
+		cmp_started_ = true;
 	}
+	update_frame_rate(frame);
+	const int64_t pts = get_source_time(frame);
+
+	NDIlib_video_frame_v2_t NDI_video_frame;
+	NDI_video_frame.xres = frame->get_width();
+	NDI_video_frame.yres = frame->get_height();
+	NDI_video_frame.timecode = clock_group_ ? clock_group_->wait_tick(clock_tick_, rate_numerator_, rate_denominator_) : get_timecode(pts);
+	NDI_video_frame.p_metadata = metadata_payload_;
+	set_frame_rate(NDI_video_frame);
+	send_ndi_compressed_frame(NDIlib_, pNDI_send_, NDI_video_frame, fourcc, frame->data(), frame->size(), pts,
+			cmp_packet_, cmp_parameter_sets_);
 	return true;
 }
 
 void NDIOutput::stop_stream() {
 	NDIlib_->send_destroy(pNDI_send_);
-	NDIlib_->destroy();
 }
 
 void NDIOutput::emit_events() {
-	// Nothing here now
+	const int connections = connections_;
+	if (connections != last_connections_) {
+		log[log::info] << "Number of connected receivers: " << connections;
+		emit_event("connections", connections);
+		if (throttle_ && (connections == 0 || last_connections_ <= 0))
+			emit_event("throttle", connections == 0);
+		last_connections_ = connections;
+	}
+	const bool program = tally_program_;
+	if (program != last_tally_program_) {
+		emit_event("tally_program", program);
+		last_tally_program_ = program;
+	}
+	const bool preview = tally_preview_;
+	if (preview != last_tally_preview_) {
+		emit_event("tally_preview", preview);
+		last_tally_preview_ = preview;
+	}
 }
 
 bool NDIOutput::do_process_event(const std::string& event_name, const event::pBasicEvent& event) {
@@ -155,6 +495,37 @@ bool NDIOutput::do_process_event(const std::string& event_name, const event::pBa
         request_end(core::yuri_exit_interrupted);
         return true;
     }
+	if (iequals(event_name, "timecode")) {
+		event_timecode_ = event::get_value<event::EventInt>(event);
+		return true;
+	}
+	if (iequals(event_name, "metadata")) {
+		metadata_ = event::lex_cast_value<std::string>(event);
+		update_metadata();
+		return true;
+	}
+	if (iequals(event_name, "metadata_clear")) {
+		metadata_.clear();
+		metadata_values_.clear();
+		update_metadata();
+		return true;
+	}
+	if (event_name.compare(0, 9, "metadata_") == 0 && event_name.size() > 9) {
+		// Keys become attribute names, so only valid XML names are accepted
+		const auto name = event_name.substr(9);
+		if (!is_xml_name(name)) {
+			log[log::warning] << "Ignoring metadata event \"" << event_name << "\", \"" << name << "\" is not a valid XML attribute name";
+			return false;
+		}
+		// Empty value removes the key
+		const auto value = event::lex_cast_value<std::string>(event);
+		if (value.empty())
+			metadata_values_.erase(name);
+		else
+			metadata_values_[name] = value;
+		update_metadata();
+		return true;
+	}
 	log[log::info] << "Got unknown event \"" << event_name << "\", timestamp: " << event->get_timestamp();
 	return false;
 }
@@ -165,6 +536,23 @@ bool NDIOutput::set_param(const core::Parameter &param) {
 			(audio_enabled_, "audio")
 			(fps_, "fps")
 			(ndi_path_, "ndi_path")
+			(idle_skip_, "idle_skip")
+			(throttle_, "throttle")
+			(passthrough_, "passthrough")
+			(clock_video_, "clock_video")
+			(timecode_, "timecode")
+			(hold_, "hold")
+			(hold_timeout_, "hold_timeout", [](const core::Parameter& p){ return 1_s * p.get<double>();})
+			(clock_group_name_, "clock_group")
+			(metadata_, "metadata")
+			(monitor_interval_, "monitor_interval", [](const core::Parameter& p){ return 1_s * p.get<double>();})
+			(placement_.cpus, "cpus")
+			(placement_.policy, "policy")
+			(placement_.priority, "priority")
+			(placement_.name, "thread_name")
+			(audio_placement_.cpus, "audio_cpus")
+			(audio_placement_.policy, "audio_policy")
+			(audio_placement_.priority, "audio_priority")
 			)
 		return true;
 	return IOThread::set_param(param);
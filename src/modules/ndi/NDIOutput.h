@@ -11,9 +11,20 @@
 #include "yuri/event/BasicEventProducer.h"
 #include "yuri/core/frame/RawVideoFrame.h"
 #include "yuri/core/frame/RawAudioFrame.h"
+#include "yuri/core/frame/CompressedVideoFrame.h"
+
+#include "../common/utils.h"
+#include "../common/thread_placement.h"
+#include "ClockGroup.h"
 
 #include <Processing.NDI.Lib.h>
 
+#include <mutex>
+#include <map>
+#include <deque>
+#include <atomic>
+#include <condition_variable>
+
 namespace yuri {
 
 namespace ndi {
@@ -26,6 +37,7 @@ public:
 	IOTHREAD_GENERATOR_DECLARATION
 	static core::Parameters configure();
 	void sound_sender();
+	void connection_monitor();
 private:
 	bool step();
 	virtual bool set_param(const core::Parameter &param) override;
@@ -33,20 +45,87 @@ private:
 
 	void stop_stream();
 
+	bool send_video(const core::pRawVideoFrame& frame, int64_t timecode);
+	void repeat_frame();
+	void update_metadata();
+	void update_frame_rate(const core::pFrame& frame);
+	void set_frame_rate(NDIlib_video_frame_v2_t& frame) const;
+	int64_t get_source_time(const core::pFrame& frame);
+	int64_t get_timecode(int64_t source_time);
+	bool send_compressed(const core::pCompressedVideoFrame& frame);
+
+	void queue_audio(core::pRawAudioFrame frame);
+	bool send_audio(const core::pRawAudioFrame& frame);
+
 	void emit_events();
 
 	std::string stream_;
 	bool audio_enabled_;
-	bool streaming_enabled_;
+	std::atomic<bool> streaming_enabled_;
 	float fps_;
 	std::string ndi_path_;
+	bool idle_skip_;
+	bool throttle_;
+	duration_t monitor_interval_;
+	bool passthrough_;
+	bool clock_video_;
+	std::string timecode_;
+	bool hold_;
+	duration_t hold_timeout_;
+	std::string clock_group_name_;
+	std::string metadata_;
+	thread_placement_t placement_;
+	thread_placement_t audio_placement_;
 
+	ndi_library_handle ndi_library_;
 	const NDIlib_v5* NDIlib_;
 	NDIlib_send_instance_t pNDI_send_;
 
-	core::pRawAudioFrame aframe_to_send_;
 	core::pRawVideoFrame vframe_to_send_;
-	core::pVideoFrame vcmpframe_to_send_;
+	core::pCompressedVideoFrame vcmpframe_to_send_;
+
+	// Hold mode keeps sending vframe_to_send_ (and later the slate) when input stalls
+	core::pRawVideoFrame slate_;
+	timestamp_t last_input_time_;
+	timestamp_t last_send_time_;
+
+	// Timing of the outgoing stream
+	int rate_numerator_;
+	int rate_denominator_;
+	frame_rate_estimator rate_estimator_;
+	bool timing_started_;
+	timestamp_t first_timestamp_;
+	int64_t base_timecode_;
+	int64_t event_timecode_;
+	std::shared_ptr<ClockGroup> clock_group_;
+	uint64_t clock_tick_;
+
+	// Per frame metadata, payloads are serialized only when the values change
+	using metadata_key_t = std::pair<std::string, std::map<std::string, std::string>>;
+	std::map<std::string, std::string> metadata_values_;
+	std::map<metadata_key_t, std::string> metadata_cache_;
+	const char* metadata_payload_;
+
+	// Compressed passthrough, packet is reused for every frame
+	std::vector<uint8_t> cmp_packet_;
+	std::vector<uint8_t> cmp_parameter_sets_;
+	bool cmp_started_;
+
+	// Audio frames are popped in step() and handed over to sound_sender()
+	std::mutex audio_mutex_;
+	std::condition_variable audio_cond_;
+	std::deque<core::pRawAudioFrame> audio_queue_;
+	bool audio_running_;
+	std::vector<float> audio_buffer_;
+
+	// Updated by connection_monitor(), events are emitted from step()
+	std::atomic<bool> monitor_running_;
+	std::atomic<int> connections_;
+	std::atomic<bool> tally_program_;
+	std::atomic<bool> tally_preview_;
+	int last_connections_;
+	bool last_tally_program_;
+	bool last_tally_preview_;
 };
 
 }
@@ -4,6 +4,7 @@
 
 #include "NDIInput.h"
 #include "NDIOutput.h"
+#include "NDIMultiOutput.h"
 #include "yuri/core/thread/IOThreadGenerator.h"
 #include "yuri/core/thread/InputRegister.h"
 
@@ -11,4 +12,5 @@ MODULE_REGISTRATION_BEGIN("ndi")
 	REGISTER_IOTHREAD("ndi_input",yuri::ndi::NDIInput)
 	REGISTER_INPUT_THREAD("ndi_input", yuri::ndi::NDIInput::enumerate)
 	REGISTER_IOTHREAD("ndi_output",yuri::ndi::NDIOutput)
+	REGISTER_IOTHREAD("ndi_multi_output",yuri::ndi::NDIMultiOutput)
 MODULE_REGISTRATION_END()
@@ -14,6 +14,7 @@
 #include "yuri/core/frame/raw_frame_params.h"
 #include "yuri/core/utils/irange.h"
 #include "yuri/core/utils/assign_events.h"
+#include "../common/frame_pool.h"
 #include <functional>
 #include <iostream>
 namespace yuri {
@@ -177,7 +178,7 @@ void fill_frame_plane<4, uint16_t>(const core::pRawVideoFrame& frame, size_t pla
 
 core::pRawVideoFrame BlankGenerator::generate_frame(format_t format, resolution_t resolution, core::color_t color)
 {
-	auto frame = core::RawVideoFrame::create_empty(format, resolution);
+	auto frame = create_pooled_frame(format, resolution);
 	using namespace core::raw_format;
 
 	switch (format) {
@@ -13,6 +13,8 @@
 #include "yuri/core/frame/RawVideoFrame.h"
 #include "yuri/core/frame/raw_frame_types.h"
 #include "yuri/core/frame/raw_frame_params.h"
+#include "../common/copy.h"
+#include "../common/frame_pool.h"
 namespace yuri {
 namespace ndi_combine {
 
@@ -31,15 +33,20 @@ core::Parameters Combine::configure()
 	p["x"]["Width of the grid"]=2;
 	p["y"]["Height of the grid"]=2;
 	p["fps"]["Maximal framerate"]=30;
+	p["copy_threads"]["Number of threads used to copy large input frames"]=1;
+	p["cpus"]["CPUs for the combining thread (e.g. \"0-3,8\"), empty for no restriction"]="";
+	p["numa_node"]["NUMA node for the combining thread and its frames, -1 to disable"]=-1;
+	p["hugepages"]["Allocate output frames in huge pages"]=false;
 	return p;
 }
 
 
 Combine::Combine(log::Log &log_, core::pwThreadBase parent, const core::Parameters &parameters):
-base_type(log_,parent,1,1,std::string("ndi_combine")),x_(2),y_(2),fps_(30)
+base_type(log_,parent,1,1,std::string("ndi_combine")),x_(2),y_(2),fps_(30),copy_threads_(1),hugepages_(false)
 {
 	IOTHREAD_INIT(parameters)
 	if (x_<1 || y_<1) throw exception::InitializationFailed("Wrong size of the grid");
+	check_thread_placement(placement_);
 	resize(x_ * y_,1);
 	next_time_ = timestamp_t{};
 }
@@ -48,6 +55,20 @@ Combine::~Combine() noexcept
 {
 }
 
+void Combine::run()
+{
+	std::string placement_error;
+	if (!apply_thread_placement(placement_, placement_error))
+		log[log::warning] << placement_error;
+	// Copy threads are shared with the other nodes of the same placement
+	const thread_placement_t placement = placement_;
+	pool_ = get_row_pool(get_placement_key(placement), [placement] {
+		std::string error;
+		apply_thread_placement(placement, error);
+	});
+	base_type::run();
+}
+
 std::vector<core::pFrame> Combine::do_single_step(std::vector<core::pFrame> framesx)
 {
 	const auto curtime = timestamp_t{};
@@ -86,11 +107,12 @@ std::vector<core::pFrame> Combine::do_single_step(std::vector<core::pFrame> fram
 			return {};
 		}
 	}
-	core::pRawVideoFrame output = core::RawVideoFrame::create_empty(format,{width*x_, height*y_}, true);
+	core::pRawVideoFrame output = create_pooled_frame(format,{width*x_, height*y_}, hugepages_);
 	uint8_t* out = PLANE_RAW_DATA(output,0);
 	size_t sub_line_width=bpp*width/8;
 	size_t line_width = sub_line_width*x_;
 	size_t idx = 0;
+	row_workers_t workers(pool_, copy_threads_);
 	for (size_t idx_y=0;idx_y<y_;++idx_y) {
 		for (size_t idx_x=0;idx_x<x_;++idx_x) {
 			const uint8_t* raw_src = PLANE_RAW_DATA(frames[idx],0);
@@ -101,11 +123,8 @@ std::vector<core::pFrame> Combine::do_single_step(std::vector<core::pFrame> fram
 				sub_line_width_curr = sub_line_width;
 			}
 			size_t height_curr = height < frames[idx]->get_height() ? height : frames[idx]->get_height();
-			for (size_t line=0;line<height_curr;++line) {
-				std::copy(raw_src+line*sub_line_width_curr+line*line_skip,
-						raw_src+(line+1)*sub_line_width_curr+line*line_skip,
-						out+(idx_y*height+line)*line_width+idx_x*sub_line_width);
-			}
+			stream_copy_plane(out+idx_y*height*line_width+idx_x*sub_line_width, line_width,
+					raw_src, sub_line_width_curr+line_skip, sub_line_width_curr, height_curr, &workers);
 			idx++;
 		}
 	}
@@ -118,7 +137,11 @@ bool Combine::set_param(const core::Parameter& param)
 	if (assign_parameters(param)
 			(x_, "x")
 			(y_, "y")
-			(fps_, "fps"))
+			(fps_, "fps")
+			(copy_threads_, "copy_threads")
+			(placement_.cpus, "cpus")
+			(placement_.numa_node, "numa_node")
+			(hugepages_, "hugepages"))
 		return true;
 	return base_type::set_param(param);
 }
@@ -11,6 +11,8 @@
 #define COMBINE_H_
 
 #include "yuri/core/thread/MultiIOFilter.h"
+#include "../common/thread_placement.h"
+#include "../common/thread_pool.h"
 #include <vector>
 namespace yuri {
 namespace ndi_combine {
@@ -23,12 +25,17 @@ public:
 	static core::Parameters configure();
 	Combine(log::Log &log_, core::pwThreadBase parent, const core::Parameters &parameters);
 	virtual ~Combine() noexcept;
+	virtual void run() override;
 private:
 	virtual std::vector<core::pFrame> do_single_step(std::vector<core::pFrame> frames) override;
 	virtual bool set_param(const core::Parameter& param) override;
 	size_t x_,y_;
 	timestamp_t next_time_;
 	float fps_;
+	size_t copy_threads_;
+	thread_placement_t placement_;
+	bool hugepages_;
+	std::shared_ptr<row_pool_t> pool_;
 
 };
 
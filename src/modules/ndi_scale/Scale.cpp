@@ -8,11 +8,19 @@
  */
 
 #include "Scale.h"
+#include "ScaleKernels.h"
+#include "ScaleTables.h"
 #include "yuri/core/Module.h"
 #include "yuri/core/frame/raw_frame_types.h"
+#include "yuri/core/utils.h"
 #include "yuri/core/utils/assign_events.h"
-#include "yuri/core/utils/irange.h"
-#include <future>
+#include "yuri/exception/Exception.h"
+#include "../common/frame_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+#include <thread>
 
 namespace yuri {
 namespace scale {
@@ -27,18 +35,35 @@ core::Parameters Scale::configure()
 {
     core::Parameters p = base_type::configure();
     p.set_description("Scale");
-    p["resolution"]["Resolution to scale to"]                           = resolution_t{ 800, 600 };
-    p["fast"]["Enable fast scaling"]                                    = true;
-    p["threads"]["Number of threads to use for scaling (EXPERIMENTAL)"] = 1;
+    p["resolution"]["Resolution to scale to"]                                                        = resolution_t{ 800, 600 };
+    p["resolutions"]["Additional resolutions for outputs 1 and up (e.g. \"1280x720,640x360\")"]      = "";
+    p["fast"]["Enable fast scaling"]                                                                 = true;
+    p["filter"]["Scaling filter (bilinear, area, bicubic, lanczos or auto)"]                         = "bilinear";
+    p["output_format"]["Output format converted while scaling, empty to keep the input format"]      = "";
+    p["mode"]["Scaling mode (stretch, fit to the resolution with padding or fill it with cropping)"] = "stretch";
+    p["color"]["Colour of the padding in fit mode"]                                                  = core::color_t::create_rgb(0, 0, 0);
+    p["color_matrix"]["Matrix for the conversion (bt601, bt709 or auto)"]                            = "auto";
+    p["threads"]["Number of threads to use for scaling, 0 to choose automatically"]                  = 0;
+    p["cpus"]["CPUs for the scaling threads (e.g. \"0-3,8\"), empty for no restriction"]             = "";
+    p["numa_node"]["NUMA node for the scaling threads and their frames, -1 to disable"]              = -1;
+    p["hugepages"]["Allocate output frames in huge pages"]                                           = false;
+    p["max_zoom"]["Zoom of the virtual PTZ at zoom 0.0"]                                             = 4.0;
+    p["ptz_frames"]["Frames of the virtual PTZ transitions, 0 to move immediately"]                  = 25;
     return p;
 }
 
 Scale::Scale(const log::Log& log_, core::pwThreadBase parent, const core::Parameters& parameters)
-    : base_type(log_, parent, std::string("ndi_scale")), event::BasicEventConsumer(log), resolution_(resolution_t{ 800, 600 }), fast_(true), threads_{ 1 }
+    : base_type(log_, parent, std::string("ndi_scale")), event::BasicEventConsumer(log), resolution_(resolution_t{ 800, 600 }), fast_(true), filter_(filter_t::bilinear), mode_(scale_mode_t::stretch), color_(core::color_t::create_rgb(0, 0, 0)), output_format_(0), color_matrix_("auto"), threads_{ 0 }, max_zoom_(4.0), ptz_frames_(25), hugepages_(false), frame_cost_(0.0)
 {
+    const roi_t full{ 0.0, 0.0, 1.0, 1.0 };
+    ptz_ = { 0.0f, 0.0f, 1.0f, full, full, full, 0 };
     IOTHREAD_INIT(parameters)
+    resize(1, 1 + resolutions_.size());
+    check_thread_placement(placement_);
     using namespace core::raw_format;
-    set_supported_formats({ rgb24, bgr24, rgba32, argb32, bgra32, abgr32, yuv444, yuyv422, yvyu422, uyvy422, vyuy422, yuva4444 });
+    set_supported_formats({ rgb24, bgr24, rgba32, argb32, bgra32, abgr32, yuv444, yuyv422, yvyu422, uyvy422, vyuy422, yuva4444, yuv420p, yuv422p, yuv444p,
+                            nv12, y8, y16 });
+    log[log::debug] << "Using " << scale_kernel_name() << " kernels for fast scaling";
     //	set_latency(1_ms);
 }
 
@@ -46,8 +71,28 @@ Scale::~Scale() noexcept
 {
 }
 
+void Scale::run()
+{
+    std::string placement_error;
+    if (!apply_thread_placement(placement_, placement_error))
+        log[log::warning] << placement_error;
+    const thread_placement_t placement = placement_;
+    // Nodes with the same placement share the workers, each worker applies the placement when it starts.
+    // Errors are the same as the ones reported above.
+    pool_ = get_row_pool(get_placement_key(placement), [placement] {
+        std::string error;
+        apply_thread_placement(placement, error);
+    });
+    base_type::run();
+}
+
 namespace {
 
+// Rows taken by a scaling thread at once
+constexpr size_t block_rows = 16;
+// Work per frame and thread the automatic thread count aims for (in seconds)
+constexpr double target_thread_cost = 0.002;
+
 template <size_t pixel_size>
 struct scale_line_bilinear {
     inline static void eval(uint8_t* it, const uint8_t* top, const uint8_t* bottom, const dimension_t new_width, const dimension_t old_width,
@@ -70,29 +115,6 @@ struct scale_line_bilinear {
     }
 };
 
-template <size_t pixel_size>
-struct scale_line_bilinear_fast {
-    inline static void eval(uint8_t* it, const uint8_t* top, const uint8_t* bottom, const dimension_t new_width, const dimension_t old_width,
-                            const uint64_t unscale_x, const uint64_t y_ratio)
-    {
-        const uint64_t y_ratio2 = 256 - y_ratio;
-        for (dimension_t pixel = 0; pixel < new_width - 1; ++pixel) {
-            const dimension_t left     = pixel * unscale_x;
-            const dimension_t right    = left + 1;
-            const uint64_t    x_ratio  = pixel * unscale_x - left;
-            const uint64_t    x_ratio2 = 256 - x_ratio;
-            for (size_t i = 0; i < pixel_size; ++i) {
-                *it++ = static_cast<uint8_t>((top[left / 256 * pixel_size + i] * x_ratio2 * y_ratio2 + top[right / 256 * pixel_size + i] * x_ratio * y_ratio2
-                                              + bottom[left / 256 * pixel_size + i] * x_ratio2 * y_ratio
-                                              + bottom[right / 256 * pixel_size + i] * x_ratio * y_ratio)
-                                             / 65536);
-            }
-        }
-        for (size_t i = 0; i < pixel_size; ++i) {
-            *it++ = static_cast<uint8_t>((top[(old_width - 1) * pixel_size + i] * y_ratio2 + bottom[(old_width - 1) * pixel_size + i] * y_ratio) / 256);
-        }
-    }
-};
 inline uint8_t get_y(const dimension_t pixel, const double unscale_x, const uint8_t* top, const uint8_t* bottom, const double y_ratio, const double y_ratio2)
 {
     const dimension_t left  = static_cast<dimension_t>(pixel * unscale_x);
@@ -151,237 +173,873 @@ struct scale_line_bilinear_uyvy {
     }
 };
 
-inline uint8_t get_y_fast(const dimension_t pixel, const uint64_t unscale_x, const uint8_t* top, const uint8_t* bottom, const uint64_t y_ratio,
-                          const uint64_t y_ratio2)
+bool get_plane_layouts(const format_t format, std::vector<plane_layout_t>& layouts)
 {
-    const dimension_t left  = pixel * unscale_x;
-    const dimension_t right = left + 256;
+    using namespace core::raw_format;
+    const plane_layout_t luma{ 1, 1, 1, 1, false };
+    switch (format) {
+    case yuv444p:
+        layouts = { luma, luma, luma };
+        return true;
+    case yuv422p:
+        layouts = { luma, { 1, 1, 2, 1, false }, { 1, 1, 2, 1, false } };
+        return true;
+    case yuv420p:
+        layouts = { luma, { 1, 1, 2, 2, true }, { 1, 1, 2, 2, true } };
+        return true;
+    case nv12:
+        layouts = { luma, { 2, 1, 2, 2, true } };
+        return true;
+    case y8:
+        layouts = { luma };
+        return true;
+    case y16:
+        layouts = { { 1, 2, 1, 1, false } };
+        return true;
+    }
+    // P216 (16 bit 4:2:2 semi-planar) isn't supported, yuri has no raw format for it and NDIInput doesn't receive it
+    return false;
+}
 
-    const uint64_t x_ratio  = pixel * unscale_x - left;
-    const uint64_t x_ratio2 = 256 - x_ratio;
-    //	std::cout << "pixel: " << pixel << ", left:"<<left << ", leftx: " << left/256 * 2 <<std::endl;
-    return static_cast<uint8_t>((top[left / 256 * 2 + 0] * x_ratio2 * y_ratio2 + top[right / 256 * 2 + 0] * x_ratio * y_ratio2
-                                 + bottom[left / 256 * 2 + 0] * x_ratio2 * y_ratio + bottom[right / 256 * 2 + 0] * x_ratio * y_ratio)
-                                / 65536);
+void build_plane_plan(plane_plan_t& plane, const plane_layout_t& layout, const resolution_t input, const resolution_t output)
+{
+    plane.input       = { input.width / layout.sub_x, input.height / layout.sub_y };
+    plane.output      = { output.width / layout.sub_x, output.height / layout.sub_y };
+    plane.sample_size = layout.sample_size;
+    build_plane_tables(plane.line, plane.steps, layout, input.width, input.height, output.width, output.height);
 }
-template <size_t adjust>
-inline uint8_t get_uv_fast(const dimension_t pixel, const uint64_t unscale_x, const uint8_t* top, const uint8_t* bottom, const uint64_t y_ratio,
-                           const uint64_t y_ratio2)
+
+filter_t parse_filter(const std::string& name)
 {
-    const dimension_t left0 = pixel * unscale_x;
-    const dimension_t left  = (left0 & ~0x1FF) + 256 * adjust;
-    const dimension_t right = left + 2 * 256;
+    if (name == "area")
+        return filter_t::area;
+    if (name == "bicubic")
+        return filter_t::bicubic;
+    if (name == "lanczos")
+        return filter_t::lanczos;
+    if (name == "auto")
+        return filter_t::automatic;
+    return filter_t::bilinear;
+}
 
-    const uint64_t x_ratio  = (pixel * unscale_x - left0 + (left0 & 0x1FF)) / 2;
-    const uint64_t x_ratio2 = 256 - x_ratio;
-    return static_cast<uint8_t>((top[left / 256 * 2 + 1] * x_ratio2 * y_ratio2 + top[right / 256 * 2 + 1] * x_ratio * y_ratio2
-                                 + bottom[left / 256 * 2 + 1] * x_ratio2 * y_ratio + bottom[right / 256 * 2 + 1] * x_ratio * y_ratio)
-                                / 65536);
+const char* get_filter_name(const filter_t filter)
+{
+    switch (filter) {
+    case filter_t::area:
+        return "area";
+    case filter_t::bicubic:
+        return "bicubic";
+    case filter_t::lanczos:
+        return "lanczos";
+    case filter_t::automatic:
+        return "auto";
+    default:
+        return "bilinear";
+    }
 }
 
-struct scale_line_bilinear_yuyv_fast {
-    inline static void eval(uint8_t* it, const uint8_t* top, const uint8_t* bottom, const dimension_t new_width, const dimension_t /*old_width*/,
-                            const uint64_t unscale_x, const uint64_t y_ratio)
-    {
-        const uint64_t y_ratio2 = 256 - y_ratio;
-        for (dimension_t pixel = 0; pixel < new_width - 2; pixel += 2) {
-            *it++ = get_y_fast(pixel, unscale_x, top, bottom, y_ratio, y_ratio2);
-            *it++ = get_uv_fast<0>(pixel, unscale_x, top, bottom, y_ratio, y_ratio2);
-            *it++ = get_y_fast(pixel + 1, unscale_x, top, bottom, y_ratio, y_ratio2);
-            *it++ = get_uv_fast<1>(pixel + 1, unscale_x, top, bottom, y_ratio, y_ratio2);
+// Parses list of resolutions like "1280x720,640x360"
+std::vector<resolution_t> parse_resolutions(const std::string& list)
+{
+    std::vector<resolution_t> resolutions;
+    std::stringstream         ss(list);
+    std::string               item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty())
+            continue;
+        const auto x = item.find('x');
+        if (x == std::string::npos)
+            throw exception::Exception("Wrong resolution \"" + item + "\".");
+        try {
+            resolutions.push_back({ static_cast<dimension_t>(std::stoul(item.substr(0, x))), static_cast<dimension_t>(std::stoul(item.substr(x + 1))) });
+        } catch (const std::logic_error&) {
+            throw exception::Exception("Wrong resolution list \"" + list + "\".");
         }
-        *it++ = get_y_fast((new_width - 2), unscale_x, top, bottom, y_ratio, y_ratio2);
-        *it++ = get_uv_fast<0>((new_width - 2), unscale_x, top, bottom, y_ratio, y_ratio2);
-        *it++ = get_y_fast((new_width - 1), unscale_x, top, bottom, y_ratio, y_ratio2);
-        *it++ = get_uv_fast<1>((new_width - 1), unscale_x, top, bottom, y_ratio, y_ratio2);
     }
-};
+    return resolutions;
+}
 
-struct scale_line_bilinear_uyvy_fast {
-    inline static void eval(uint8_t* it, const uint8_t* top, const uint8_t* bottom, const dimension_t new_width, const dimension_t /*old_width*/,
-                            const uint64_t unscale_x, const uint64_t y_ratio)
+// ROI of the pan, tilt and zoom, the zoom goes from the whole input (1.0) to max_zoom (0.0)
+roi_t get_ptz_roi(const virtual_ptz_t& ptz, const double max_zoom)
+{
+    const double pan  = std::min(std::max(ptz.pan, -1.0f), 1.0f);
+    const double tilt = std::min(std::max(ptz.tilt, -1.0f), 1.0f);
+    const double zoom = std::min(std::max(ptz.zoom, 0.0f), 1.0f);
+    const double size = 1.0 / (1.0 + (std::max(max_zoom, 1.0) - 1.0) * (1.0 - zoom));
+    return { (1.0 - size) * (pan + 1.0) / 2.0, (1.0 - size) * (1.0 - tilt) / 2.0, size, size };
+}
+
+scale_mode_t parse_mode(const std::string& name)
+{
+    if (name == "fit")
+        return scale_mode_t::fit;
+    if (name == "fill")
+        return scale_mode_t::fill;
+    return scale_mode_t::stretch;
+}
+
+// Destination of the scaled lines of a plane. With a colour conversion, lines are scaled to a per-thread buffer and converted
+// to the output frame right away, so the output is written only once and no intermediate frame is needed.
+class line_output_t {
+public:
+    line_output_t(const core::pRawVideoFrame& outframe, size_t plane, const scale_plan_t& plan, const plane_offset_t& offset, size_t line_size)
+        : linesize_(PLANE_DATA(outframe, plane).get_line_size()), line_size_(line_size), plan_(plan)
     {
-        const uint64_t y_ratio2 = 256 - y_ratio;
-        for (dimension_t pixel = 0; pixel < new_width - 2; pixel += 2) {
-            // Using top - 1 and bottom - 1 to reuse methods for yuv
-            *it++ = get_uv_fast<0>(pixel, unscale_x, top - 1, bottom - 1, y_ratio, y_ratio2);
-            // Using top + 1 and bottom + 1 to reuse methods for yuv
-            *it++ = get_y_fast(pixel, unscale_x, top + 1, bottom + 1, y_ratio, y_ratio2);
-            *it++ = get_uv_fast<1>(pixel + 1, unscale_x, top - 1, bottom - 1, y_ratio, y_ratio2);
-            *it++ = get_y_fast(pixel + 1, unscale_x, top + 1, bottom + 1, y_ratio, y_ratio2);
-        }
-        *it++ = get_uv_fast<0>((new_width - 2), unscale_x, top - 1, bottom - 1, y_ratio, y_ratio2);
-        *it++ = get_y_fast((new_width - 2), unscale_x, top + 1, bottom + 1, y_ratio, y_ratio2);
-        *it++ = get_uv_fast<1>((new_width - 1), unscale_x, top - 1, bottom - 1, y_ratio, y_ratio2);
-        *it++ = get_y_fast((new_width - 1), unscale_x, top + 1, bottom + 1, y_ratio, y_ratio2);
+        data_ = PLANE_RAW_DATA(outframe, plane) + offset.output_y * linesize_ + offset.output_x;
+    }
+
+    // Returns buffer for the scaled line, valid until next call from the same thread
+    uint8_t* begin(size_t line) const
+    {
+        if (!plan_.convert)
+            return data_ + line * linesize_;
+        thread_local std::vector<uint8_t> buffer;
+        buffer.resize(line_size_ + 1);
+        return buffer.data();
+    }
+
+    // Stores the scaled line to the output line
+    void end(size_t line, const uint8_t* scaled) const
+    {
+        if (plan_.convert)
+            plan_.convert(scaled, line_size_, data_ + line * linesize_, linesize_, plan_.target.width, 1, plan_.matrix);
+        else if (scaled != data_ + line * linesize_)
+            std::copy(scaled, scaled + line_size_, data_ + line * linesize_);
     }
+
+private:
+    size_t              linesize_;
+    size_t              line_size_; // Size of the scaled line
+    const scale_plan_t& plan_;
+    uint8_t*            data_;
 };
 
 template <class kernel>
-core::pRawVideoFrame scale_image(const core::pRawVideoFrame& frame, const resolution_t new_resolution, size_t threads)
-{
-    auto           outframe     = core::RawVideoFrame::create_empty(frame->get_format(), new_resolution);
-    const auto     res          = frame->get_resolution();
-    const double   unscale_x    = static_cast<double>(res.width - 1) / (new_resolution.width - 1);
-    const double   unscale_y    = static_cast<double>(res.height - 1) / (new_resolution.height - 1);
-    const auto     linesize_in  = PLANE_DATA(frame, 0).get_line_size();
-    const auto     linesize_out = PLANE_DATA(outframe, 0).get_line_size();
-    const uint8_t* it_in        = PLANE_RAW_DATA(frame, 0);
-    uint8_t*       it           = PLANE_RAW_DATA(outframe, 0);
-
-    if (threads < 2) {
-        for (dimension_t line = 0; line < new_resolution.height - 1; ++line) {
-            const dimension_t top     = static_cast<dimension_t>(line * unscale_y);
-            const dimension_t bottom  = top + 1;
-            const double      y_ratio = line * unscale_y - top;
-            kernel::eval(it, it_in + top * linesize_in, it_in + bottom * linesize_in, new_resolution.width, res.width, unscale_x, y_ratio);
-
-            it += linesize_out;
+core::pRawVideoFrame scale_image(const core::pRawVideoFrame& frame, const scale_plan_t& plan, row_workers_t& workers, bool hugepages)
+{
+    auto           outframe     = create_pooled_frame(plan.output_format, plan.output, hugepages);
+    const auto          linesize_in = PLANE_DATA(frame, 0).get_line_size();
+    const uint8_t*      it_in       = PLANE_RAW_DATA(frame, 0) + plan.offset.input_y * linesize_in + plan.offset.input_x;
+    const line_output_t output(outframe, 0, plan, plan.offset, plan.line_size);
+
+    auto f = [&](size_t start, size_t end) {
+        for (size_t line = start; line < end; ++line) {
+            const auto& step = plan.steps[line];
+            uint8_t*    out  = output.begin(line);
+            kernel::eval(out, it_in + step.top * linesize_in, it_in + step.bottom * linesize_in, plan.target.width, plan.source.width, plan.unscale_x,
+                         step.y_ratio_precise);
+            output.end(line, out);
         }
-    } else {
-        const size_t                   task_lines = new_resolution.height / threads;
-        std::vector<std::future<void>> results(threads);
-        size_t                         start_line = 0;
-        auto f                                    = [&](size_t start, size_t end) {
-            auto it2 = it + start * linesize_out;
-            for (dimension_t line = start; line < end; ++line) {
-                const dimension_t top     = static_cast<dimension_t>(line * unscale_y);
-                const dimension_t bottom  = top + 1;
-                const double      y_ratio = line * unscale_y - top;
-                kernel::eval(it2, it_in + top * linesize_in, it_in + bottom * linesize_in, new_resolution.width, res.width, unscale_x, y_ratio);
-                it2 += linesize_out;
+    };
+    workers.parallel_rows(plan.steps.size(), block_rows, f);
+    outframe->copy_video_params(*frame);
+    return outframe;
+}
+
+core::pRawVideoFrame scale_image_fast(const core::pRawVideoFrame& frame, const scale_plan_t& plan, row_workers_t& workers, bool hugepages)
+{
+    auto           outframe     = create_pooled_frame(plan.output_format, plan.output, hugepages);
+    const auto          linesize_in = PLANE_DATA(frame, 0).get_line_size();
+    const uint8_t*      it_in       = PLANE_RAW_DATA(frame, 0) + plan.offset.input_y * linesize_in + plan.offset.input_x;
+    const line_output_t output(outframe, 0, plan, plan.offset, plan.line_size);
+
+    // Lines are blended vertically first and then interpolated using the table
+    auto f = [&](size_t start, size_t end) {
+        // Kept per thread, the pool calls this for every block of rows
+        thread_local std::vector<uint16_t> blended;
+        blended.resize(linesize_in + 1);
+        for (size_t line = start; line < end; ++line) {
+            const auto& step = plan.steps[line];
+            uint8_t*    out  = output.begin(line);
+            blend_lines(blended.data(), it_in + step.top * linesize_in, it_in + step.bottom * linesize_in, plan.offset.input_size, step.y_ratio);
+            scale_line(out, blended.data(), plan.line);
+            output.end(line, out);
+        }
+    };
+    workers.parallel_rows(plan.steps.size(), block_rows, f);
+    outframe->copy_video_params(*frame);
+    return outframe;
+}
+
+core::pRawVideoFrame scale_image_planar(const core::pRawVideoFrame& frame, const scale_plan_t& plan, row_workers_t& workers, bool hugepages)
+{
+    auto outframe = create_pooled_frame(plan.output_format, plan.output, hugepages);
+    for (size_t i = 0; i < plan.planes.size(); ++i) {
+        const auto&    plane        = plan.planes[i];
+        const auto     linesize_in  = PLANE_DATA(frame, i).get_line_size();
+        const auto     linesize_out = PLANE_DATA(outframe, i).get_line_size();
+        const uint8_t* it_in        = PLANE_RAW_DATA(frame, i) + plane.offset.input_y * linesize_in + plane.offset.input_x;
+        uint8_t*       it           = PLANE_RAW_DATA(outframe, i) + plane.offset.output_y * linesize_out + plane.offset.output_x;
+        if (plane.sample_size == 1) {
+            workers.parallel_rows(plane.steps.size(), block_rows, [&](size_t start, size_t end) {
+                thread_local std::vector<uint16_t> blended;
+                blended.resize(linesize_in + 1);
+                for (size_t line = start; line < end; ++line) {
+                    const auto& step = plane.steps[line];
+                    blend_lines(blended.data(), it_in + step.top * linesize_in, it_in + step.bottom * linesize_in, plane.offset.input_size, step.y_ratio);
+                    scale_line(it + line * linesize_out, blended.data(), plane.line);
+                }
+            });
+        } else {
+            workers.parallel_rows(plane.steps.size(), block_rows, [&](size_t start, size_t end) {
+                thread_local std::vector<uint32_t> blended;
+                blended.resize(linesize_in / 2);
+                for (size_t line = start; line < end; ++line) {
+                    const auto& step = plane.steps[line];
+                    blend_lines16(blended.data(), reinterpret_cast<const uint16_t*>(it_in + step.top * linesize_in),
+                                  reinterpret_cast<const uint16_t*>(it_in + step.bottom * linesize_in), plane.offset.input_size / 2, step.y_ratio);
+                    scale_line16(reinterpret_cast<uint16_t*>(it + line * linesize_out), blended.data(), plane.line);
+                }
+            });
+        }
+    }
+    outframe->copy_video_params(*frame);
+    return outframe;
+}
+
+core::pRawVideoFrame scale_image_filtered(const core::pRawVideoFrame& frame, const scale_plan_t& plan, row_workers_t& workers, bool hugepages)
+{
+    auto outframe = create_pooled_frame(plan.output_format, plan.output, hugepages);
+    for (size_t i = 0; i < plan.filtered.size(); ++i) {
+        const auto&         plane       = plan.filtered[i];
+        const auto          linesize_in = PLANE_DATA(frame, i).get_line_size();
+        const uint8_t*      it_in       = PLANE_RAW_DATA(frame, i) + plane.offset.input_y * linesize_in + plane.offset.input_x;
+        const line_output_t output(outframe, i, plan, plane.offset, plane.horizontal.size);
+        const auto&         vertical = plane.vertical;
+        // Lines are filtered vertically first, so every source line is read only by the output lines it contributes to
+        workers.parallel_rows(vertical.size, block_rows, [&](size_t start, size_t end) {
+            thread_local std::vector<int16_t>        filtered;
+            thread_local std::vector<const uint8_t*> lines;
+            thread_local std::vector<int16_t>        weights;
+            filtered.resize(linesize_in + 1);
+            lines.resize(vertical.taps);
+            weights.resize(vertical.taps);
+            for (size_t line = start; line < end; ++line) {
+                for (size_t k = 0; k < vertical.taps; ++k) {
+                    lines[k]   = it_in + vertical.offsets[k * vertical.size + line] * linesize_in;
+                    weights[k] = vertical.weights[k * vertical.size + line];
+                }
+                filter_lines(filtered.data(), lines.data(), weights.data(), vertical.taps, plane.offset.input_size);
+                uint8_t* out = output.begin(line);
+                filter_line(out, filtered.data(), plane.horizontal);
+                output.end(line, out);
             }
-        };
-        for (auto i : irange(threads)) {
-            results[i] = std::async(std::launch::async, f, start_line, std::min(start_line + task_lines, new_resolution.height - 1));
-            start_line += task_lines;
+        });
+    }
+    outframe->copy_video_params(*frame);
+    return outframe;
+}
+
+void downscale_plane(const integer_plan_t& plane, const size_t ratio, const uint8_t* it_in, size_t linesize_in, const line_output_t& output,
+                     row_workers_t& workers)
+{
+    workers.parallel_rows(plane.output.height, block_rows, [&](size_t start, size_t end) {
+        thread_local std::vector<uint16_t> sums;
+        sums.resize(plane.offset.input_size);
+        for (size_t line = start; line < end; ++line) {
+            uint8_t* out = output.begin(line);
+            downscale_line(out, it_in + line * ratio * linesize_in, linesize_in, plane.offset.input_size, sums.data(), plane.channels, ratio);
+            output.end(line, out);
         }
-        for (auto& t : results) {
-            t.get();
+    });
+}
+
+core::pRawVideoFrame scale_image_integer(const core::pRawVideoFrame& frame, const scale_plan_t& plan, row_workers_t& workers, bool hugepages)
+{
+    auto outframe = create_pooled_frame(plan.output_format, plan.output, hugepages);
+    for (size_t i = 0; i < plan.integer.size(); ++i) {
+        const auto&         plane       = plan.integer[i];
+        const auto          linesize_in = PLANE_DATA(frame, i).get_line_size();
+        const uint8_t*      it_in       = PLANE_RAW_DATA(frame, i) + plane.offset.input_y * linesize_in + plane.offset.input_x;
+        const size_t        line_size   = plan.planes.empty() ? plan.line_size : plane.channels[0].stride * plane.output.width;
+        const line_output_t output(outframe, i, plan, plane.offset, line_size);
+        if (plan.integer_down) {
+            downscale_plane(plane, plan.integer_down, it_in, linesize_in, output, workers);
+            continue;
         }
+        // Every source line is replicated to two output lines
+        workers.parallel_rows(plane.input.height, block_rows, [&](size_t start, size_t end) {
+            for (size_t line = start; line < end; ++line) {
+                uint8_t* out = output.begin(2 * line);
+                upscale_line(out, it_in + line * linesize_in, plane.channels);
+                output.end(2 * line, out);
+                output.end(2 * line + 1, out);
+            }
+        });
     }
-    kernel::eval(PLANE_RAW_DATA(outframe, 0) + (new_resolution.height - 1) * linesize_out, PLANE_RAW_DATA(frame, 0) + (res.height - 1) * linesize_in,
-                 PLANE_RAW_DATA(frame, 0) + (res.height - 1) * linesize_in, new_resolution.width, res.width, unscale_x, 0.0);
     outframe->copy_video_params(*frame);
     return outframe;
 }
 
-template <class kernel>
-core::pRawVideoFrame scale_image_fast(const core::pRawVideoFrame& frame, const resolution_t new_resolution, size_t threads)
-{
-    auto           outframe     = core::RawVideoFrame::create_empty(frame->get_format(), new_resolution);
-    const auto     res          = frame->get_resolution();
-    const uint64_t unscale_x    = 256 * (res.width - 1) / (new_resolution.width - 1);
-    const uint64_t unscale_y    = 256 * (res.height - 1) / (new_resolution.height - 1);
-    const auto     linesize_in  = PLANE_DATA(frame, 0).get_line_size();
-    const auto     linesize_out = PLANE_DATA(outframe, 0).get_line_size();
-    const uint8_t* it_in        = PLANE_RAW_DATA(frame, 0);
-    uint8_t*       it           = PLANE_RAW_DATA(outframe, 0);
-
-    if (threads < 2) {
-        for (dimension_t line = 0; line < new_resolution.height - 1; ++line) {
-            const dimension_t top     = line * unscale_y;
-            const dimension_t bottom  = top + 256;
-            const uint64_t    y_ratio = line * unscale_y - top;
-            kernel::eval(it, it_in + top / 256 * linesize_in, it_in + bottom / 256 * linesize_in, new_resolution.width, res.width, unscale_x, y_ratio);
-
-            it += linesize_out;
+// Conversions available for the scaled lines
+convert_t get_converter(const format_t format, const format_t output_format)
+{
+    using namespace core::raw_format;
+    if (format == uyvy422 && output_format == bgra32)
+        return uyvy_to_bgra;
+    if (format == uyvy422 && output_format == rgba32)
+        return uyvy_to_rgba;
+    if (format == bgra32 && output_format == uyvy422)
+        return bgra_to_uyvy;
+    if (format == rgba32 && output_format == uyvy422)
+        return rgba_to_uyvy;
+    return nullptr;
+}
+
+// Scaled part of the input region and its placement in the output, aligned to even pixels for subsampled formats
+void get_geometry(const scale_mode_t mode, const geometry_t region, const resolution_t output, geometry_t& source, geometry_t& target)
+{
+    auto even     = [](uint64_t value) { return static_cast<dimension_t>(std::max<uint64_t>(value & ~1ull, 2)); };
+    source        = region;
+    target.width  = output.width;
+    target.height = output.height;
+    target.x      = 0;
+    target.y      = 0;
+    const uint64_t input_aspect  = static_cast<uint64_t>(region.width) * output.height;
+    const uint64_t output_aspect = static_cast<uint64_t>(output.width) * region.height;
+    if (mode == scale_mode_t::fit) {
+        if (input_aspect > output_aspect) {
+            target.height = std::min(even(static_cast<uint64_t>(region.height) * output.width / region.width), output.height);
+            target.y      = ((output.height - target.height) / 2) & ~1;
+        } else if (input_aspect < output_aspect) {
+            target.width = std::min(even(static_cast<uint64_t>(region.width) * output.height / region.height), output.width);
+            target.x     = ((output.width - target.width) / 2) & ~1;
+        }
+    } else if (mode == scale_mode_t::fill) {
+        if (input_aspect > output_aspect) {
+            source.width = std::min(even(static_cast<uint64_t>(output.width) * region.height / output.height), region.width);
+            source.x     = region.x + (((region.width - source.width) / 2) & ~1);
+        } else if (input_aspect < output_aspect) {
+            source.height = std::min(even(static_cast<uint64_t>(output.height) * region.width / output.width), region.height);
+            source.y      = region.y + (((region.height - source.height) / 2) & ~1);
+        }
+    }
+}
+
+// The frame is passed through or only converted when its whole picture is the region and it already has the output resolution
+bool is_unscaled(const resolution_t input, const geometry_t region, const resolution_t output)
+{
+    return input == output && region.width == output.width && region.height == output.height;
+}
+
+// Bytes of the colour for every plane of the format
+bool get_fill_patterns(const format_t format, const core::color_t& color, std::vector<std::vector<uint8_t>>& patterns)
+{
+    using namespace core::raw_format;
+    switch (format) {
+    case rgb24:
+        patterns = { { color.r(), color.g(), color.b() } };
+        return true;
+    case bgr24:
+        patterns = { { color.b(), color.g(), color.r() } };
+        return true;
+    case rgba32:
+        patterns = { { color.r(), color.g(), color.b(), color.a() } };
+        return true;
+    case argb32:
+        patterns = { { color.a(), color.r(), color.g(), color.b() } };
+        return true;
+    case bgra32:
+        patterns = { { color.b(), color.g(), color.r(), color.a() } };
+        return true;
+    case abgr32:
+        patterns = { { color.a(), color.b(), color.g(), color.r() } };
+        return true;
+    case yuv444:
+        patterns = { { color.y(), color.u(), color.v() } };
+        return true;
+    case yuva4444:
+        patterns = { { color.y(), color.u(), color.v(), color.a() } };
+        return true;
+    case yuyv422:
+        patterns = { { color.y(), color.u(), color.y(), color.v() } };
+        return true;
+    case yvyu422:
+        patterns = { { color.y(), color.v(), color.y(), color.u() } };
+        return true;
+    case uyvy422:
+        patterns = { { color.u(), color.y(), color.v(), color.y() } };
+        return true;
+    case vyuy422:
+        patterns = { { color.v(), color.y(), color.u(), color.y() } };
+        return true;
+    case yuv444p:
+    case yuv422p:
+    case yuv420p:
+        patterns = { { color.y() }, { color.u() }, { color.v() } };
+        return true;
+    case nv12:
+        patterns = { { color.y() }, { color.u(), color.v() } };
+        return true;
+    case y8:
+        patterns = { { color.y() } };
+        return true;
+    case y16:
+        patterns = { { static_cast<uint8_t>(color.y16() & 0xFF), static_cast<uint8_t>(color.y16() >> 8) } };
+        return true;
+    }
+    return false;
+}
+
+// Fills the output around the target, scaled pixels are not touched, so every output byte is still written once
+void fill_padding(const core::pRawVideoFrame& outframe, const scale_plan_t& plan, row_workers_t& workers)
+{
+    for (size_t i = 0; i < plan.fill.size(); ++i) {
+        const auto& fill     = plan.fill[i];
+        const auto  linesize = PLANE_DATA(outframe, i).get_line_size();
+        uint8_t*    data     = PLANE_RAW_DATA(outframe, i);
+        auto        fill_row = [&](uint8_t* row, size_t start, size_t end) {
+            for (size_t b = start; b < end; ++b) {
+                row[b] = fill.pattern[b % fill.pattern.size()];
+            }
+        };
+        workers.parallel_rows(fill.rows, block_rows, [&](size_t start, size_t end) {
+            for (size_t line = start; line < end; ++line) {
+                uint8_t* row = data + line * linesize;
+                if (line < fill.first_row || line >= fill.end_row) {
+                    fill_row(row, 0, fill.row_size);
+                } else {
+                    fill_row(row, 0, fill.left);
+                    fill_row(row, fill.right, fill.row_size);
+                }
+            }
+        });
+    }
+}
+
+bool get_line_layout(const format_t format, line_layout_t& layout)
+{
+    using namespace core::raw_format;
+    switch (format) {
+    case rgb24:
+    case bgr24:
+    case yuv444:
+        layout = line_layout_t::packed3;
+        return true;
+    case rgba32:
+    case argb32:
+    case bgra32:
+    case abgr32:
+    case yuva4444:
+        layout = line_layout_t::packed4;
+        return true;
+    case yuyv422:
+    case yvyu422:
+        layout = line_layout_t::yuyv;
+        return true;
+    case uyvy422:
+    case vyuy422:
+        layout = line_layout_t::uyvy;
+        return true;
+    }
+    return false;
+}
+
+// Bytes per pixel of packed formats, two pixels share the chroma in 4:2:2
+size_t get_pixel_size(const line_layout_t layout)
+{
+    return layout == line_layout_t::packed3 ? 3 : (layout == line_layout_t::packed4 ? 4 : 2);
+}
+
+// Positions of the source and target in the planes, the only part of the plan depending on the origin of the region
+void set_plan_offsets(scale_plan_t& plan)
+{
+    line_layout_t layout;
+    plan.offset = {};
+    if (get_line_layout(plan.format, layout)) {
+        const size_t  pixel_size = get_pixel_size(layout);
+        line_layout_t output_layout;
+        get_line_layout(plan.output_format, output_layout);
+        plan.offset = { pixel_size * plan.source.x, plan.source.y, get_pixel_size(output_layout) * plan.target.x, plan.target.y,
+                        pixel_size * plan.source.width };
+    }
+    thread_local std::vector<plane_layout_t> plane_layouts;
+    if (get_plane_layouts(plan.format, plane_layouts)) {
+        for (size_t i = 0; i < plan.planes.size(); ++i) {
+            const auto&  plane_layout = plane_layouts[i];
+            const size_t sample_size  = plane_layout.components * plane_layout.sample_size;
+            auto&        plane        = plan.planes[i];
+            plane.offset = { plan.source.x / plane_layout.sub_x * sample_size, plan.source.y / plane_layout.sub_y,
+                             plan.target.x / plane_layout.sub_x * sample_size, plan.target.y / plane_layout.sub_y, plane.input.width * sample_size };
+        }
+    }
+    // Filtered and integer plans cover either the packed line or all the planes
+    for (size_t i = 0; i < plan.filtered.size(); ++i) {
+        plan.filtered[i].offset = plan.planes.empty() ? plan.offset : plan.planes[i].offset;
+    }
+    for (size_t i = 0; i < plan.integer.size(); ++i) {
+        plan.integer[i].offset = plan.planes.empty() ? plan.offset : plan.planes[i].offset;
+    }
+}
+}
+
+color_matrix_t Scale::get_matrix(const format_t format, const resolution_t input, const resolution_t output) const
+{
+    if (color_matrix_ == "bt601")
+        return color_matrix_t::bt601;
+    if (color_matrix_ == "bt709")
+        return color_matrix_t::bt709;
+    // Follows the resolution of the YUV side
+    const resolution_t res = format == core::raw_format::uyvy422 ? input : output;
+    return default_color_matrix(res.width, res.height);
+}
+
+void Scale::update_plan(scale_plan_t& plan, const resolution_t input, const geometry_t region, const resolution_t output, const format_t format,
+                        const scale_mode_t mode)
+{
+    geometry_t source, target;
+    get_geometry(mode, region, output, source, target);
+    // Zooming of the virtual PTZ resizes the source every frame and the filter tables take up to a millisecond to build,
+    // so while it moves only the bilinear tables are built. The filter ones are built once it stops.
+    const bool moving  = ptz_.frame < ptz_frames_;
+    const bool resized = !plan.valid || !(plan.input == input) || !(plan.output == output);
+    if (!resized && plan.source.width == source.width && plan.source.height == source.height && plan.target.x == target.x
+        && plan.target.y == target.y && plan.target.width == target.width && plan.target.height == target.height && plan.mode == mode
+        && plan.format == format && plan.fast == fast_ && (plan.filter == filter_ || (moving && plan.filter == filter_t::bilinear))
+        && plan.convert == get_converter(format, output_format_)
+        && (!plan.convert || plan.matrix == get_matrix(format, input, output))) {
+        // Panning of the virtual PTZ only moves the source, the tables stay the same
+        if (plan.source.x != source.x || plan.source.y != source.y) {
+            plan.region = region;
+            plan.source = source;
+            set_plan_offsets(plan);
+        }
+        return;
+    }
+    const filter_t filter = moving && plan.valid ? filter_t::bilinear : filter_;
+
+    plan.input         = input;
+    plan.region        = region;
+    plan.output        = output;
+    plan.mode          = mode;
+    plan.format        = format;
+    plan.fast          = fast_;
+    plan.filter        = filter;
+    plan.convert       = get_converter(format, output_format_);
+    plan.output_format = plan.convert ? output_format_ : format;
+    plan.matrix        = get_matrix(format, input, output);
+    if (output_format_ && output_format_ != format && !plan.convert)
+        log[log::warning] << "Conversion from " << core::raw_format::get_format_name(format) << " to " << core::raw_format::get_format_name(output_format_)
+                          << " is not supported, keeping the input format";
+    // All the tables below scale the source part of the input to the target part of the output
+    plan.source = source;
+    plan.target = target;
+    const resolution_t in{ plan.source.width, plan.source.height };
+    const resolution_t out{ plan.target.width, plan.target.height };
+    // Same fixed point (fast) and floating point positions as the original per-pixel computations
+    const uint64_t unscale_x_fast = 256 * (in.width - 1) / (out.width - 1);
+    plan.unscale_x                = static_cast<double>(in.width - 1) / (out.width - 1);
+    build_line_steps(plan.steps, in.height, out.height, fast_);
+    line_layout_t layout;
+    if (fast_ && get_line_layout(format, layout))
+        build_line_table(plan.line, layout, in.width, out.width, unscale_x_fast);
+    plan.line_size = get_line_layout(format, layout) ? get_pixel_size(layout) * out.width : 0;
+    // Zooming rebuilds the tables every frame, so the existing elements are reused to keep their buffers
+    thread_local std::vector<plane_layout_t>   plane_layouts;
+    thread_local std::vector<filter_channel_t> filter_channels;
+    if (get_plane_layouts(format, plane_layouts)) {
+        plan.planes.resize(plane_layouts.size());
+        for (size_t i = 0; i < plane_layouts.size(); ++i) {
+            build_plane_plan(plan.planes[i], plane_layouts[i], in, out);
         }
     } else {
-        const size_t                   task_lines = new_resolution.height / threads;
-        std::vector<std::future<void>> results(threads);
-        size_t                         start_line = 0;
-        auto f                                    = [&](size_t start, size_t end) {
-            auto it2 = it + start * linesize_out;
-            for (dimension_t line = start; line < end; ++line) {
-                const dimension_t top     = line * unscale_y;
-                const dimension_t bottom  = top + 256;
-                const uint64_t    y_ratio = line * unscale_y - top;
-                kernel::eval(it2, it_in + top / 256 * linesize_in, it_in + bottom / 256 * linesize_in, new_resolution.width, res.width, unscale_x, y_ratio);
-
-                it2 += linesize_out;
+        plane_layouts.clear();
+        plan.planes.clear();
+    }
+    if (filter == filter_t::bilinear) {
+        plan.filtered.clear();
+    } else if (get_line_layout(format, layout)) {
+        plan.filtered.resize(1);
+        auto& plane  = plan.filtered[0];
+        plane.input  = in;
+        plane.output = out;
+        build_filter_table(plane.vertical, filter, in.height, out.height, 1);
+        get_filter_channels(filter_channels, layout, filter, in.width, out.width);
+        merge_filter_channels(plane.horizontal, filter_channels, get_pixel_size(layout) * out.width);
+    } else if (!plan.planes.empty() && plan.planes[0].sample_size == 1) {
+        // 16 bit planes stay bilinear
+        plan.filtered.resize(plane_layouts.size());
+        for (size_t i = 0; i < plane_layouts.size(); ++i) {
+            const auto& plane_layout = plane_layouts[i];
+            auto&       plane        = plan.filtered[i];
+            plane.input              = plan.planes[i].input;
+            plane.output             = plan.planes[i].output;
+            build_filter_table(plane.vertical, filter, plane.input.height, plane.output.height, plane_layout.centered_y ? 1 : plane_layout.sub_y);
+            filter_channels.resize(plane_layout.components);
+            for (size_t c = 0; c < plane_layout.components; ++c) {
+                build_filter_table(filter_channels[c].table, filter, plane.input.width, plane.output.width, plane_layout.sub_x);
+                filter_channels[c].stride = plane_layout.components;
+                filter_channels[c].offset = c;
             }
+            merge_filter_channels(plane.horizontal, filter_channels, plane_layout.components * plane.output.width);
+        }
+    } else {
+        plan.filtered.clear();
+    }
+    // Integer ratios are handled by specialized kernels, unless a filter of better quality was requested
+    plan.integer_down = 0;
+    plan.integer_up   = false;
+    plan.integer.clear();
+    if (fast_ && filter != filter_t::bicubic && filter != filter_t::lanczos) {
+        for (dimension_t ratio = 2; ratio <= 4; ++ratio) {
+            if (in.width == ratio * out.width && in.height == ratio * out.height)
+                plan.integer_down = ratio;
+        }
+        plan.integer_up = filter == filter_t::bilinear && out.width == 2 * in.width && out.height == 2 * in.height;
+    }
+    if (plan.integer_down || plan.integer_up) {
+        // Subsampled planes have to keep the ratio as well
+        const dimension_t ratio = plan.integer_down ? plan.integer_down : 2;
+        auto fits = [&](const resolution_t small, const resolution_t big) { return big.width == ratio * small.width && big.height == ratio * small.height; };
+        auto add  = [&](const resolution_t plane_input, const resolution_t plane_output, std::vector<integer_channel_t> channels) {
+            const bool valid = plan.integer_down ? fits(plane_output, plane_input) : fits(plane_input, plane_output);
+            plan.integer.push_back({ plane_input, plane_output, {}, std::move(channels) });
+            return valid;
         };
-        for (auto i : irange(threads)) {
-            results[i] = std::async(std::launch::async, f, start_line, std::min(start_line + task_lines, new_resolution.height - 1));
-            start_line += task_lines;
+        bool valid = true;
+        if (get_line_layout(format, layout)) {
+            valid = add(in, out, get_integer_channels(layout, in.width));
+        } else if (!plan.planes.empty() && plan.planes[0].sample_size == 1) {
+            for (size_t i = 0; i < plane_layouts.size(); ++i) {
+                const auto&                    plane = plan.planes[i];
+                std::vector<integer_channel_t> channels;
+                for (size_t c = 0; c < plane_layouts[i].components; ++c) {
+                    channels.push_back({ plane_layouts[i].components, c, plane.input.width });
+                }
+                valid = add(plane.input, plane.output, std::move(channels)) && valid;
+            }
+        } else {
+            valid = false;
         }
-        for (auto& t : results) {
-            t.get();
+        if (!valid) {
+            plan.integer_down = 0;
+            plan.integer_up   = false;
+            plan.integer.clear();
         }
     }
-    kernel::eval(PLANE_RAW_DATA(outframe, 0) + (new_resolution.height - 1) * linesize_out, PLANE_RAW_DATA(frame, 0) + (res.height - 1) * linesize_in,
-                 PLANE_RAW_DATA(frame, 0) + (res.height - 1) * linesize_in, new_resolution.width, res.width, unscale_x, 0.0);
-    outframe->copy_video_params(*frame);
-    return outframe;
-}
+    set_plan_offsets(plan);
+    // Padding of the parts of the output not covered by the target
+    plan.fill.clear();
+    std::vector<std::vector<uint8_t>> patterns;
+    if (!(out == output) && get_fill_patterns(plan.output_format, color_, patterns)) {
+        std::vector<plane_layout_t> output_layouts;
+        if (!get_plane_layouts(plan.output_format, output_layouts)) {
+            get_line_layout(plan.output_format, layout);
+            output_layouts = { { get_pixel_size(layout), 1, 1, 1, false } };
+        }
+        for (size_t i = 0; i < output_layouts.size(); ++i) {
+            const auto&  plane_layout = output_layouts[i];
+            const size_t sample_size  = plane_layout.components * plane_layout.sample_size;
+            fill_plane_t fill;
+            fill.rows      = output.height / plane_layout.sub_y;
+            fill.row_size  = output.width / plane_layout.sub_x * sample_size;
+            fill.first_row = plan.target.y / plane_layout.sub_y;
+            fill.end_row   = fill.first_row + out.height / plane_layout.sub_y;
+            fill.left      = plan.target.x / plane_layout.sub_x * sample_size;
+            fill.right     = fill.left + out.width / plane_layout.sub_x * sample_size;
+            fill.pattern   = patterns[i];
+            plan.fill.push_back(std::move(fill));
+        }
+    }
+    plan.valid = true;
+    // Zooming of the virtual PTZ rebuilds the tables every frame, it doesn't change the cost
+    if (resized) {
+        frame_cost_ = 0.0;
+        log[log::debug] << "Scaling tables rebuilt for " << in.width << "x" << in.height << " -> " << out.width << "x" << out.height << " using "
+                        << get_filter_name(filter) << " filter";
+    }
 }
 
-core::pFrame Scale::do_special_single_step(core::pRawVideoFrame frame)
+core::pRawVideoFrame Scale::scale_frame(const core::pRawVideoFrame& frame, scale_plan_t& plan, const geometry_t region, const resolution_t output,
+                                        const scale_mode_t mode, row_workers_t& workers)
 {
-    process_events();
-    if (frame->get_resolution() == resolution_)
-        return frame;
-    // Simple sanity check
-    if (resolution_.width > 1e5 || resolution_.height > 1e5)
-        return {};
-    if (resolution_.width == 0 && resolution_.height == 0)
-        return {};
-    // Resolution recompute (if one of the values is -1)
-    if (resolution_.width == 0)
-        resolution_.width = ((float)frame->get_resolution().width / (float)frame->get_resolution().height) * resolution_.height;
-    if (resolution_.height == 0)
-        resolution_.height = ((float)frame->get_resolution().height / (float)frame->get_resolution().width) * resolution_.width;
+    if (is_unscaled(frame->get_resolution(), region, output)) {
+        const auto convert = get_converter(frame->get_format(), output_format_);
+        if (!convert)
+            return frame;
+        // Only the conversion is needed
+        auto outframe = create_pooled_frame(output_format_, output, hugepages_);
+        convert(PLANE_RAW_DATA(frame, 0), PLANE_DATA(frame, 0).get_line_size(), PLANE_RAW_DATA(outframe, 0), PLANE_DATA(outframe, 0).get_line_size(),
+                output.width, output.height, get_matrix(frame->get_format(), output, output));
+        outframe->copy_video_params(*frame);
+        return outframe;
+    }
+    update_plan(plan, frame->get_resolution(), region, output, frame->get_format(), mode);
+    core::pRawVideoFrame outframe;
     using namespace core::raw_format;
-    if (fast_) {
+    if (!plan.integer.empty()) {
+        outframe = scale_image_integer(frame, plan, workers, hugepages_);
+    } else if (!plan.filtered.empty()) {
+        outframe = scale_image_filtered(frame, plan, workers, hugepages_);
+    } else if (!plan.planes.empty()) {
+        outframe = scale_image_planar(frame, plan, workers, hugepages_);
+    } else if (fast_) {
+        line_layout_t layout;
+        if (get_line_layout(frame->get_format(), layout))
+            outframe = scale_image_fast(frame, plan, workers, hugepages_);
+    } else {
         switch (frame->get_format()) {
         case rgb24:
         case bgr24:
         case yuv444:
-            return scale_image_fast<scale_line_bilinear_fast<3>>(frame, resolution_, threads_);
-
+            outframe = scale_image<scale_line_bilinear<3>>(frame, plan, workers, hugepages_);
+            break;
         case rgba32:
         case argb32:
         case bgra32:
         case abgr32:
         case yuva4444:
-            return scale_image_fast<scale_line_bilinear_fast<4>>(frame, resolution_, threads_);
+            outframe = scale_image<scale_line_bilinear<4>>(frame, plan, workers, hugepages_);
+            break;
         case yuyv422:
         case yvyu422:
-            return scale_image_fast<scale_line_bilinear_yuyv_fast>(frame, resolution_, threads_);
+            outframe = scale_image<scale_line_bilinear_yuyv>(frame, plan, workers, hugepages_);
+            break;
         case uyvy422:
         case vyuy422:
-            return scale_image_fast<scale_line_bilinear_uyvy_fast>(frame, resolution_, threads_);
+            outframe = scale_image<scale_line_bilinear_uyvy>(frame, plan, workers, hugepages_);
+            break;
+        }
+    }
+    // Padding touches only the bytes the scaling didn't write
+    if (outframe && !plan.fill.empty())
+        fill_padding(outframe, plan, workers);
+    return outframe;
+}
+
+core::pFrame Scale::do_special_single_step(core::pRawVideoFrame frame)
+{
+    process_events();
+    // Output 0 follows the resolution, the others the list of additional resolutions
+    std::vector<resolution_t> outputs{ resolution_ };
+    outputs.insert(outputs.end(), resolutions_.begin(), resolutions_.end());
+    plans_.resize(outputs.size());
+    for (auto& output : outputs) {
+        // Simple sanity check
+        if (output.width > 1e5 || output.height > 1e5)
+            output = resolution_t{ 0, 0 };
+        // Resolution recompute (if one of the values is -1), kept per frame so the aspect follows the input
+        if (output.width == 0)
+            output.width = ((float)frame->get_resolution().width / (float)frame->get_resolution().height) * output.height;
+        if (output.height == 0)
+            output.height = ((float)frame->get_resolution().height / (float)frame->get_resolution().width) * output.width;
+    }
+    auto pixels = [](const resolution_t res) { return static_cast<uint64_t>(res.width) * res.height; };
+    // Larger outputs are scaled first, so the smaller ones can be scaled from them
+    std::vector<size_t> order(outputs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return pixels(outputs[a]) > pixels(outputs[b]); });
+    const geometry_t                  region  = step_ptz(frame->get_resolution());
+    const size_t                      threads = threads_ ? threads_ : get_auto_threads();
+    row_workers_t                     workers(pool_, threads);
+    std::vector<core::pRawVideoFrame> outframes(outputs.size());
+    std::vector<geometry_t>           pictures(outputs.size());
+    for (const auto i : order) {
+        const auto& output = outputs[i];
+        if (output.width == 0 || output.height == 0)
+            continue;
+        // Cascades from the smallest output already scaled that still covers this one, so the input is read only once.
+        // Only the picture of the scaled output is used, the padding around it in the fit mode is left out and added again.
+        // Outputs of the other modes are reused only with the same aspect, as their cropping is already in them.
+        // The PTZ region is applied only to the input, the scaled outputs already contain just the region.
+        core::pRawVideoFrame source        = frame;
+        geometry_t           source_region = region;
+        for (size_t j = 0; j < outframes.size(); ++j) {
+            if (!outframes[j])
+                continue;
+            const auto     res      = outframes[j]->get_resolution();
+            const uint64_t aspect   = static_cast<uint64_t>(res.width) * output.height;
+            const uint64_t expected = static_cast<uint64_t>(output.width) * res.height;
+            const bool     same     = std::max(aspect, expected) - std::min(aspect, expected) <= expected / 100;
+            geometry_t     cropped, target;
+            get_geometry(mode_, pictures[j], output, cropped, target);
+            if (pictures[j].width >= target.width && pictures[j].height >= target.height && (mode_ == scale_mode_t::stretch || same)
+                && pixels({ pictures[j].width, pictures[j].height }) < pixels({ source_region.width, source_region.height })) {
+                source        = outframes[j];
+                source_region = pictures[j];
+            }
         }
+        outframes[i] = scale_frame(source, plans_[i], source_region, output, mode_, workers);
+        pictures[i]  = is_unscaled(source->get_resolution(), source_region, output) ? geometry_t{ output.width, output.height, 0, 0 } : plans_[i].target;
+    }
+    // Single threaded cost summed from the blocks, so waiting for the other threads isn't counted, smoothed over several frames
+    const double cost = workers.busy_time();
+    frame_cost_       = frame_cost_ > 0.0 ? 0.9 * frame_cost_ + 0.1 * cost : cost;
+    for (size_t i = 1; i < outframes.size(); ++i) {
+        if (outframes[i])
+            push_frame(i, outframes[i]);
+    }
+    return outframes[0];
+}
+
+void Scale::set_ptz_target(const roi_t& roi)
+{
+    ptz_.start  = ptz_.current;
+    ptz_.target = roi;
+    ptz_.frame  = 0;
+}
+
+geometry_t Scale::step_ptz(const resolution_t input)
+{
+    if (ptz_.frame < ptz_frames_) {
+        ++ptz_.frame;
+        // Eased in and out, so the moves start and stop smoothly
+        const double t     = static_cast<double>(ptz_.frame) / ptz_frames_;
+        const double ratio = t * t * (3.0 - 2.0 * t);
+        auto         mix   = [ratio](double start, double target) { return start + (target - start) * ratio; };
+        ptz_.current       = { mix(ptz_.start.x, ptz_.target.x), mix(ptz_.start.y, ptz_.target.y), mix(ptz_.start.width, ptz_.target.width),
+                               mix(ptz_.start.height, ptz_.target.height) };
     } else {
-        switch (frame->get_format()) {
-        case rgb24:
-        case bgr24:
-        case yuv444:
-            return scale_image<scale_line_bilinear<3>>(frame, resolution_, threads_);
+        ptz_.current = ptz_.target;
+    }
+    const auto& roi = ptz_.current;
+    if (roi.x <= 0.0 && roi.y <= 0.0 && roi.width >= 1.0 && roi.height >= 1.0)
+        return { input.width, input.height, 0, 0 };
+    // Even positions and sizes keep the chroma of subsampled formats intact
+    auto even = [](double value, dimension_t size) { return static_cast<dimension_t>(std::round(std::min(std::max(value, 0.0), 1.0) * size)) & ~1u; };
+    geometry_t region;
+    region.width  = std::min(std::max<dimension_t>(even(roi.width, input.width), 2), input.width);
+    region.height = std::min(std::max<dimension_t>(even(roi.height, input.height), 2), input.height);
+    region.x      = std::min<dimension_t>(even(roi.x, input.width), (input.width - region.width) & ~1u);
+    region.y      = std::min<dimension_t>(even(roi.y, input.height), (input.height - region.height) & ~1u);
+    return region;
+}
 
-        case rgba32:
-        case argb32:
-        case bgra32:
-        case abgr32:
-        case yuva4444:
-            return scale_image<scale_line_bilinear<4>>(frame, resolution_, threads_);
-        case yuyv422:
-        case yvyu422:
-            return scale_image<scale_line_bilinear_yuyv>(frame, resolution_, threads_);
-        case uyvy422:
-        case vyuy422:
-            return scale_image<scale_line_bilinear_uyvy>(frame, resolution_, threads_);
+size_t Scale::get_auto_threads() const
+{
+    const size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t       threads;
+    if (frame_cost_ > 0.0) {
+        threads = static_cast<size_t>(std::ceil(frame_cost_ / target_thread_cost));
+    } else {
+        // Rough guess before the first measurement, one thread per 1280x720 output pixels
+        size_t pixels = 0;
+        for (const auto& plan : plans_) {
+            pixels += plan.output.width * plan.output.height;
         }
+        threads = pixels / (1280 * 720) + 1;
     }
-    return {};
+    return std::max<size_t>(1, std::min(threads, max_threads));
 }
+
 bool Scale::set_param(const core::Parameter& param)
 {
-    if (assign_parameters(param)    //
-        (resolution_, "resolution") //
-        (fast_, "fast")             //
-        (threads_, "threads")       //
+    if (assign_parameters(param)                                          //
+        (resolution_, "resolution")                                       //
+        (fast_, "fast")                                                   //
+        (threads_, "threads")                                             //
+        (placement_.cpus, "cpus")                                         //
+        (placement_.numa_node, "numa_node")                               //
+        (max_zoom_, "max_zoom")                                           //
+        (ptz_frames_, "ptz_frames")                                       //
+        (hugepages_, "hugepages")                                         //
+        (color_matrix_, "color_matrix")                                   //
+        (color_, "color")                                                 //
+        .parsed<std::string>                                              //
+        (filter_, "filter", parse_filter)                                 //
+        (resolutions_, "resolutions", parse_resolutions)                  //
+        (mode_, "mode", parse_mode)                                       //
+        (output_format_, "output_format", core::raw_format::parse_format) //
         )
         return true;
     return base_type::set_param(param);
@@ -393,8 +1051,49 @@ bool Scale::do_process_event(const std::string& event_name, const event::pBasicE
         (resolution_, "resolution")      //
         (fast_, "fast")                  //
         (threads_, "threads")            //
+        (max_zoom_, "max_zoom")          //
+        (ptz_frames_, "ptz_frames")      //
         )
         return true;
+    // Virtual PTZ, the same events as the PTZ of ndi_input
+    if (assign_events(event_name, event) //
+        (ptz_.pan, "pan")                //
+        (ptz_.tilt, "tilt")              //
+        (ptz_.zoom, "zoom")              //
+        ) {
+        set_ptz_target(get_ptz_roi(ptz_, max_zoom_));
+        return true;
+    }
+    if (iequals(event_name, "pan_tilt")) {
+        if (event->get_type() != event::event_type_t::vector_event) {
+            log[log::info] << "Got pan_tilt event in wrong format, must be vector of two floats <-1..0..1>.";
+            return false;
+        }
+        auto val = event::get_value<event::EventVector>(event);
+        if (val.size() < 2)
+            return false;
+        ptz_.pan  = event::lex_cast_value<float>(val[0]);
+        ptz_.tilt = event::lex_cast_value<float>(val[1]);
+        set_ptz_target(get_ptz_roi(ptz_, max_zoom_));
+        return true;
+    }
+    if (iequals(event_name, "roi")) {
+        // Explicit ROI as x, y, width and height in 0.0 - 1.0 of the input
+        if (event->get_type() != event::event_type_t::vector_event) {
+            log[log::info] << "Got roi event in wrong format, must be vector of four floats <0..1>.";
+            return false;
+        }
+        auto val = event::get_value<event::EventVector>(event);
+        if (val.size() < 4)
+            return false;
+        roi_t roi;
+        roi.width  = std::min(std::max(event::lex_cast_value<double>(val[2]), 0.0), 1.0);
+        roi.height = std::min(std::max(event::lex_cast_value<double>(val[3]), 0.0), 1.0);
+        roi.x      = std::min(std::max(event::lex_cast_value<double>(val[0]), 0.0), 1.0 - roi.width);
+        roi.y      = std::min(std::max(event::lex_cast_value<double>(val[1]), 0.0), 1.0 - roi.height);
+        set_ptz_target(roi);
+        return true;
+    }
     return false;
 }
 } /* namespace scale */
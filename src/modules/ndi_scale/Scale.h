@@ -13,10 +13,114 @@
 #include "yuri/core/thread/SpecializedIOFilter.h"
 #include "yuri/core/frame/RawVideoFrame.h"
 #include "yuri/event/BasicEventConsumer.h"
+#include "yuri/core/utils/color.h"
+#include "../common/convert.h"
+#include "../common/thread_placement.h"
+#include "../common/thread_pool.h"
+#include "ScaleTables.h"
 
 namespace yuri {
 namespace scale {
 
+enum class scale_mode_t { stretch, fit, fill };
+
+// Offsets of the scaled part of a plane, x in bytes and y in lines
+struct plane_offset_t {
+    size_t input_x;
+    size_t input_y;
+    size_t output_x;
+    size_t output_y;
+    size_t input_size; // Bytes of the scaled part of a source line
+};
+
+// Padding of an output plane around the scaled part, all horizontal values in bytes
+struct fill_plane_t {
+    size_t               rows;
+    size_t               row_size;
+    size_t               first_row; // Rows [first_row, end_row) are padded only on the sides
+    size_t               end_row;
+    size_t               left;    // End of the left margin
+    size_t               right;   // Start of the right margin
+    std::vector<uint8_t> pattern; // Fill colour of one pixel (two for 4:2:2), repeats from the start of the line
+};
+
+// Colour conversion of the functions from convert.h
+using convert_t = void (*)(const uint8_t*, size_t, uint8_t*, size_t, size_t, size_t, color_matrix_t);
+
+// Tables of a single plane of planar formats
+struct plane_plan_t {
+    resolution_t             input;
+    resolution_t             output;
+    plane_offset_t           offset;
+    size_t                   sample_size; // Bytes per sample
+    line_table_t             line;
+    std::vector<line_step_t> steps;
+};
+
+// Tables of the separable filters for a single plane (or the whole line of packed formats)
+struct filter_plan_t {
+    resolution_t   input;
+    resolution_t   output;
+    plane_offset_t offset;
+    filter_table_t vertical;   // Offsets are source lines
+    filter_table_t horizontal; // Offsets are bytes of the source line
+};
+
+// Channels of a single plane (or the whole line of packed formats) for the integer ratio kernels
+struct integer_plan_t {
+    resolution_t                   input;
+    resolution_t                   output;
+    plane_offset_t                 offset;
+    std::vector<integer_channel_t> channels;
+};
+
+// Tables of one input resolution, output resolution and format combination
+struct scale_plan_t {
+    bool                        valid;        // False until the tables are built
+    resolution_t                input;
+    resolution_t                output;
+    scale_mode_t                mode;
+    geometry_t                  region;       // Part of the input selected by the virtual PTZ
+    geometry_t                  source;       // Scaled part of the region
+    geometry_t                  target;       // Part of the output the source is scaled to
+    plane_offset_t              offset;       // Offsets of source and target for packed formats
+    std::vector<fill_plane_t>   fill;         // Padding around the target, empty when the target covers the output
+    format_t                    format;
+    format_t                    output_format;
+    convert_t                   convert;      // Conversion of the scaled lines to output_format, nullptr for none
+    color_matrix_t              matrix;
+    size_t                      line_size;    // Size of a scaled line before the conversion
+    bool                        fast;
+    filter_t                    filter;       // Bilinear while the virtual PTZ zooms
+    double                      unscale_x;
+    line_table_t                line;
+    std::vector<line_step_t>    steps;
+    std::vector<plane_plan_t>   planes;       // Used for planar formats instead of line and steps
+    std::vector<filter_plan_t>  filtered;     // Used for filters other than bilinear instead of the tables above
+    dimension_t                 integer_down; // K for exact K:1 downscales (K of 2, 3 or 4), 0 otherwise
+    bool                        integer_up;   // Exact 2x upscale
+    std::vector<integer_plan_t> integer;      // Used for integer ratios instead of all the tables above
+};
+
+// Part of the input in 0.0 - 1.0 of its size
+struct roi_t {
+    double x;
+    double y;
+    double width;
+    double height;
+};
+
+// Virtual PTZ, the ROI moves from start to target over the transition frames
+struct virtual_ptz_t {
+    float  pan;  // -1.0 (left) - 1.0 (right), like the NDI PTZ
+    float  tilt; // -1.0 (bottom) - 1.0 (top)
+    float  zoom; // 0.0 (zoomed in) - 1.0 (zoomed out)
+    roi_t  start;
+    roi_t  target;
+    roi_t  current;
+    size_t frame; // Frames of the transition done
+};
+
 class Scale : public core::SpecializedIOFilter<core::RawVideoFrame>, public event::BasicEventConsumer {
     using base_type = core::SpecializedIOFilter<core::RawVideoFrame>;
 
@@ -25,15 +129,44 @@ public:
     static core::Parameters configure();
     Scale(const log::Log& log_, core::pwThreadBase parent, const core::Parameters& parameters);
     virtual ~Scale() noexcept;
+    virtual void run() override;
 
 private:
     virtual core::pFrame do_special_single_step(core::pRawVideoFrame frame) override;
     virtual bool set_param(const core::Parameter& param) override;
     virtual bool do_process_event(const std::string& event_name, const event::pBasicEvent& event) override;
+    // Rebuilds the tables if the resolutions or format have changed, only the bilinear ones while the virtual PTZ zooms
+    void update_plan(scale_plan_t& plan, const resolution_t input, const geometry_t region, const resolution_t output, const format_t format,
+                     const scale_mode_t mode);
+    // Scales the frame to a single output, returns the frame itself when nothing has to be done
+    core::pRawVideoFrame scale_frame(const core::pRawVideoFrame& frame, scale_plan_t& plan, const geometry_t region, const resolution_t output,
+                                     const scale_mode_t mode, row_workers_t& workers);
+    // Starts transition of the virtual PTZ to the ROI
+    void set_ptz_target(const roi_t& roi);
+    // Moves the virtual PTZ by one frame and returns its region of the input
+    geometry_t step_ptz(const resolution_t input);
+    // Matrix of the colour conversion for given input
+    color_matrix_t get_matrix(const format_t format, const resolution_t input, const resolution_t output) const;
+    // Thread count for the measured cost of recent frames
+    size_t get_auto_threads() const;
 
-    resolution_t resolution_;
-    bool         fast_;
-    size_t       threads_;
+    resolution_t                resolution_;
+    std::vector<resolution_t>   resolutions_; // Additional outputs, sent to pipes 1 and up
+    bool                        fast_;
+    filter_t                    filter_;
+    scale_mode_t                mode_;
+    core::color_t               color_;
+    format_t                    output_format_;
+    std::string                 color_matrix_;
+    size_t                      threads_;
+    thread_placement_t          placement_;
+    virtual_ptz_t               ptz_;
+    double                      max_zoom_;
+    size_t                      ptz_frames_;
+    bool                        hugepages_;
+    std::vector<scale_plan_t>   plans_; // One per output
+    double                      frame_cost_;
+    std::shared_ptr<row_pool_t> pool_;
 };
 
 } /* namespace scale */
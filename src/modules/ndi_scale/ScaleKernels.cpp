@@ -0,0 +1,438 @@
+/*
+ * ScaleKernels.cpp
+ */
+
+#include "ScaleKernels.h"
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SCALE_KERNELS_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define SCALE_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace yuri {
+namespace scale {
+
+namespace {
+
+void blend_lines_scalar(uint16_t* dst, const uint8_t* top, const uint8_t* bottom, size_t size, uint32_t y_ratio)
+{
+    const uint32_t y_ratio2 = 256 - y_ratio;
+    for (size_t i = 0; i < size; ++i) {
+        dst[i] = static_cast<uint16_t>(top[i] * y_ratio2 + bottom[i] * y_ratio);
+    }
+}
+
+void scale_line_scalar(uint8_t* dst, const uint16_t* blended, const line_table_t& table, size_t start)
+{
+    const size_t size = table.left.size();
+    for (size_t i = start; i < size; ++i) {
+        const uint32_t weight = table.weight[i];
+        dst[i] = static_cast<uint8_t>(((256 - weight) * blended[table.left[i]] + weight * blended[table.right[i]]) >> 16);
+    }
+}
+
+void filter_lines_scalar(int16_t* dst, const uint8_t* const* lines, const int16_t* weights, size_t taps, size_t size, size_t start)
+{
+    for (size_t i = start; i < size; ++i) {
+        int32_t sum = 128;
+        for (size_t k = 0; k < taps; ++k) {
+            sum += weights[k] * lines[k][i];
+        }
+        dst[i] = static_cast<int16_t>(sum >> 8);
+    }
+}
+
+void filter_line_scalar(uint8_t* dst, const int16_t* src, const filter_table_t& table, size_t start)
+{
+    const size_t size = table.size;
+    for (size_t i = start; i < size; ++i) {
+        int32_t sum = 1 << 19;
+        for (size_t k = 0; k < table.taps; ++k) {
+            sum += table.weights[k * size + i] * src[table.offsets[k * size + i]];
+        }
+        sum    = sum >> 20;
+        dst[i] = static_cast<uint8_t>(sum < 0 ? 0 : (sum > 255 ? 255 : sum));
+    }
+}
+
+#ifdef SCALE_KERNELS_X86
+
+__attribute__((target("sse4.1"))) void blend_lines_sse41(uint16_t* dst, const uint8_t* top, const uint8_t* bottom, size_t size, uint32_t y_ratio)
+{
+    // Both products fit to 16 bits (255 * 256), so does their sum
+    const __m128i y  = _mm_set1_epi16(static_cast<int16_t>(y_ratio));
+    const __m128i y2 = _mm_set1_epi16(static_cast<int16_t>(256 - y_ratio));
+    size_t        i  = 0;
+    for (; i + 8 <= size; i += 8) {
+        const __m128i t = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(top + i)));
+        const __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(bottom + i)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi16(_mm_mullo_epi16(t, y2), _mm_mullo_epi16(b, y)));
+    }
+    blend_lines_scalar(dst + i, top + i, bottom + i, size - i, y_ratio);
+}
+
+__attribute__((target("sse4.1"))) void scale_line_sse41(uint8_t* dst, const uint16_t* blended, const line_table_t& table)
+{
+    const size_t   size   = table.left.size();
+    const uint32_t* left  = table.left.data();
+    const uint32_t* right = table.right.data();
+    const __m128i  full   = _mm_set1_epi32(256);
+    size_t         i      = 0;
+    for (; i + 4 <= size; i += 4) {
+        const __m128i l = _mm_setr_epi32(blended[left[i]], blended[left[i + 1]], blended[left[i + 2]], blended[left[i + 3]]);
+        const __m128i r = _mm_setr_epi32(blended[right[i]], blended[right[i + 1]], blended[right[i + 2]], blended[right[i + 3]]);
+        const __m128i w = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(table.weight.data() + i)));
+        __m128i       v = _mm_add_epi32(_mm_mullo_epi32(_mm_sub_epi32(full, w), l), _mm_mullo_epi32(w, r));
+        v               = _mm_srli_epi32(v, 16);
+        v               = _mm_packus_epi16(_mm_packus_epi32(v, v), v);
+        const int32_t out = _mm_cvtsi128_si32(v);
+        std::memcpy(dst + i, &out, 4);
+    }
+    scale_line_scalar(dst, blended, table, i);
+}
+
+__attribute__((target("avx2"))) void blend_lines_avx2(uint16_t* dst, const uint8_t* top, const uint8_t* bottom, size_t size, uint32_t y_ratio)
+{
+    const __m256i y  = _mm256_set1_epi16(static_cast<int16_t>(y_ratio));
+    const __m256i y2 = _mm256_set1_epi16(static_cast<int16_t>(256 - y_ratio));
+    size_t        i  = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m256i t = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top + i)));
+        const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_add_epi16(_mm256_mullo_epi16(t, y2), _mm256_mullo_epi16(b, y)));
+    }
+    blend_lines_scalar(dst + i, top + i, bottom + i, size - i, y_ratio);
+}
+
+__attribute__((target("avx2"))) void scale_line_avx2(uint8_t* dst, const uint16_t* blended, const line_table_t& table)
+{
+    const size_t  size = table.left.size();
+    const int*    base = reinterpret_cast<const int*>(blended);
+    const __m256i full = _mm256_set1_epi32(256);
+    const __m256i mask = _mm256_set1_epi32(0xFFFF);
+    size_t        i    = 0;
+    for (; i + 8 <= size; i += 8) {
+        // Gathers 32 bits from 16 bit samples, the upper half belongs to the next sample
+        const __m256i li = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table.left.data() + i));
+        const __m256i ri = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table.right.data() + i));
+        const __m256i l  = _mm256_and_si256(_mm256_i32gather_epi32(base, li, 2), mask);
+        const __m256i r  = _mm256_and_si256(_mm256_i32gather_epi32(base, ri, 2), mask);
+        const __m256i w  = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table.weight.data() + i)));
+        __m256i       v  = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(full, w), l), _mm256_mullo_epi32(w, r));
+        v                = _mm256_srli_epi32(v, 16);
+        v                = _mm256_packus_epi16(_mm256_packus_epi32(v, v), v);
+        const int32_t lo = _mm_cvtsi128_si32(_mm256_castsi256_si128(v));
+        const int32_t hi = _mm_cvtsi128_si32(_mm256_extracti128_si256(v, 1));
+        std::memcpy(dst + i, &lo, 4);
+        std::memcpy(dst + i + 4, &hi, 4);
+    }
+    // GCC jumps to the scalar rest without vzeroupper, the dirty upper halves would slow down the SSE code running after it
+    _mm256_zeroupper();
+    scale_line_scalar(dst, blended, table, i);
+}
+
+__attribute__((target("avx2"))) void filter_lines_avx2(int16_t* dst, const uint8_t* const* lines, const int16_t* weights, size_t taps, size_t size)
+{
+    // Pairs of lines are interleaved and multiplied by pairs of weights, sums are kept in 32 bits
+    const __m256i round = _mm256_set1_epi32(128);
+    const __m256i zero  = _mm256_setzero_si256();
+    size_t        i     = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m256i lo = round;
+        __m256i hi = round;
+        size_t  k  = 0;
+        for (; k + 2 <= taps; k += 2) {
+            const __m256i  a    = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lines[k] + i)));
+            const __m256i  b    = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lines[k + 1] + i)));
+            const uint32_t pair = static_cast<uint16_t>(weights[k]) | (static_cast<uint32_t>(static_cast<uint16_t>(weights[k + 1])) << 16);
+            const __m256i  w    = _mm256_set1_epi32(static_cast<int32_t>(pair));
+            lo                  = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            hi                  = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+        if (k < taps) {
+            const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lines[k] + i)));
+            const __m256i w = _mm256_set1_epi32(static_cast<uint16_t>(weights[k]));
+            lo              = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, zero), w));
+            hi              = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, zero), w));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packs_epi32(_mm256_srai_epi32(lo, 8), _mm256_srai_epi32(hi, 8)));
+    }
+    filter_lines_scalar(dst, lines, weights, taps, size, i);
+}
+
+__attribute__((target("avx2"))) void filter_line_avx2(uint8_t* dst, const int16_t* src, const filter_table_t& table)
+{
+    const size_t  size  = table.size;
+    const int*    base  = reinterpret_cast<const int*>(src);
+    const __m256i round = _mm256_set1_epi32(1 << 19);
+    size_t        i     = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256i sum = round;
+        for (size_t k = 0; k < table.taps; ++k) {
+            // Gathers 32 bits from 16 bit samples, the upper half belongs to the next sample
+            const __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table.offsets.data() + k * size + i));
+            const __m256i v   = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_i32gather_epi32(base, idx, 2), 16), 16);
+            const __m256i w   = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table.weights.data() + k * size + i)));
+            sum               = _mm256_add_epi32(sum, _mm256_mullo_epi32(v, w));
+        }
+        sum              = _mm256_srai_epi32(sum, 20);
+        sum              = _mm256_packus_epi16(_mm256_packs_epi32(sum, sum), sum);
+        const int32_t lo = _mm_cvtsi128_si32(_mm256_castsi256_si128(sum));
+        const int32_t hi = _mm_cvtsi128_si32(_mm256_extracti128_si256(sum, 1));
+        std::memcpy(dst + i, &lo, 4);
+        std::memcpy(dst + i + 4, &hi, 4);
+    }
+    // Same as in scale_line_avx2, the scalar rest is reached without vzeroupper
+    _mm256_zeroupper();
+    filter_line_scalar(dst, src, table, i);
+}
+
+#endif
+
+#ifdef SCALE_KERNELS_NEON
+
+void blend_lines_neon(uint16_t* dst, const uint8_t* top, const uint8_t* bottom, size_t size, uint32_t y_ratio)
+{
+    size_t i = 0;
+    if (y_ratio == 0) {
+        // 256 doesn't fit to the 8 bit multiplier
+        for (; i + 8 <= size; i += 8) {
+            vst1q_u16(dst + i, vshll_n_u8(vld1_u8(top + i), 8));
+        }
+    } else {
+        const uint8x8_t y  = vdup_n_u8(static_cast<uint8_t>(y_ratio));
+        const uint8x8_t y2 = vdup_n_u8(static_cast<uint8_t>(256 - y_ratio));
+        for (; i + 8 <= size; i += 8) {
+            vst1q_u16(dst + i, vmlal_u8(vmull_u8(vld1_u8(top + i), y2), vld1_u8(bottom + i), y));
+        }
+    }
+    blend_lines_scalar(dst + i, top + i, bottom + i, size - i, y_ratio);
+}
+
+void scale_line_neon(uint8_t* dst, const uint16_t* blended, const line_table_t& table)
+{
+    const size_t     size = table.left.size();
+    const uint32x4_t full = vdupq_n_u32(256);
+    size_t           i    = 0;
+    for (; i + 4 <= size; i += 4) {
+        const uint32_t   lv[4] = { blended[table.left[i]], blended[table.left[i + 1]], blended[table.left[i + 2]], blended[table.left[i + 3]] };
+        const uint32_t   rv[4] = { blended[table.right[i]], blended[table.right[i + 1]], blended[table.right[i + 2]], blended[table.right[i + 3]] };
+        const uint32x4_t w     = vmovl_u16(vld1_u16(table.weight.data() + i));
+        uint32x4_t       v     = vmlaq_u32(vmulq_u32(vsubq_u32(full, w), vld1q_u32(lv)), w, vld1q_u32(rv));
+        const uint16x4_t n     = vshrn_n_u32(v, 16);
+        const uint8x8_t  b     = vmovn_u16(vcombine_u16(n, n));
+        vst1_lane_u32(reinterpret_cast<uint32_t*>(dst + i), vreinterpret_u32_u8(b), 0);
+    }
+    scale_line_scalar(dst, blended, table, i);
+}
+
+#endif
+
+void scale_line_default(uint8_t* dst, const uint16_t* blended, const line_table_t& table)
+{
+    scale_line_scalar(dst, blended, table, 0);
+}
+
+void filter_lines_default(int16_t* dst, const uint8_t* const* lines, const int16_t* weights, size_t taps, size_t size)
+{
+    filter_lines_scalar(dst, lines, weights, taps, size, 0);
+}
+
+void filter_line_default(uint8_t* dst, const int16_t* src, const filter_table_t& table)
+{
+    filter_line_scalar(dst, src, table, 0);
+}
+
+// Averages K x K blocks of one channel, sums hold K source lines added together
+template <size_t K, size_t stride>
+void average_channel(uint8_t* dst, const uint16_t* sums, const size_t offset, const size_t count)
+{
+    for (size_t i = 0; i < count / K; ++i) {
+        uint32_t sum = K * K / 2;
+        for (size_t m = 0; m < K; ++m) {
+            sum += sums[(i * K + m) * stride + offset];
+        }
+        dst[i * stride + offset] = static_cast<uint8_t>(sum / (K * K));
+    }
+}
+
+// Sums K source lines of size bytes (linesize_in apart) and averages the channels
+template <size_t K>
+void downscale_line_fixed(uint8_t* dst, const uint8_t* src, const size_t linesize_in, const size_t size, uint16_t* sums,
+                          const std::vector<integer_channel_t>& channels)
+{
+    for (size_t i = 0; i < size; ++i) {
+        uint16_t sum = 0;
+        for (size_t m = 0; m < K; ++m) {
+            sum += src[m * linesize_in + i];
+        }
+        sums[i] = sum;
+    }
+    for (const auto& channel : channels) {
+        switch (channel.stride) {
+        case 1:
+            average_channel<K, 1>(dst, sums, channel.offset, channel.count);
+            break;
+        case 2:
+            average_channel<K, 2>(dst, sums, channel.offset, channel.count);
+            break;
+        case 3:
+            average_channel<K, 3>(dst, sums, channel.offset, channel.count);
+            break;
+        case 4:
+            average_channel<K, 4>(dst, sums, channel.offset, channel.count);
+            break;
+        }
+    }
+}
+
+// Copies every sample of one channel to two adjacent output samples
+template <size_t stride>
+void replicate_channel(uint8_t* dst, const uint8_t* src, const size_t offset, const size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t value                = src[i * stride + offset];
+        dst[2 * i * stride + offset]       = value;
+        dst[(2 * i + 1) * stride + offset] = value;
+    }
+}
+
+struct kernels_t {
+    void (*blend)(uint16_t*, const uint8_t*, const uint8_t*, size_t, uint32_t);
+    void (*scale)(uint8_t*, const uint16_t*, const line_table_t&);
+    void (*filter_lines)(int16_t*, const uint8_t* const*, const int16_t*, size_t, size_t);
+    void (*filter_line)(uint8_t*, const int16_t*, const filter_table_t&);
+    const char* name;
+};
+
+// Kernel sets supported by the CPU, the best one first
+std::vector<kernels_t> get_supported_kernels()
+{
+    std::vector<kernels_t> sets;
+#ifdef SCALE_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        sets.push_back({ blend_lines_avx2, scale_line_avx2, filter_lines_avx2, filter_line_avx2, "avx2" });
+    if (__builtin_cpu_supports("sse4.1"))
+        sets.push_back({ blend_lines_sse41, scale_line_sse41, filter_lines_default, filter_line_default, "sse4.1" });
+#endif
+#ifdef SCALE_KERNELS_NEON
+    sets.push_back({ blend_lines_neon, scale_line_neon, filter_lines_default, filter_line_default, "neon" });
+#endif
+    sets.push_back({ blend_lines_scalar, scale_line_default, filter_lines_default, filter_line_default, "scalar" });
+    return sets;
+}
+
+kernels_t& get_kernels()
+{
+    static kernels_t kernels = get_supported_kernels().front();
+    return kernels;
+}
+
+} /* namespace */
+
+void blend_lines(uint16_t* dst, const uint8_t* top, const uint8_t* bottom, size_t size, uint32_t y_ratio)
+{
+    get_kernels().blend(dst, top, bottom, size, y_ratio);
+}
+
+void scale_line(uint8_t* dst, const uint16_t* blended, const line_table_t& table)
+{
+    get_kernels().scale(dst, blended, table);
+}
+
+void filter_lines(int16_t* dst, const uint8_t* const* lines, const int16_t* weights, size_t taps, size_t size)
+{
+    get_kernels().filter_lines(dst, lines, weights, taps, size);
+}
+
+void filter_line(uint8_t* dst, const int16_t* src, const filter_table_t& table)
+{
+    get_kernels().filter_line(dst, src, table);
+}
+
+void blend_lines16(uint32_t* dst, const uint16_t* top, const uint16_t* bottom, size_t size, uint32_t y_ratio)
+{
+    const uint32_t y_ratio2 = 256 - y_ratio;
+    for (size_t i = 0; i < size; ++i) {
+        dst[i] = top[i] * y_ratio2 + bottom[i] * y_ratio;
+    }
+}
+
+void scale_line16(uint16_t* dst, const uint32_t* blended, const line_table_t& table)
+{
+    // Both products are below 2^32 - 2^16, so is their sum
+    const size_t size = table.left.size();
+    for (size_t i = 0; i < size; ++i) {
+        const uint32_t weight = table.weight[i];
+        dst[i]                = static_cast<uint16_t>(((256 - weight) * blended[table.left[i]] + weight * blended[table.right[i]]) >> 16);
+    }
+}
+
+void downscale_line(uint8_t* dst, const uint8_t* src, const size_t linesize_in, const size_t size, uint16_t* sums,
+                    const std::vector<integer_channel_t>& channels, const size_t ratio)
+{
+    switch (ratio) {
+    case 2:
+        downscale_line_fixed<2>(dst, src, linesize_in, size, sums, channels);
+        break;
+    case 3:
+        downscale_line_fixed<3>(dst, src, linesize_in, size, sums, channels);
+        break;
+    case 4:
+        downscale_line_fixed<4>(dst, src, linesize_in, size, sums, channels);
+        break;
+    }
+}
+
+void upscale_line(uint8_t* dst, const uint8_t* src, const std::vector<integer_channel_t>& channels)
+{
+    for (const auto& channel : channels) {
+        switch (channel.stride) {
+        case 1:
+            replicate_channel<1>(dst, src, channel.offset, channel.count);
+            break;
+        case 2:
+            replicate_channel<2>(dst, src, channel.offset, channel.count);
+            break;
+        case 3:
+            replicate_channel<3>(dst, src, channel.offset, channel.count);
+            break;
+        case 4:
+            replicate_channel<4>(dst, src, channel.offset, channel.count);
+            break;
+        }
+    }
+}
+
+const char* scale_kernel_name()
+{
+    return get_kernels().name;
+}
+
+std::vector<std::string> get_scale_kernel_names()
+{
+    std::vector<std::string> names;
+    for (const auto& kernels : get_supported_kernels()) {
+        names.push_back(kernels.name);
+    }
+    return names;
+}
+
+bool set_scale_kernels(const std::string& name)
+{
+    for (const auto& kernels : get_supported_kernels()) {
+        if (name == kernels.name) {
+            get_kernels() = kernels;
+            return true;
+        }
+    }
+    return false;
+}
+
+} /* namespace scale */
+} /* namespace yuri */
@@ -0,0 +1,77 @@
+/*
+ * ScaleKernels.h
+ */
+
+#ifndef SCALEKERNELS_H_
+#define SCALEKERNELS_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace yuri {
+namespace scale {
+
+// Horizontal part of the fast bilinear scaling, one entry per output byte
+struct line_table_t {
+    std::vector<uint32_t> left;   // Offsets of the samples in the source line
+    std::vector<uint32_t> right;
+    std::vector<uint16_t> weight; // Weight of the right sample (0 - 255)
+};
+
+// Source lines of one output line
+struct line_step_t {
+    uint32_t top;
+    uint32_t bottom;
+    uint32_t y_ratio;         // Weight of the bottom line (0 - 255) for the fast path
+    double   y_ratio_precise; // Weight of the bottom line (0.0 - 1.0) for the precise path
+};
+
+enum class line_layout_t { packed3, packed4, yuyv, uyvy };
+
+// Taps of a separable filter in one direction, stored tap by tap (offsets[tap * size + i] belongs to output sample i)
+struct filter_table_t {
+    size_t                size;
+    size_t                taps;
+    std::vector<uint32_t> offsets; // Source lines or offsets of the samples in the source line
+    std::vector<int16_t>  weights; // In 1/16384, weights of every output sample sum to 16384
+};
+
+// Interleaved channel of a line for the integer ratio kernels, samples are at offset + index * stride
+struct integer_channel_t {
+    size_t stride;
+    size_t offset;
+    size_t count; // Samples in the source line
+};
+
+// Blends two source lines, result is top * (256 - y_ratio) + bottom * y_ratio.
+// Destination has to have one spare element, the vector kernels read 32 bits per sample.
+void blend_lines(uint16_t* dst, const uint8_t* top, const uint8_t* bottom, size_t size, uint32_t y_ratio);
+// Interpolates blended line horizontally, output is divided by 65536
+void scale_line(uint8_t* dst, const uint16_t* blended, const line_table_t& table);
+// 16 bit variants of the functions above, blended values keep 24 bits
+void blend_lines16(uint32_t* dst, const uint16_t* top, const uint16_t* bottom, size_t size, uint32_t y_ratio);
+void scale_line16(uint16_t* dst, const uint32_t* blended, const line_table_t& table);
+// Vertical pass of the separable filters, dst[i] = sum of weights[k] * lines[k][i] in 1/64
+void filter_lines(int16_t* dst, const uint8_t* const* lines, const int16_t* weights, size_t taps, size_t size);
+// Horizontal pass of the separable filters, clamps the output to 0 - 255.
+// Source has to have one spare element, the vector kernels read 32 bits per sample.
+void filter_line(uint8_t* dst, const int16_t* src, const filter_table_t& table);
+// Averages ratio x ratio blocks (ratio of 2, 3 or 4) of the channels of ratio source lines of size bytes, linesize_in apart.
+// Sums has to hold size elements.
+void downscale_line(uint8_t* dst, const uint8_t* src, size_t linesize_in, size_t size, uint16_t* sums, const std::vector<integer_channel_t>& channels,
+                    size_t ratio);
+// Replicates every sample of the channels to two adjacent output samples
+void upscale_line(uint8_t* dst, const uint8_t* src, const std::vector<integer_channel_t>& channels);
+// Returns name of the instruction set selected for the kernels
+const char* scale_kernel_name();
+// Names of the instruction sets supported by the CPU, the one selected by default first
+std::vector<std::string> get_scale_kernel_names();
+// Switches all the kernels to the named instruction set, returns false when the CPU doesn't support it.
+// Meant for tests and benchmarks, it mustn't be called while other threads scale.
+bool set_scale_kernels(const std::string& name);
+
+} /* namespace scale */
+} /* namespace yuri */
+#endif /* SCALEKERNELS_H_ */
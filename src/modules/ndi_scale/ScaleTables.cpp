@@ -0,0 +1,315 @@
+/*
+ * ScaleTables.cpp
+ */
+
+#include "ScaleTables.h"
+#include <algorithm>
+#include <cmath>
+
+namespace yuri {
+namespace scale {
+
+namespace {
+
+// Position (in 1/256 of a sample) of output sample index in a plane with size samples
+uint32_t get_plane_position(const size_t index, const double unscale, const double offset, const size_t size)
+{
+    const double position = std::round((index * unscale + offset) * 256.0);
+    return static_cast<uint32_t>(std::min(std::max(position, 0.0), (size - 1) * 256.0));
+}
+
+double filter_kernel(const filter_t filter, const double x)
+{
+    const double ax = std::abs(x);
+    switch (filter) {
+    case filter_t::bicubic:
+        // Catmull-Rom spline
+        if (ax < 1.0)
+            return (1.5 * ax - 2.5) * ax * ax + 1.0;
+        if (ax < 2.0)
+            return ((-0.5 * ax + 2.5) * ax - 4.0) * ax + 2.0;
+        return 0.0;
+    case filter_t::lanczos:
+        if (ax < 1e-8)
+            return 1.0;
+        if (ax < 3.0)
+            return 3.0 * std::sin(M_PI * ax) * std::sin(M_PI * ax / 3.0) / (M_PI * M_PI * ax * ax);
+        return 0.0;
+    default:
+        return ax < 1.0 ? 1.0 - ax : 0.0;
+    }
+}
+
+} /* namespace */
+
+void build_line_table(line_table_t& table, const line_layout_t layout, const size_t old_width, const size_t new_width, const uint64_t unscale_x)
+{
+    const size_t pixel_size = layout == line_layout_t::packed3 ? 3 : (layout == line_layout_t::packed4 ? 4 : 2);
+    const size_t line_size  = pixel_size * old_width;
+    table.left.clear();
+    table.right.clear();
+    table.weight.clear();
+    auto add = [&](size_t left, size_t right, uint64_t weight) {
+        table.left.push_back(static_cast<uint32_t>(left));
+        table.right.push_back(static_cast<uint32_t>(right < line_size ? right : left));
+        table.weight.push_back(static_cast<uint16_t>(weight));
+    };
+    auto add_y = [&](size_t pixel, size_t offset) {
+        const size_t left  = pixel * unscale_x;
+        const size_t right = left + 256;
+        add(left / 256 * 2 + offset, right / 256 * 2 + offset, pixel * unscale_x - left);
+    };
+    auto add_uv = [&](size_t pixel, size_t adjust, size_t offset) {
+        const size_t left0 = pixel * unscale_x;
+        const size_t left  = (left0 & ~0x1FF) + 256 * adjust;
+        const size_t right = left + 2 * 256;
+        add(left / 256 * 2 + offset, right / 256 * 2 + offset, (pixel * unscale_x - left0 + (left0 & 0x1FF)) / 2);
+    };
+    switch (layout) {
+    case line_layout_t::packed3:
+    case line_layout_t::packed4:
+        for (size_t pixel = 0; pixel < new_width - 1; ++pixel) {
+            const size_t left  = pixel * unscale_x;
+            const size_t right = left + 1;
+            for (size_t i = 0; i < pixel_size; ++i) {
+                add(left / 256 * pixel_size + i, right / 256 * pixel_size + i, pixel * unscale_x - left);
+            }
+        }
+        for (size_t i = 0; i < pixel_size; ++i) {
+            add((old_width - 1) * pixel_size + i, (old_width - 1) * pixel_size + i, 0);
+        }
+        break;
+    case line_layout_t::yuyv:
+        for (size_t pixel = 0; pixel + 1 < new_width; pixel += 2) {
+            add_y(pixel, 0);
+            add_uv(pixel, 0, 1);
+            add_y(pixel + 1, 0);
+            add_uv(pixel + 1, 1, 1);
+        }
+        break;
+    case line_layout_t::uyvy:
+        for (size_t pixel = 0; pixel + 1 < new_width; pixel += 2) {
+            add_uv(pixel, 0, 0);
+            add_y(pixel, 1);
+            add_uv(pixel + 1, 1, 0);
+            add_y(pixel + 1, 1);
+        }
+        break;
+    }
+}
+
+void build_line_steps(std::vector<line_step_t>& steps, const size_t old_height, const size_t new_height, const bool fast)
+{
+    // Same fixed point (fast) and floating point positions as the original per-pixel computations
+    const uint64_t unscale_y_fast = 256 * (old_height - 1) / (new_height - 1);
+    const double   unscale_y      = static_cast<double>(old_height - 1) / (new_height - 1);
+    steps.clear();
+    for (size_t line = 0; line < new_height - 1; ++line) {
+        line_step_t step;
+        if (fast) {
+            const size_t top = line * unscale_y_fast;
+            step.top         = top / 256;
+            step.bottom      = (top + 256) / 256;
+            step.y_ratio     = line * unscale_y_fast - top;
+        } else {
+            const size_t top     = static_cast<size_t>(line * unscale_y);
+            step.top             = top;
+            step.bottom          = top + 1;
+            step.y_ratio_precise = line * unscale_y - top;
+        }
+        steps.push_back(step);
+    }
+    // Last line uses only the last source line
+    line_step_t last;
+    last.top             = old_height - 1;
+    last.bottom          = old_height - 1;
+    last.y_ratio         = 0;
+    last.y_ratio_precise = 0.0;
+    steps.push_back(last);
+}
+
+void build_plane_tables(line_table_t& line, std::vector<line_step_t>& steps, const plane_layout_t& layout, const size_t input_width,
+                        const size_t input_height, const size_t output_width, const size_t output_height)
+{
+    const size_t plane_input_width   = input_width / layout.sub_x;
+    const size_t plane_input_height  = input_height / layout.sub_y;
+    const size_t plane_output_width  = output_width / layout.sub_x;
+    const size_t plane_output_height = output_height / layout.sub_y;
+    line.left.clear();
+    line.right.clear();
+    line.weight.clear();
+    steps.clear();
+    if (!plane_input_width || !plane_input_height)
+        return;
+    // Chroma sample i lies at luma position sub * i + center
+    const double unscale_x = output_width > 1 ? static_cast<double>(input_width - 1) / (output_width - 1) : 0.0;
+    const double unscale_y = output_height > 1 ? static_cast<double>(input_height - 1) / (output_height - 1) : 0.0;
+    const double center    = layout.centered_y ? (layout.sub_y - 1) / 2.0 : 0.0;
+    const double offset_y  = center * (unscale_y - 1.0) / layout.sub_y;
+    for (size_t pixel = 0; pixel < plane_output_width; ++pixel) {
+        const uint32_t position = get_plane_position(pixel, unscale_x, 0.0, plane_input_width);
+        const size_t   left     = position / 256;
+        const size_t   right    = std::min(left + 1, plane_input_width - 1);
+        for (size_t i = 0; i < layout.components; ++i) {
+            line.left.push_back(static_cast<uint32_t>(left * layout.components + i));
+            line.right.push_back(static_cast<uint32_t>(right * layout.components + i));
+            line.weight.push_back(static_cast<uint16_t>(position % 256));
+        }
+    }
+    for (size_t index = 0; index < plane_output_height; ++index) {
+        const uint32_t position = get_plane_position(index, unscale_y, offset_y, plane_input_height);
+        line_step_t    step;
+        step.top             = position / 256;
+        step.bottom          = std::min<uint32_t>(step.top + 1, plane_input_height - 1);
+        step.y_ratio         = position % 256;
+        step.y_ratio_precise = step.y_ratio / 256.0;
+        steps.push_back(step);
+    }
+}
+
+void build_filter_table(filter_table_t& table, filter_t filter, const size_t old_size, const size_t new_size, const size_t cosited)
+{
+    const double ratio = static_cast<double>(old_size) / new_size;
+    if (filter == filter_t::automatic)
+        filter = ratio > 1.0 ? filter_t::area : filter_t::bicubic;
+    const double scale   = std::max(ratio, 1.0);
+    const double radius  = filter == filter_t::bicubic ? 2.0 : (filter == filter_t::lanczos ? 3.0 : 1.0);
+    const double support = filter == filter_t::area ? scale / 2.0 + 0.5 : radius * scale;
+    const double offset  = -(ratio - 1.0) * (cosited - 1) / (2.0 * cosited);
+
+    // Taps of output sample i start at taps[i * stride], the buffers are kept between the rebuilds
+    const size_t                                         stride = static_cast<size_t>(std::ceil(2.0 * support)) + 3;
+    thread_local std::vector<std::pair<uint32_t, double>> taps;
+    thread_local std::vector<size_t>                      counts;
+    taps.resize(stride * new_size);
+    counts.assign(new_size, 0);
+    size_t max_taps = 1;
+    for (size_t i = 0; i < new_size; ++i) {
+        const double center = (i + 0.5) * ratio - 0.5 + offset;
+        double       sum    = 0.0;
+        auto*        sample = &taps[i * stride];
+        size_t&      count  = counts[i];
+        for (int64_t j = static_cast<int64_t>(std::floor(center - support)); j <= static_cast<int64_t>(std::ceil(center + support)); ++j) {
+            double weight;
+            if (filter == filter_t::area)
+                weight = std::max(0.0, std::min(j + 0.5, center + scale / 2.0) - std::max(j - 0.5, center - scale / 2.0));
+            else
+                weight = filter_kernel(filter, (j - center) / scale);
+            if (std::abs(weight) < 1e-9)
+                continue;
+            // Samples outside of the line are replaced by the edge samples
+            const uint32_t index = static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(j, 0), old_size - 1));
+            if (count && sample[count - 1].first == index)
+                sample[count - 1].second += weight;
+            else
+                sample[count++] = { index, weight };
+            sum += weight;
+        }
+        if (!count) {
+            sample[count++] = { static_cast<uint32_t>(std::min<double>(std::max(center, 0.0), old_size - 1)), 1.0 };
+            sum             = 1.0;
+        }
+        for (size_t k = 0; k < count; ++k) {
+            sample[k].second /= sum;
+        }
+        max_taps = std::max(max_taps, count);
+    }
+
+    table.size = new_size;
+    table.taps = max_taps;
+    table.offsets.assign(max_taps * new_size, 0);
+    table.weights.assign(max_taps * new_size, 0);
+    for (size_t i = 0; i < new_size; ++i) {
+        // Rounding error goes to the biggest weight, so flat areas stay flat
+        const auto* sample  = &taps[i * stride];
+        int32_t     sum     = 0;
+        size_t      biggest = 0;
+        for (size_t k = 0; k < counts[i]; ++k) {
+            const auto weight               = static_cast<int16_t>(std::lround(sample[k].second * 16384.0));
+            table.offsets[k * new_size + i] = sample[k].first;
+            table.weights[k * new_size + i] = weight;
+            sum += weight;
+            if (sample[k].second > sample[biggest].second)
+                biggest = k;
+        }
+        table.weights[biggest * new_size + i] += 16384 - sum;
+        // Unused taps read the first sample with zero weight
+        for (size_t k = counts[i]; k < max_taps; ++k) {
+            table.offsets[k * new_size + i] = sample[0].first;
+        }
+    }
+}
+
+void merge_filter_channels(filter_table_t& table, const std::vector<filter_channel_t>& channels, const size_t size)
+{
+    table.size = size;
+    table.taps = 1;
+    for (const auto& channel : channels) {
+        table.taps = std::max(table.taps, channel.table.taps);
+    }
+    table.offsets.assign(table.taps * size, 0);
+    table.weights.assign(table.taps * size, 0);
+    for (const auto& channel : channels) {
+        const auto& src = channel.table;
+        for (size_t i = 0; i < src.size; ++i) {
+            const size_t out = i * channel.stride + channel.offset;
+            for (size_t k = 0; k < table.taps; ++k) {
+                const size_t tap              = k < src.taps ? k : 0;
+                table.offsets[k * size + out] = static_cast<uint32_t>(src.offsets[tap * src.size + i] * channel.stride + channel.offset);
+                table.weights[k * size + out] = k < src.taps ? src.weights[k * src.size + i] : 0;
+            }
+        }
+    }
+}
+
+void get_filter_channels(std::vector<filter_channel_t>& channels, const line_layout_t layout, const filter_t filter, const size_t old_width,
+                         const size_t new_width)
+{
+    size_t count = 0;
+    auto   add   = [&](size_t old_size, size_t new_size, size_t cosited, size_t stride, size_t offset) {
+        if (channels.size() <= count)
+            channels.resize(count + 1);
+        auto& channel = channels[count++];
+        build_filter_table(channel.table, filter, old_size, new_size, cosited);
+        channel.stride = stride;
+        channel.offset = offset;
+    };
+    switch (layout) {
+    case line_layout_t::packed3:
+    case line_layout_t::packed4: {
+        const size_t pixel_size = layout == line_layout_t::packed3 ? 3 : 4;
+        for (size_t i = 0; i < pixel_size; ++i) {
+            add(old_width, new_width, 1, pixel_size, i);
+        }
+    } break;
+    case line_layout_t::yuyv:
+        add(old_width, new_width, 1, 2, 0);
+        add(old_width / 2, new_width / 2, 2, 4, 1);
+        add(old_width / 2, new_width / 2, 2, 4, 3);
+        break;
+    case line_layout_t::uyvy:
+        add(old_width / 2, new_width / 2, 2, 4, 0);
+        add(old_width, new_width, 1, 2, 1);
+        add(old_width / 2, new_width / 2, 2, 4, 2);
+        break;
+    }
+    channels.resize(count);
+}
+
+std::vector<integer_channel_t> get_integer_channels(const line_layout_t layout, const size_t width)
+{
+    switch (layout) {
+    case line_layout_t::packed3:
+        return { { 3, 0, width }, { 3, 1, width }, { 3, 2, width } };
+    case line_layout_t::packed4:
+        return { { 4, 0, width }, { 4, 1, width }, { 4, 2, width }, { 4, 3, width } };
+    case line_layout_t::yuyv:
+        return { { 2, 0, width }, { 4, 1, width / 2 }, { 4, 3, width / 2 } };
+    case line_layout_t::uyvy:
+        return { { 4, 0, width / 2 }, { 2, 1, width }, { 4, 2, width / 2 } };
+    }
+    return {};
+}
+
+} /* namespace scale */
+} /* namespace yuri */
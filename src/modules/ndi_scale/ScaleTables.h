@@ -0,0 +1,58 @@
+/*
+ * ScaleTables.h
+ */
+
+#ifndef SCALETABLES_H_
+#define SCALETABLES_H_
+
+#include "ScaleKernels.h"
+
+namespace yuri {
+namespace scale {
+
+enum class filter_t { bilinear, area, bicubic, lanczos, automatic };
+
+// Layout of a plane of planar formats
+struct plane_layout_t {
+    size_t components;  // Interleaved samples per pixel
+    size_t sample_size; // Bytes per sample
+    size_t sub_x;
+    size_t sub_y;
+    bool   centered_y; // Chroma sited between the luma lines (4:2:0), otherwise co-sited with them
+};
+
+// Builds offsets and weights of the fast bilinear scaling for every output byte.
+// Indexing follows the scalar implementation (positions in 1/256 of pixel), so the vectorized kernels produce the same output.
+// Only chroma samples that would be read past the end of the source line are clamped.
+void build_line_table(line_table_t& table, const line_layout_t layout, const size_t old_width, const size_t new_width, const uint64_t unscale_x);
+// Source lines of the bilinear scaling for every output line, the last output line uses only the last source line.
+// Fast steps use positions in 1/256 of a line, the precise ones floating point positions.
+void build_line_steps(std::vector<line_step_t>& steps, const size_t old_height, const size_t new_height, const bool fast);
+// Tables of bilinear scaling of a plane, sizes are of the luma plane (whole image).
+// All planes are mapped through luma positions, so subsampled planes keep their siting.
+void build_plane_tables(line_table_t& line, std::vector<line_step_t>& steps, const plane_layout_t& layout, const size_t input_width,
+                        const size_t input_height, const size_t output_width, const size_t output_height);
+
+// Interleaved channel of a line, samples are at offset + index * stride in both source and output line
+struct filter_channel_t {
+    filter_table_t table;
+    size_t         stride;
+    size_t         offset;
+};
+
+// Builds weights of old_size source samples for new_size output samples.
+// Filters are stretched when downscaling, so every source sample contributes. Area filter averages the source samples
+// covered by the output sample. Subsampled planes co-sited with luma (cosited > 1) are shifted to keep the siting.
+void build_filter_table(filter_table_t& table, filter_t filter, const size_t old_size, const size_t new_size, const size_t cosited);
+// Merges tables of the channels into a table with one entry per output byte
+void merge_filter_channels(filter_table_t& table, const std::vector<filter_channel_t>& channels, const size_t size);
+// Channels of packed formats, chroma of 4:2:2 formats is co-sited with the even luma samples.
+// Tables of the channels already in the vector are rebuilt in place.
+void get_filter_channels(std::vector<filter_channel_t>& channels, const line_layout_t layout, const filter_t filter, const size_t old_width,
+                         const size_t new_width);
+// Channels of packed formats for the integer ratio kernels
+std::vector<integer_channel_t> get_integer_channels(const line_layout_t layout, const size_t width);
+
+} /* namespace scale */
+} /* namespace yuri */
+#endif /* SCALETABLES_H_ */
@@ -0,0 +1,21 @@
+#ifndef _NDI_TESTS_BENCH_H_
+#define _NDI_TESTS_BENCH_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+// Best time of one call of fn (in seconds) over repeats runs, the first call only warms up the caches
+template<class F>
+double bench_seconds(F fn, size_t repeats = 20) {
+	fn();
+	double best = 1e9;
+	for (size_t i = 0; i < repeats; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		fn();
+		best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	return best;
+}
+
+#endif
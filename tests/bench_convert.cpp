@@ -0,0 +1,44 @@
+#include "bench.h"
+#include "../src/modules/common/convert.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Throughput of the conversions of a 1080p frame with every instruction set supported by the CPU
+int main() {
+	const size_t width = 1920, height = 1080;
+	std::vector<uint8_t> uyvy(width * height * 2, 128), rgb(width * height * 4, 128), alpha(width * height, 255);
+	std::vector<uint8_t> y(width * height, 128), u(width / 2 * height / 2, 128), v(u.size(), 128), uv(width * height / 2, 128);
+	std::vector<uint8_t> y16(width * height * 2, 128), uv16(y16.size(), 128);
+	auto report = [&](const char* name, double seconds) {
+		std::printf("%-16s %8.3f ms %8.1f Mpix/s\n", name, seconds * 1e3, width * height / seconds * 1e-6);
+	};
+	for (const auto& name: get_convert_kernel_names()) {
+		set_convert_kernels(name);
+		std::printf("%s:\n", name.c_str());
+		report("uyvy_to_bgra", bench_seconds([&] { uyvy_to_bgra(uyvy.data(), width * 2, rgb.data(), width * 4, width, height, color_matrix_t::bt709); }));
+		report("uyvy_to_rgba", bench_seconds([&] { uyvy_to_rgba(uyvy.data(), width * 2, rgb.data(), width * 4, width, height, color_matrix_t::bt709); }));
+		report("uyva_to_bgra", bench_seconds([&] {
+			uyva_to_bgra(uyvy.data(), width * 2, alpha.data(), width, rgb.data(), width * 4, width, height, color_matrix_t::bt709);
+		}));
+		report("bgra_to_uyvy", bench_seconds([&] { bgra_to_uyvy(rgb.data(), width * 4, uyvy.data(), width * 2, width, height, color_matrix_t::bt709); }));
+		report("rgba_to_uyvy", bench_seconds([&] { rgba_to_uyvy(rgb.data(), width * 4, uyvy.data(), width * 2, width, height, color_matrix_t::bt709); }));
+		report("i420_to_uyvy", bench_seconds([&] {
+			i420_to_uyvy(y.data(), width, u.data(), v.data(), width / 2, uyvy.data(), width * 2, width, height);
+		}));
+		report("uyvy_to_i420", bench_seconds([&] {
+			uyvy_to_i420(uyvy.data(), width * 2, y.data(), width, u.data(), v.data(), width / 2, width, height);
+		}));
+		report("nv12_to_uyvy", bench_seconds([&] { nv12_to_uyvy(y.data(), width, uv.data(), width, uyvy.data(), width * 2, width, height); }));
+		report("uyvy_to_nv12", bench_seconds([&] { uyvy_to_nv12(uyvy.data(), width * 2, y.data(), width, uv.data(), width, width, height); }));
+		report("nv12_split_uv", bench_seconds([&] { nv12_split_uv(uv.data(), width, u.data(), width / 2, v.data(), width / 2, width / 2, height / 2); }));
+		report("p216_to_uyvy", bench_seconds([&] {
+			p216_to_uyvy(y16.data(), width * 2, uv16.data(), width * 2, uyvy.data(), width * 2, width, height);
+		}));
+		report("uyvy_to_p216", bench_seconds([&] {
+			uyvy_to_p216(uyvy.data(), width * 2, y16.data(), width * 2, uv16.data(), width * 2, width, height);
+		}));
+	}
+	return 0;
+}
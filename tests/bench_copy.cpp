@@ -0,0 +1,45 @@
+#include "bench.h"
+#include "../src/modules/common/copy.h"
+#include "../src/modules/common/thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Throughput of the plane copies of common frame sizes against memcpy and std::copy
+int main() {
+	struct plane_t {
+		const char* name;
+		size_t line_size;
+		size_t height;
+	};
+	const plane_t planes[] = {
+		{"1080p uyvy", 1920 * 2, 1080},
+		{"2160p uyvy", 3840 * 2, 2160},
+		{"2160p rgba", 3840 * 4, 2160},
+	};
+	auto pool = get_row_pool("bench", {});
+	for (const auto& plane: planes) {
+		const size_t size = plane.line_size * plane.height;
+		std::vector<uint8_t> src(size, 1), dst(size);
+		auto report = [&](const char* method, double seconds) {
+			std::printf("%-12s %-20s %8.3f ms %8.2f GB/s\n", plane.name, method, seconds * 1e3, size / seconds * 1e-9);
+		};
+		report("memcpy", bench_seconds([&] { std::memcpy(dst.data(), src.data(), size); }));
+		report("std::copy", bench_seconds([&] { std::copy(src.begin(), src.end(), dst.begin()); }));
+		report("stream_copy_plane", bench_seconds([&] {
+			stream_copy_plane(dst.data(), plane.line_size, src.data(), plane.line_size, plane.line_size, plane.height);
+		}));
+		for (size_t threads: {2, 4}) {
+			row_workers_t workers(pool, threads);
+			const std::string method = "stream_copy_plane/" + std::to_string(threads);
+			report(method.c_str(), bench_seconds([&] {
+				stream_copy_plane(dst.data(), plane.line_size, src.data(), plane.line_size, plane.line_size, plane.height, &workers);
+			}));
+		}
+	}
+	return 0;
+}
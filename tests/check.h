@@ -0,0 +1,19 @@
+#ifndef _NDI_TESTS_CHECK_H_
+#define _NDI_TESTS_CHECK_H_
+
+#include <cstdio>
+
+// Failed checks are reported and counted, the test returns the count at the end
+inline int& check_failures() {
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		++check_failures(); \
+	} \
+} while (0)
+
+#endif
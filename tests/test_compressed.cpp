@@ -0,0 +1,178 @@
+#include "check.h"
+#include "../src/modules/common/compressed.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+// Compressed (NDI|HX) passthrough against a stub NDI library, which captures the sent packets.
+// Packet headers are checked field by field, the bitstream has to be passed unchanged
+// and parameter sets have to be appended only to keyframes.
+
+namespace {
+
+static_assert(sizeof(ndi_compressed_packet_t) == 44, "NDI|HX packet header has to be 44 bytes");
+static_assert(offsetof(ndi_compressed_packet_t, pts) == 8, "Unexpected NDI|HX header layout");
+static_assert(offsetof(ndi_compressed_packet_t, flags) == 32, "Unexpected NDI|HX header layout");
+static_assert(offsetof(ndi_compressed_packet_t, extra_data_size) == 40, "Unexpected NDI|HX header layout");
+
+struct sent_frame_t {
+	NDIlib_send_instance_t sender;
+	uint32_t fourcc;
+	int xres;
+	int yres;
+	int64_t timecode;
+	std::vector<uint8_t> data;
+};
+
+std::vector<sent_frame_t>& sent_frames() {
+	static std::vector<sent_frame_t> frames;
+	return frames;
+}
+
+void stub_send_video_v2(NDIlib_send_instance_t sender, const NDIlib_video_frame_v2_t* frame) {
+	sent_frame_t sent;
+	sent.sender = sender;
+	sent.fourcc = static_cast<uint32_t>(frame->FourCC);
+	sent.xres = frame->xres;
+	sent.yres = frame->yres;
+	sent.timecode = frame->timecode;
+	sent.data.assign(frame->p_data, frame->p_data + frame->data_size_in_bytes);
+	sent_frames().push_back(std::move(sent));
+}
+
+// Only the entry used by the passthrough is set, calling any other one crashes the test
+NDIlib_v5 make_stub_library() {
+	NDIlib_v5 lib;
+	std::memset(&lib, 0, sizeof(lib));
+	lib.send_send_video_v2 = stub_send_video_v2;
+	return lib;
+}
+
+using bytes_t = std::vector<uint8_t>;
+
+bytes_t concat(std::initializer_list<bytes_t> parts) {
+	bytes_t result;
+	for (const auto& part: parts)
+		result.insert(result.end(), part.begin(), part.end());
+	return result;
+}
+
+// Sends the frame through the stub and checks the captured packet, returns its extra data
+bytes_t check_sent(const NDIlib_v5& lib, uint32_t fourcc, const bytes_t& frame_data, int64_t pts, bool keyframe,
+		bytes_t& packet, bytes_t& parameter_sets) {
+	NDIlib_send_instance_t sender = reinterpret_cast<NDIlib_send_instance_t>(0x1234);
+	NDIlib_video_frame_v2_t frame;
+	frame.xres = 1920;
+	frame.yres = 1080;
+	frame.timecode = 42;
+	sent_frames().clear();
+	CHECK(send_ndi_compressed_frame(&lib, sender, frame, fourcc, frame_data.data(), frame_data.size(), pts,
+			packet, parameter_sets) == keyframe);
+	CHECK(sent_frames().size() == 1);
+	if (sent_frames().size() != 1)
+		return {};
+	const auto& sent = sent_frames().front();
+	// Fields set by the caller are kept
+	CHECK(sent.sender == sender);
+	CHECK(sent.fourcc == fourcc);
+	CHECK(sent.xres == 1920 && sent.yres == 1080);
+	CHECK(sent.timecode == 42);
+
+	CHECK(sent.data.size() >= sizeof(ndi_compressed_packet_t));
+	if (sent.data.size() < sizeof(ndi_compressed_packet_t))
+		return {};
+	ndi_compressed_packet_t header;
+	std::memcpy(&header, sent.data.data(), sizeof(header));
+	CHECK(header.version == ndi_compressed_packet_version_0);
+	CHECK(header.version == 44);
+	CHECK(header.fourCC == fourcc);
+	CHECK(header.pts == pts);
+	CHECK(header.dts == pts);
+	CHECK(header.reserved == 0);
+	CHECK(header.flags == (keyframe ? ndi_compressed_packet_flags_keyframe : 0));
+	CHECK(header.data_size == frame_data.size());
+	CHECK(sent.data.size() == sizeof(header) + header.data_size + header.extra_data_size);
+	if (sent.data.size() != sizeof(header) + header.data_size + header.extra_data_size)
+		return {};
+	const auto bitstream = sent.data.begin() + sizeof(header);
+	CHECK(bytes_t(bitstream, bitstream + header.data_size) == frame_data);
+	if (!keyframe)
+		CHECK(header.extra_data_size == 0);
+	return bytes_t(bitstream + header.data_size, sent.data.end());
+}
+
+const bytes_t start4 = {0, 0, 0, 1};
+const bytes_t start3 = {0, 0, 1};
+
+void check_h264() {
+	const auto lib = make_stub_library();
+	const bytes_t sps = {0x67, 0x42, 0xc0, 0x1f, 0x8c};
+	const bytes_t pps = {0x68, 0xce, 0x3c, 0x80};
+	const bytes_t sei = {0x06, 0x05, 0x01, 0x80};
+	const bytes_t idr = {0x65, 0x88, 0x84, 0x00, 0x33};
+	const bytes_t slice = {0x41, 0x9a, 0x02, 0x10};
+	bytes_t packet, parameter_sets;
+
+	// Mixed 3 and 4 byte start codes, zeros of the 4 byte ones aren't part of the preceding NAL
+	const auto keyframe = concat({start4, sps, start4, pps, start3, sei, start4, idr});
+	CHECK(check_sent(lib, ndi_compressed_fourcc_h264, keyframe, 1000, true, packet, parameter_sets)
+			== concat({start4, sps, start4, pps}));
+
+	const auto delta = concat({start4, slice});
+	check_sent(lib, ndi_compressed_fourcc_h264, delta, 1400, false, packet, parameter_sets);
+	CHECK(parameter_sets == concat({start4, sps, start4, pps}));
+
+	// Keyframe without SPS/PPS gets the last seen ones
+	CHECK(check_sent(lib, ndi_compressed_fourcc_h264, concat({start3, idr}), 1800, true, packet, parameter_sets)
+			== concat({start4, sps, start4, pps}));
+
+	// New parameter sets replace the old ones
+	const bytes_t sps2 = {0x67, 0x64, 0x00, 0x28};
+	CHECK(check_sent(lib, ndi_compressed_fourcc_h264, concat({start4, sps2, start4, pps, start4, idr}), 2200, true,
+			packet, parameter_sets) == concat({start4, sps2, start4, pps}));
+}
+
+void check_hevc() {
+	const auto lib = make_stub_library();
+	const bytes_t vps = {0x40, 0x01, 0x0c, 0x01};
+	const bytes_t sps = {0x42, 0x01, 0x01, 0x01, 0x60};
+	const bytes_t pps = {0x44, 0x01, 0xc1, 0x72};
+	const bytes_t idr = {0x26, 0x01, 0xaf, 0x06};   // IDR_W_RADL
+	const bytes_t cra = {0x2a, 0x01, 0xac, 0x05};   // CRA
+	const bytes_t trail = {0x02, 0x01, 0xd0, 0x09}; // TRAIL_R
+	bytes_t packet, parameter_sets;
+
+	CHECK(check_sent(lib, ndi_compressed_fourcc_hevc, concat({start4, vps, start4, sps, start4, pps, start4, idr}), 0, true,
+			packet, parameter_sets) == concat({start4, vps, start4, sps, start4, pps}));
+	check_sent(lib, ndi_compressed_fourcc_hevc, concat({start4, trail}), 400, false, packet, parameter_sets);
+	CHECK(check_sent(lib, ndi_compressed_fourcc_hevc, concat({start3, cra}), 800, true, packet, parameter_sets)
+			== concat({start4, vps, start4, sps, start4, pps}));
+
+	// H.264 NAL types mean something else in HEVC, 0x65 is a TSA slice there
+	parameter_sets.clear();
+	check_sent(lib, ndi_compressed_fourcc_hevc, concat({start4, {0x65, 0x01, 0x02}}), 1200, false, packet, parameter_sets);
+	CHECK(parameter_sets.empty());
+}
+
+void check_malformed() {
+	const auto lib = make_stub_library();
+	bytes_t packet, parameter_sets = concat({start4, {0x67, 0x42}});
+	const auto kept = parameter_sets;
+	// No start code, the data is passed as is and isn't taken as keyframe
+	check_sent(lib, ndi_compressed_fourcc_h264, {0x65, 0x88, 0x84}, 0, false, packet, parameter_sets);
+	// Start codes without payload
+	check_sent(lib, ndi_compressed_fourcc_h264, concat({start4, start4, {0, 0}}), 0, false, packet, parameter_sets);
+	CHECK(parameter_sets == kept);
+}
+
+}
+
+int main() {
+	check_h264();
+	check_hevc();
+	check_malformed();
+	return check_failures() ? 1 : 0;
+}
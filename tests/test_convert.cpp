@@ -0,0 +1,426 @@
+#include "check.h"
+#include "../src/modules/common/convert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+// Conversions against the limited range BT.601/BT.709 formulas in double precision.
+// Every YUV triplet and every RGB triplet is converted, results may differ from the rounded reference by 1.
+// Vectorized kernels have to give exactly the output of the scalar ones for the same inputs and for random frames.
+
+namespace {
+
+struct matrix_t {
+	color_matrix_t matrix;
+	double kr, kb;
+};
+
+const matrix_t matrices[] = {
+	{color_matrix_t::bt601, 0.299, 0.114},
+	{color_matrix_t::bt709, 0.2126, 0.0722},
+};
+
+int clip(double value) {
+	return static_cast<int>(std::lround(std::min(std::max(value, 0.0), 255.0)));
+}
+
+void reference_rgb(const matrix_t& m, int y, int u, int v, int* rgb) {
+	const double kg = 1.0 - m.kr - m.kb;
+	const double luma = (y - 16) * 255.0 / 219.0;
+	const double cb = (u - 128) * 255.0 / 224.0;
+	const double cr = (v - 128) * 255.0 / 224.0;
+	rgb[0] = clip(luma + 2.0 * (1.0 - m.kr) * cr);
+	rgb[1] = clip(luma - 2.0 * m.kb * (1.0 - m.kb) / kg * cb - 2.0 * m.kr * (1.0 - m.kr) / kg * cr);
+	rgb[2] = clip(luma + 2.0 * (1.0 - m.kb) * cb);
+}
+
+double luma(const matrix_t& m, double r, double g, double b) {
+	return m.kr * r + (1.0 - m.kr - m.kb) * g + m.kb * b;
+}
+
+// Chroma of the pair is computed from its average
+void reference_uyvy(const matrix_t& m, const int* rgb0, const int* rgb1, int* uyvy) {
+	const double r = (rgb0[0] + rgb1[0]) / 2.0, g = (rgb0[1] + rgb1[1]) / 2.0, b = (rgb0[2] + rgb1[2]) / 2.0;
+	const double y = luma(m, r, g, b);
+	uyvy[0] = clip(128.0 + 224.0 / 255.0 * (b - y) / (2.0 * (1.0 - m.kb)));
+	uyvy[1] = clip(16.0 + 219.0 / 255.0 * luma(m, rgb0[0], rgb0[1], rgb0[2]));
+	uyvy[2] = clip(128.0 + 224.0 / 255.0 * (r - y) / (2.0 * (1.0 - m.kr)));
+	uyvy[3] = clip(16.0 + 219.0 / 255.0 * luma(m, rgb1[0], rgb1[1], rgb1[2]));
+}
+
+bool close(int value, int expected) {
+	return std::abs(value - expected) <= 1;
+}
+
+// One line holds all U values for given Y and V, so every triplet is converted once per matrix and order
+void check_uyvy_to_rgb() {
+	const size_t width = 2 * 256;
+	std::vector<uint8_t> src(width * 2 * 256), bgra(width * 4 * 256), rgba(width * 4 * 256);
+	for (const auto& m: matrices) {
+		for (int y = 0; y < 256; ++y) {
+			for (int v = 0; v < 256; ++v) {
+				for (int u = 0; u < 256; ++u) {
+					uint8_t* pixel = &src[(v * width + 2 * u) * 2];
+					pixel[0] = u;
+					pixel[1] = y;
+					pixel[2] = v;
+					pixel[3] = y;
+				}
+			}
+			uyvy_to_bgra(src.data(), width * 2, bgra.data(), width * 4, width, 256, m.matrix);
+			uyvy_to_rgba(src.data(), width * 2, rgba.data(), width * 4, width, 256, m.matrix);
+			for (int v = 0; v < 256; ++v) {
+				for (int u = 0; u < 256; ++u) {
+					int rgb[3];
+					reference_rgb(m, y, u, v, rgb);
+					for (size_t i = 0; i < 2; ++i) {
+						const uint8_t* b = &bgra[(v * width + 2 * u + i) * 4];
+						const uint8_t* r = &rgba[(v * width + 2 * u + i) * 4];
+						CHECK(close(b[2], rgb[0]) && close(b[1], rgb[1]) && close(b[0], rgb[2]) && b[3] == 255);
+						CHECK(close(r[0], rgb[0]) && close(r[1], rgb[1]) && close(r[2], rgb[2]) && r[3] == 255);
+					}
+				}
+			}
+			if (check_failures())
+				return;
+		}
+	}
+}
+
+void check_rgb_pair(const matrix_t& m, const uint8_t* bgra, const uint8_t* rgba, const uint8_t* from_bgra, const uint8_t* from_rgba) {
+	const int rgb0[3] = {bgra[2], bgra[1], bgra[0]};
+	const int rgb1[3] = {bgra[6], bgra[5], bgra[4]};
+	CHECK(rgba[0] == rgb0[0] && rgba[1] == rgb0[1] && rgba[2] == rgb0[2]);
+	int uyvy[4];
+	reference_uyvy(m, rgb0, rgb1, uyvy);
+	for (size_t i = 0; i < 4; ++i) {
+		CHECK(close(from_bgra[i], uyvy[i]));
+		CHECK(from_rgba[i] == from_bgra[i]);
+	}
+}
+
+// Every RGB triplet as a pair of equal pixels, then random pairs of different pixels for the chroma averaging
+void check_rgb_to_uyvy() {
+	const size_t width = 2 * 256;
+	std::vector<uint8_t> bgra(width * 4 * 256), rgba(width * 4 * 256), from_bgra(width * 2 * 256), from_rgba(width * 2 * 256);
+	std::mt19937 random(1);
+	for (const auto& m: matrices) {
+		for (int r = 0; r < 257; ++r) {
+			for (int g = 0; g < 256; ++g) {
+				for (int b = 0; b < 256; ++b) {
+					for (size_t i = 0; i < 2; ++i) {
+						// Last round pairs random pixels
+						const bool pair = r == 256;
+						uint8_t* pixel_bgra = &bgra[(g * width + 2 * b + i) * 4];
+						uint8_t* pixel_rgba = &rgba[(g * width + 2 * b + i) * 4];
+						const uint8_t red = pair ? random() : r;
+						const uint8_t green = pair ? random() : g;
+						const uint8_t blue = pair ? random() : b;
+						pixel_bgra[0] = blue;
+						pixel_bgra[1] = green;
+						pixel_bgra[2] = red;
+						pixel_bgra[3] = pair ? random() : 255;
+						pixel_rgba[0] = red;
+						pixel_rgba[1] = green;
+						pixel_rgba[2] = blue;
+						pixel_rgba[3] = pixel_bgra[3];
+					}
+				}
+			}
+			bgra_to_uyvy(bgra.data(), width * 4, from_bgra.data(), width * 2, width, 256, m.matrix);
+			rgba_to_uyvy(rgba.data(), width * 4, from_rgba.data(), width * 2, width, 256, m.matrix);
+			for (size_t pixel = 0; pixel < width * 256; pixel += 2)
+				check_rgb_pair(m, &bgra[pixel * 4], &rgba[pixel * 4], &from_bgra[pixel * 2], &from_rgba[pixel * 2]);
+			if (check_failures())
+				return;
+		}
+	}
+}
+
+// Strides wider than the lines, bytes between the lines have to stay untouched
+void check_strides() {
+	const size_t width = 6, height = 3, src_stride = width * 2 + 5, dst_stride = width * 4 + 3;
+	std::vector<uint8_t> src(src_stride * height, 128), dst(dst_stride * height, 7);
+	uyvy_to_bgra(src.data(), src_stride, dst.data(), dst_stride, width, height, color_matrix_t::bt709);
+	for (size_t line = 0; line < height; ++line) {
+		for (size_t i = width * 4; i < dst_stride; ++i)
+			CHECK(dst[line * dst_stride + i] == 7);
+	}
+	std::vector<uint8_t> uyvy(src_stride * height, 9);
+	bgra_to_uyvy(dst.data(), dst_stride, uyvy.data(), src_stride, width, height, color_matrix_t::bt709);
+	for (size_t line = 0; line < height; ++line) {
+		for (size_t i = width * 2; i < src_stride; ++i)
+			CHECK(uyvy[line * src_stride + i] == 9);
+	}
+}
+
+void check_nv12_split() {
+	const size_t width = 7, height = 3, uv_stride = width * 2 + 3, u_stride = width + 1, v_stride = width + 2;
+	std::vector<uint8_t> uv(uv_stride * height), u(u_stride * height, 0), v(v_stride * height, 0);
+	for (size_t i = 0; i < uv.size(); ++i)
+		uv[i] = static_cast<uint8_t>(i);
+	nv12_split_uv(uv.data(), uv_stride, u.data(), u_stride, v.data(), v_stride, width, height);
+	for (size_t line = 0; line < height; ++line) {
+		for (size_t i = 0; i < width; ++i) {
+			CHECK(u[line * u_stride + i] == uv[line * uv_stride + 2 * i]);
+			CHECK(v[line * v_stride + i] == uv[line * uv_stride + 2 * i + 1]);
+		}
+		CHECK(u[line * u_stride + width] == 0);
+		CHECK(v[line * v_stride + width] == 0);
+	}
+}
+
+
+// Fills the UYVY lines of all U values for given Y and V
+void fill_yuv_triplets(std::vector<uint8_t>& src, size_t width, int y) {
+	for (int v = 0; v < 256; ++v) {
+		for (int u = 0; u < 256; ++u) {
+			uint8_t* pixel = &src[(v * width + 2 * u) * 2];
+			pixel[0] = u;
+			pixel[1] = y;
+			pixel[2] = v;
+			pixel[3] = y;
+		}
+	}
+}
+
+// Runs the conversion with the scalar kernels and with the named ones, outputs have to be the same
+bool same_as_scalar(const std::string& name, const std::function<void(std::vector<uint8_t>&)>& convert) {
+	std::vector<uint8_t> expected, output;
+	set_convert_kernels("scalar");
+	convert(expected);
+	set_convert_kernels(name);
+	convert(output);
+	return expected == output;
+}
+
+void check_triplets(const std::string& name) {
+	const size_t width = 2 * 256, height = 256;
+	std::vector<uint8_t> src(width * 2 * height), alpha(width * height), rgb(width * 4 * height);
+	std::mt19937 random(2);
+	for (auto& value: alpha)
+		value = random();
+	for (const auto& m: matrices) {
+		for (int y = 0; y < 256; ++y) {
+			fill_yuv_triplets(src, width, y);
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(width * 4 * height, 0);
+				uyvy_to_bgra(src.data(), width * 2, out.data(), width * 4, width, height, m.matrix);
+			}));
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(width * 4 * height, 0);
+				uyva_to_rgba(src.data(), width * 2, alpha.data(), width, out.data(), width * 4, width, height, m.matrix);
+			}));
+			if (check_failures())
+				return;
+		}
+		// Each line holds all R and G values for given B, followed by random pixels
+		for (int b = 0; b < 257; ++b) {
+			for (size_t i = 0; i < width * height; ++i) {
+				uint8_t* pixel = &rgb[i * 4];
+				pixel[0] = b < 256 ? i % 256 : random();
+				pixel[1] = b < 256 ? i / 256 % 256 : random();
+				pixel[2] = b < 256 ? b : random();
+				pixel[3] = random();
+			}
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(width * 2 * height, 0);
+				bgra_to_uyvy(rgb.data(), width * 4, out.data(), width * 2, width, height, m.matrix);
+			}));
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(width * 2 * height, 0);
+				rgba_to_uyvy(rgb.data(), width * 4, out.data(), width * 2, width, height, m.matrix);
+			}));
+			if (check_failures())
+				return;
+		}
+	}
+}
+
+// Random frames of widths covering the ends of the rows of all kernels and odd heights,
+// output strides are wider than the lines and the bytes between them have to stay untouched
+void check_random_frames(const std::string& name) {
+	std::mt19937 random(3);
+	auto fill = [&](size_t size) {
+		std::vector<uint8_t> data(size);
+		for (auto& value: data)
+			value = random();
+		return data;
+	};
+	for (size_t width = 2; width <= 82; width += 2) {
+		for (size_t height = 1; height <= 3; ++height) {
+			const size_t chroma_height = (height + 1) / 2, pad = 3;
+			const auto uyvy = fill(width * 2 * height), rgb = fill(width * 4 * height), alpha = fill(width * height);
+			const auto y = fill(width * height), u = fill(width / 2 * chroma_height), v = fill(width / 2 * chroma_height), uv = fill(width * chroma_height);
+			const auto y16 = fill(width * 2 * height), uv16 = fill(width * 2 * height);
+			const size_t uyvy_stride = width * 2 + pad, rgb_stride = width * 4 + pad, y_stride = width + pad, c_stride = width / 2 + pad;
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(rgb_stride * height, 7);
+				uyvy_to_bgra(uyvy.data(), width * 2, out.data(), rgb_stride, width, height, color_matrix_t::bt601);
+			}));
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(rgb_stride * height, 7);
+				uyvy_to_rgba(uyvy.data(), width * 2, out.data(), rgb_stride, width, height, color_matrix_t::bt709);
+			}));
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(rgb_stride * height, 7);
+				uyva_to_bgra(uyvy.data(), width * 2, alpha.data(), width, out.data(), rgb_stride, width, height, color_matrix_t::bt709);
+			}));
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(uyvy_stride * height, 7);
+				bgra_to_uyvy(rgb.data(), width * 4, out.data(), uyvy_stride, width, height, color_matrix_t::bt601);
+			}));
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(uyvy_stride * height, 7);
+				rgba_to_uyvy(rgb.data(), width * 4, out.data(), uyvy_stride, width, height, color_matrix_t::bt709);
+			}));
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(uyvy_stride * height, 7);
+				i420_to_uyvy(y.data(), width, u.data(), v.data(), width / 2, out.data(), uyvy_stride, width, height);
+			}));
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(uyvy_stride * height, 7);
+				nv12_to_uyvy(y.data(), width, uv.data(), width, out.data(), uyvy_stride, width, height);
+			}));
+			// Output planes one after another
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(y_stride * height + 2 * c_stride * chroma_height, 7);
+				uint8_t* out_u = out.data() + y_stride * height;
+				uyvy_to_i420(uyvy.data(), width * 2, out.data(), y_stride, out_u, out_u + c_stride * chroma_height, c_stride, width, height);
+			}));
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(y_stride * height + (width + pad) * chroma_height, 7);
+				uyvy_to_nv12(uyvy.data(), width * 2, out.data(), y_stride, out.data() + y_stride * height, width + pad, width, height);
+			}));
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(2 * c_stride * chroma_height, 7);
+				nv12_split_uv(uv.data(), width, out.data(), c_stride, out.data() + c_stride * chroma_height, c_stride, width / 2, chroma_height);
+			}));
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(uyvy_stride * height, 7);
+				p216_to_uyvy(y16.data(), width * 2, uv16.data(), width * 2, out.data(), uyvy_stride, width, height);
+			}));
+			CHECK(same_as_scalar(name, [&](std::vector<uint8_t>& out) {
+				out.assign(2 * (width * 2 + 2) * height, 7);
+				uyvy_to_p216(uyvy.data(), width * 2, out.data(), width * 2 + 2, out.data() + (width * 2 + 2) * height, width * 2 + 2, width, height);
+			}));
+			if (check_failures())
+				return;
+		}
+	}
+}
+
+// 4:2:0 <-> UYVY with known values, chroma of the last odd line is taken from it alone
+void check_420() {
+	const size_t width = 4, height = 3;
+	const uint8_t y[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+	const uint8_t u[] = {20, 21, 22, 23}, v[] = {30, 31, 32, 33};
+	const uint8_t uv[] = {20, 30, 21, 31, 22, 32, 23, 33};
+	const uint8_t expected[] = {
+		20, 1, 30, 2, 21, 3, 31, 4,
+		20, 5, 30, 6, 21, 7, 31, 8,
+		22, 9, 32, 10, 23, 11, 33, 12,
+	};
+	std::vector<uint8_t> uyvy(sizeof(expected));
+	i420_to_uyvy(y, width, u, v, width / 2, uyvy.data(), width * 2, width, height);
+	CHECK(std::memcmp(uyvy.data(), expected, sizeof(expected)) == 0);
+	std::fill(uyvy.begin(), uyvy.end(), 0);
+	nv12_to_uyvy(y, width, uv, width, uyvy.data(), width * 2, width, height);
+	CHECK(std::memcmp(uyvy.data(), expected, sizeof(expected)) == 0);
+
+	// Second line has chroma higher by 3, so the average rounds up by 2
+	uyvy[8] += 3;
+	uyvy[10] += 3;
+	uint8_t out_y[12], out_u[4], out_v[4], out_uv[8];
+	uyvy_to_i420(uyvy.data(), width * 2, out_y, width, out_u, out_v, width / 2, width, height);
+	CHECK(std::memcmp(out_y, y, sizeof(y)) == 0);
+	CHECK(out_u[0] == 22 && out_u[1] == 21 && out_u[2] == 22 && out_u[3] == 23);
+	CHECK(out_v[0] == 32 && out_v[1] == 31 && out_v[2] == 32 && out_v[3] == 33);
+	uyvy_to_nv12(uyvy.data(), width * 2, out_y, width, out_uv, width, width, height);
+	CHECK(std::memcmp(out_y, y, sizeof(y)) == 0);
+	const uint8_t expected_uv[] = {22, 32, 21, 31, 22, 32, 23, 33};
+	CHECK(std::memcmp(out_uv, expected_uv, sizeof(expected_uv)) == 0);
+}
+
+void check_uyva() {
+	const size_t width = 2, height = 2;
+	const uint8_t uyvy[] = {128, 16, 128, 235, 128, 235, 128, 16};
+	const uint8_t alpha[] = {10, 20, 30, 40};
+	uint8_t out[8], out_alpha[4];
+	uyva_merge(uyvy, width * 2, nullptr, 0, out, width * 2, out_alpha, width, width, height);
+	CHECK(std::memcmp(out, uyvy, sizeof(uyvy)) == 0);
+	CHECK(out_alpha[0] == 255 && out_alpha[3] == 255);
+	uyva_merge(uyvy, width * 2, alpha, width, out, width * 2, out_alpha, width, width, height);
+	CHECK(std::memcmp(out_alpha, alpha, sizeof(alpha)) == 0);
+	std::memset(out, 0, sizeof(out));
+	std::memset(out_alpha, 0, sizeof(out_alpha));
+	uyva_split(uyvy, width * 2, alpha, width, out, width * 2, out_alpha, width, width, height);
+	CHECK(std::memcmp(out, uyvy, sizeof(uyvy)) == 0);
+	CHECK(std::memcmp(out_alpha, alpha, sizeof(alpha)) == 0);
+
+	// Black and white pixels keep their alpha
+	uint8_t bgra[16], rgba[16];
+	uyva_to_bgra(uyvy, width * 2, alpha, width, bgra, width * 4, width, height, color_matrix_t::bt601);
+	uyva_to_rgba(uyvy, width * 2, alpha, width, rgba, width * 4, width, height, color_matrix_t::bt709);
+	CHECK(bgra[0] == 0 && bgra[1] == 0 && bgra[2] == 0 && bgra[3] == 10);
+	CHECK(bgra[4] == 255 && bgra[5] == 255 && bgra[6] == 255 && bgra[7] == 20);
+	CHECK(rgba[8] == 255 && rgba[11] == 30 && rgba[12] == 0 && rgba[15] == 40);
+}
+
+void check_p216() {
+	const size_t width = 2, height = 1;
+	const uint16_t y16[] = {0x1000, 0xffff}, uv16[] = {0x807f, 0x7f80};
+	uint8_t uyvy[4];
+	p216_to_uyvy(reinterpret_cast<const uint8_t*>(y16), width * 2, reinterpret_cast<const uint8_t*>(uv16), width * 2, uyvy, width * 2,
+			width, height);
+	CHECK(uyvy[0] == 0x80 && uyvy[1] == 0x10 && uyvy[2] == 0x80 && uyvy[3] == 0xff);
+	uint16_t out_y[2], out_uv[2];
+	uyvy_to_p216(uyvy, width * 2, reinterpret_cast<uint8_t*>(out_y), width * 2, reinterpret_cast<uint8_t*>(out_uv), width * 2, width, height);
+	CHECK(out_y[0] == 0x1000 && out_y[1] == 0xff00 && out_uv[0] == 0x8000 && out_uv[1] == 0x8000);
+	uint16_t luma[2];
+	p216_to_y16(reinterpret_cast<const uint8_t*>(y16), width * 2, reinterpret_cast<uint8_t*>(luma), width * 2, width, height);
+	CHECK(luma[0] == y16[0] && luma[1] == y16[1]);
+	out_uv[0] = out_uv[1] = 0;
+	y16_to_p216(reinterpret_cast<const uint8_t*>(y16), width * 2, reinterpret_cast<uint8_t*>(out_y), width * 2,
+			reinterpret_cast<uint8_t*>(out_uv), width * 2, width, height);
+	CHECK(out_y[0] == y16[0] && out_y[1] == y16[1] && out_uv[0] == 0x8000 && out_uv[1] == 0x8000);
+}
+}
+
+int main() {
+	const auto names = get_convert_kernel_names();
+	const std::string selected = convert_kernel_name();
+	CHECK(!names.empty() && names.front() == selected && names.back() == "scalar");
+	CHECK(!set_convert_kernels("unknown") && selected == convert_kernel_name());
+	std::printf("convert kernels: %s\n", selected.c_str());
+
+	CHECK(default_color_matrix(720, 576) == color_matrix_t::bt601);
+	CHECK(default_color_matrix(1280, 720) == color_matrix_t::bt709);
+	CHECK(set_convert_kernels("scalar"));
+	check_uyvy_to_rgb();
+	check_rgb_to_uyvy();
+	for (const auto& name: names) {
+		CHECK(set_convert_kernels(name));
+		check_strides();
+		check_nv12_split();
+		check_420();
+		check_uyva();
+		check_p216();
+		if (name != "scalar") {
+			check_triplets(name);
+			check_random_frames(name);
+		}
+		if (check_failures()) {
+			std::fprintf(stderr, "failed with %s kernels\n", name.c_str());
+			break;
+		}
+	}
+	return check_failures();
+}
@@ -0,0 +1,50 @@
+#include "check.h"
+#include "../src/modules/common/copy.h"
+#include "../src/modules/common/thread_pool.h"
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Copies the plane with given strides and checks every line and the bytes between them
+void check_plane(size_t line_size, size_t height, size_t src_stride, size_t dst_stride, row_workers_t* workers) {
+	std::mt19937 random(static_cast<uint32_t>(line_size * 31 + height));
+	std::vector<uint8_t> src(src_stride * height + 1);
+	for (auto& value: src)
+		value = static_cast<uint8_t>(random());
+	// Odd offset of the destination tests the unaligned head of the streaming stores
+	std::vector<uint8_t> dst(dst_stride * height + 2, 0xa5);
+	stream_copy_plane(dst.data() + 1, dst_stride, src.data(), src_stride, line_size, height, workers);
+	CHECK(dst[0] == 0xa5);
+	for (size_t line = 0; line < height; ++line) {
+		CHECK(std::memcmp(dst.data() + 1 + line * dst_stride, src.data() + line * src_stride, line_size) == 0);
+		for (size_t i = line_size; i < dst_stride; ++i)
+			CHECK(dst[1 + line * dst_stride + i] == 0xa5);
+	}
+	CHECK(dst.back() == 0xa5);
+}
+
+}
+
+int main() {
+	// Blocks left to memcpy, streamed, and split between the workers
+	for (size_t threads: {1, 2, 4}) {
+		row_workers_t workers(get_row_pool("test", {}), threads);
+		check_plane(1920 * 2, 16, 1920 * 2, 1920 * 2, &workers);
+		check_plane(1920 * 2, 17, 1920 * 2 + 64, 1920 * 2 + 3, &workers);
+		check_plane(1920 * 2, 1080, 1920 * 2, 1920 * 2, &workers);
+		check_plane(3840 * 2 + 5, 2160, 3840 * 2 + 5, 3840 * 2 + 5, &workers);
+		check_plane(3840 * 2, 2160, 3840 * 2 + 128, 3840 * 4, &workers);
+	}
+	check_plane(3840 * 4, 2161, 3840 * 4 + 1, 3840 * 4 + 7, nullptr);
+
+	std::vector<uint8_t> src(stream_copy_threshold * 3 + 13), dst(src.size() + 1);
+	for (size_t i = 0; i < src.size(); ++i)
+		src[i] = static_cast<uint8_t>(i * 7);
+	stream_copy(dst.data() + 1, src.data(), src.size());
+	CHECK(std::memcmp(dst.data() + 1, src.data(), src.size()) == 0);
+	return check_failures();
+}
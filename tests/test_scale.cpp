@@ -0,0 +1,669 @@
+#include "check.h"
+#include "../src/modules/ndi_scale/ScaleKernels.h"
+#include "../src/modules/ndi_scale/ScaleTables.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Scaling paths of ndi_scale built from the tables and kernels the same way Scale does, against reference implementations.
+// Every path is checked with all the kernel sets supported by the CPU.
+
+using namespace yuri::scale;
+
+namespace {
+
+std::mt19937 random_engine(42);
+
+struct image_t {
+	size_t width;
+	size_t height;
+	size_t stride;
+	std::vector<uint8_t> data;
+	uint8_t* line(size_t index) {
+		return data.data() + index * stride;
+	}
+	const uint8_t* line(size_t index) const {
+		return data.data() + index * stride;
+	}
+};
+
+image_t random_image(size_t width, size_t height, size_t line_size, size_t padding) {
+	image_t image{width, height, line_size + padding, std::vector<uint8_t>((line_size + padding) * height)};
+	for (auto& value: image.data)
+		value = static_cast<uint8_t>(std::uniform_int_distribution<int>(0, 255)(random_engine));
+	return image;
+}
+
+size_t get_pixel_size(line_layout_t layout) {
+	return layout == line_layout_t::packed3 ? 3 : (layout == line_layout_t::packed4 ? 4 : 2);
+}
+
+const char* get_layout_name(line_layout_t layout) {
+	switch (layout) {
+	case line_layout_t::packed3:
+		return "packed3";
+	case line_layout_t::packed4:
+		return "packed4";
+	case line_layout_t::yuyv:
+		return "yuyv";
+	default:
+		return "uyvy";
+	}
+}
+
+const line_layout_t layouts[] = {line_layout_t::packed3, line_layout_t::packed4, line_layout_t::yuyv, line_layout_t::uyvy};
+
+// Fast bilinear kernels as they were before the vectorization, with all the positions in 1/256 of a pixel
+namespace original {
+
+template <size_t pixel_size>
+struct scale_line_bilinear_fast {
+	static void eval(uint8_t* it, const uint8_t* top, const uint8_t* bottom, const size_t new_width, const size_t old_width,
+			const uint64_t unscale_x, const uint64_t y_ratio) {
+		const uint64_t y_ratio2 = 256 - y_ratio;
+		for (size_t pixel = 0; pixel < new_width - 1; ++pixel) {
+			const size_t left = pixel * unscale_x;
+			const size_t right = left + 1;
+			const uint64_t x_ratio = pixel * unscale_x - left;
+			const uint64_t x_ratio2 = 256 - x_ratio;
+			for (size_t i = 0; i < pixel_size; ++i) {
+				*it++ = static_cast<uint8_t>((top[left / 256 * pixel_size + i] * x_ratio2 * y_ratio2 + top[right / 256 * pixel_size + i] * x_ratio * y_ratio2
+						+ bottom[left / 256 * pixel_size + i] * x_ratio2 * y_ratio + bottom[right / 256 * pixel_size + i] * x_ratio * y_ratio) / 65536);
+			}
+		}
+		for (size_t i = 0; i < pixel_size; ++i) {
+			*it++ = static_cast<uint8_t>((top[(old_width - 1) * pixel_size + i] * y_ratio2 + bottom[(old_width - 1) * pixel_size + i] * y_ratio) / 256);
+		}
+	}
+};
+
+uint8_t get_y_fast(const size_t pixel, const uint64_t unscale_x, const uint8_t* top, const uint8_t* bottom, const uint64_t y_ratio,
+		const uint64_t y_ratio2) {
+	const size_t left = pixel * unscale_x;
+	const size_t right = left + 256;
+	const uint64_t x_ratio = pixel * unscale_x - left;
+	const uint64_t x_ratio2 = 256 - x_ratio;
+	return static_cast<uint8_t>((top[left / 256 * 2 + 0] * x_ratio2 * y_ratio2 + top[right / 256 * 2 + 0] * x_ratio * y_ratio2
+			+ bottom[left / 256 * 2 + 0] * x_ratio2 * y_ratio + bottom[right / 256 * 2 + 0] * x_ratio * y_ratio) / 65536);
+}
+
+template <size_t adjust>
+uint8_t get_uv_fast(const size_t pixel, const uint64_t unscale_x, const uint8_t* top, const uint8_t* bottom, const uint64_t y_ratio,
+		const uint64_t y_ratio2) {
+	const size_t left0 = pixel * unscale_x;
+	const size_t left = (left0 & ~0x1FF) + 256 * adjust;
+	const size_t right = left + 2 * 256;
+	const uint64_t x_ratio = (pixel * unscale_x - left0 + (left0 & 0x1FF)) / 2;
+	const uint64_t x_ratio2 = 256 - x_ratio;
+	return static_cast<uint8_t>((top[left / 256 * 2 + 1] * x_ratio2 * y_ratio2 + top[right / 256 * 2 + 1] * x_ratio * y_ratio2
+			+ bottom[left / 256 * 2 + 1] * x_ratio2 * y_ratio + bottom[right / 256 * 2 + 1] * x_ratio * y_ratio) / 65536);
+}
+
+struct scale_line_bilinear_yuyv_fast {
+	static void eval(uint8_t* it, const uint8_t* top, const uint8_t* bottom, const size_t new_width, const size_t /*old_width*/,
+			const uint64_t unscale_x, const uint64_t y_ratio) {
+		const uint64_t y_ratio2 = 256 - y_ratio;
+		for (size_t pixel = 0; pixel < new_width - 2; pixel += 2) {
+			*it++ = get_y_fast(pixel, unscale_x, top, bottom, y_ratio, y_ratio2);
+			*it++ = get_uv_fast<0>(pixel, unscale_x, top, bottom, y_ratio, y_ratio2);
+			*it++ = get_y_fast(pixel + 1, unscale_x, top, bottom, y_ratio, y_ratio2);
+			*it++ = get_uv_fast<1>(pixel + 1, unscale_x, top, bottom, y_ratio, y_ratio2);
+		}
+		*it++ = get_y_fast((new_width - 2), unscale_x, top, bottom, y_ratio, y_ratio2);
+		*it++ = get_uv_fast<0>((new_width - 2), unscale_x, top, bottom, y_ratio, y_ratio2);
+		*it++ = get_y_fast((new_width - 1), unscale_x, top, bottom, y_ratio, y_ratio2);
+		*it++ = get_uv_fast<1>((new_width - 1), unscale_x, top, bottom, y_ratio, y_ratio2);
+	}
+};
+
+struct scale_line_bilinear_uyvy_fast {
+	static void eval(uint8_t* it, const uint8_t* top, const uint8_t* bottom, const size_t new_width, const size_t /*old_width*/,
+			const uint64_t unscale_x, const uint64_t y_ratio) {
+		const uint64_t y_ratio2 = 256 - y_ratio;
+		for (size_t pixel = 0; pixel < new_width - 2; pixel += 2) {
+			*it++ = get_uv_fast<0>(pixel, unscale_x, top - 1, bottom - 1, y_ratio, y_ratio2);
+			*it++ = get_y_fast(pixel, unscale_x, top + 1, bottom + 1, y_ratio, y_ratio2);
+			*it++ = get_uv_fast<1>(pixel + 1, unscale_x, top - 1, bottom - 1, y_ratio, y_ratio2);
+			*it++ = get_y_fast(pixel + 1, unscale_x, top + 1, bottom + 1, y_ratio, y_ratio2);
+		}
+		*it++ = get_uv_fast<0>((new_width - 2), unscale_x, top - 1, bottom - 1, y_ratio, y_ratio2);
+		*it++ = get_y_fast((new_width - 2), unscale_x, top + 1, bottom + 1, y_ratio, y_ratio2);
+		*it++ = get_uv_fast<1>((new_width - 1), unscale_x, top - 1, bottom - 1, y_ratio, y_ratio2);
+		*it++ = get_y_fast((new_width - 1), unscale_x, top + 1, bottom + 1, y_ratio, y_ratio2);
+	}
+};
+
+template <class kernel>
+void scale_image_fast(const image_t& in, image_t& out) {
+	const uint64_t unscale_x = 256 * (in.width - 1) / (out.width - 1);
+	const uint64_t unscale_y = 256 * (in.height - 1) / (out.height - 1);
+	for (size_t line = 0; line < out.height - 1; ++line) {
+		const size_t top = line * unscale_y;
+		const size_t bottom = top + 256;
+		const uint64_t y_ratio = line * unscale_y - top;
+		kernel::eval(out.line(line), in.line(top / 256), in.line(bottom / 256), out.width, in.width, unscale_x, y_ratio);
+	}
+	kernel::eval(out.line(out.height - 1), in.line(in.height - 1), in.line(in.height - 1), out.width, in.width, unscale_x, 0);
+}
+
+void scale_image_fast(const image_t& in, image_t& out, line_layout_t layout) {
+	switch (layout) {
+	case line_layout_t::packed3:
+		scale_image_fast<scale_line_bilinear_fast<3>>(in, out);
+		break;
+	case line_layout_t::packed4:
+		scale_image_fast<scale_line_bilinear_fast<4>>(in, out);
+		break;
+	case line_layout_t::yuyv:
+		scale_image_fast<scale_line_bilinear_yuyv_fast>(in, out);
+		break;
+	case line_layout_t::uyvy:
+		scale_image_fast<scale_line_bilinear_uyvy_fast>(in, out);
+		break;
+	}
+}
+
+}
+
+// Fast bilinear path of Scale::update_plan and scale_image_fast
+void scale_image_fast(const image_t& in, image_t& out, line_layout_t layout) {
+	line_table_t table;
+	std::vector<line_step_t> steps;
+	build_line_steps(steps, in.height, out.height, true);
+	build_line_table(table, layout, in.width, out.width, 256 * (in.width - 1) / (out.width - 1));
+	const size_t input_size = get_pixel_size(layout) * in.width;
+	std::vector<uint16_t> blended(in.stride + 1);
+	for (size_t line = 0; line < steps.size(); ++line) {
+		blend_lines(blended.data(), in.line(steps[line].top), in.line(steps[line].bottom), input_size, steps[line].y_ratio);
+		scale_line(out.line(line), blended.data(), table);
+	}
+}
+
+// The table path has to give the same output as the original fast kernels. The original 4:2:2 kernels read the chroma
+// of the pixel pair after the end of the line for the last output pair, where the table uses the last chroma sample.
+// The source lines are followed by a copy of their last pixel pair, so both read the same values there.
+void check_bilinear(const std::vector<std::string>& names) {
+	const struct {
+		size_t in_width, in_height, out_width, out_height;
+	} sizes[] = {
+		{1920, 1080, 1280, 720},
+		{1280, 720, 1920, 1080},
+		{1920, 1080, 640, 360},
+		{720, 576, 1024, 576},
+		{100, 50, 62, 30},
+		{64, 48, 2, 2},
+		{2, 2, 66, 34},
+		{333, 201, 111, 77},
+	};
+	for (const auto& size: sizes) {
+		for (auto layout: layouts) {
+			const size_t pixel_size = get_pixel_size(layout);
+			if (pixel_size == 2 && (size.in_width % 2 || size.out_width % 2))
+				continue;
+			auto in = random_image(size.in_width, size.in_height, pixel_size * size.in_width, 4);
+			for (size_t line = 0; line < in.height; ++line)
+				std::copy(in.line(line) + in.stride - 8, in.line(line) + in.stride - 4, in.line(line) + in.stride - 4);
+			image_t expected{size.out_width, size.out_height, pixel_size * size.out_width,
+				std::vector<uint8_t>(pixel_size * size.out_width * size.out_height)};
+			original::scale_image_fast(in, expected, layout);
+			for (const auto& name: names) {
+				set_scale_kernels(name);
+				auto out = expected;
+				std::fill(out.data.begin(), out.data.end(), 0);
+				scale_image_fast(in, out, layout);
+				if (out.data != expected.data) {
+					std::fprintf(stderr, "Bilinear %s %zux%zu -> %zux%zu differs from the original kernels with %s kernels\n", get_layout_name(layout),
+							size.in_width, size.in_height, size.out_width, size.out_height, name.c_str());
+					++check_failures();
+				}
+			}
+		}
+	}
+}
+
+// Bilinear interpolation of a plane at a real position (in samples), samples outside of the plane are replaced by the edge ones
+template <class T>
+double interpolate(const T* data, size_t stride, size_t components, size_t width, size_t height, size_t component, double x, double y) {
+	x = std::min(std::max(x, 0.0), width - 1.0);
+	y = std::min(std::max(y, 0.0), height - 1.0);
+	const size_t left = static_cast<size_t>(x), top = static_cast<size_t>(y);
+	const size_t right = std::min(left + 1, width - 1), bottom = std::min(top + 1, height - 1);
+	const double fx = x - left, fy = y - top;
+	auto sample = [&](size_t sx, size_t sy) {
+		return static_cast<double>(data[sy * stride + sx * components + component]);
+	};
+	return (sample(left, top) * (1.0 - fx) + sample(right, top) * fx) * (1.0 - fy) + (sample(left, bottom) * (1.0 - fx) + sample(right, bottom) * fx) * fy;
+}
+
+struct plane_case_t {
+	const char* name;
+	plane_layout_t layout;
+};
+
+// Planes of the planar formats Scale supports
+const plane_case_t plane_cases[] = {
+	{"luma", {1, 1, 1, 1, false}},
+	{"yuv422p chroma", {1, 1, 2, 1, false}},
+	{"yuv420p chroma", {1, 1, 2, 2, true}},
+	{"nv12 chroma", {2, 1, 2, 2, true}},
+	{"y16", {1, 2, 1, 1, false}},
+};
+
+// Planar path of Scale::update_plan and scale_image_planar. The reference maps every output sample through luma positions:
+// sample j of a plane subsampled by sub lies at luma position sub * j + c, where c is (sub - 1) / 2 for chroma sited between
+// the luma lines and 0 for co-sited chroma. Positions are rounded to 1/256 of a sample, which moves the output by up to 1/512
+// of the value range in each direction, and the kernels truncate, which lowers it by less than 1.
+void check_planar(const std::vector<std::string>& names) {
+	const struct {
+		size_t in_width, in_height, out_width, out_height;
+	} sizes[] = {
+		{1920, 1080, 1280, 720},
+		{1280, 720, 1920, 1080},
+		{720, 576, 1024, 576},
+		{64, 48, 8, 6},
+		{8, 6, 70, 50},
+		{100, 50, 100, 50},
+	};
+	for (const auto& size: sizes) {
+		for (const auto& plane: plane_cases) {
+			const auto& layout = plane.layout;
+			const size_t in_width = size.in_width / layout.sub_x, in_height = size.in_height / layout.sub_y;
+			const size_t out_width = size.out_width / layout.sub_x, out_height = size.out_height / layout.sub_y;
+			const size_t sample_size = layout.components * layout.sample_size;
+			const size_t input_size = in_width * sample_size;
+			auto in = random_image(in_width, in_height, input_size, 16);
+			image_t out{out_width, out_height, out_width * sample_size, std::vector<uint8_t>(out_width * sample_size * out_height)};
+
+			// Exact positions of the output samples in the source plane
+			const double unscale_x = static_cast<double>(size.in_width - 1) / (size.out_width - 1);
+			const double unscale_y = static_cast<double>(size.in_height - 1) / (size.out_height - 1);
+			const double center = layout.centered_y ? (layout.sub_y - 1) / 2.0 : 0.0;
+			const double max_value = layout.sample_size == 1 ? 255.0 : 65535.0;
+			const double tolerance = 2.0 * max_value / 512.0 + 1e-6;
+
+			line_table_t table;
+			std::vector<line_step_t> steps;
+			build_plane_tables(table, steps, layout, size.in_width, size.in_height, size.out_width, size.out_height);
+			CHECK(steps.size() == out_height);
+			CHECK(table.left.size() == out_width * layout.components);
+			for (const auto& name: names) {
+				set_scale_kernels(name);
+				if (layout.sample_size == 1) {
+					std::vector<uint16_t> blended(in.stride + 1);
+					for (size_t line = 0; line < steps.size(); ++line) {
+						blend_lines(blended.data(), in.line(steps[line].top), in.line(steps[line].bottom), input_size, steps[line].y_ratio);
+						scale_line(out.line(line), blended.data(), table);
+					}
+				} else {
+					std::vector<uint32_t> blended(in.stride / 2);
+					for (size_t line = 0; line < steps.size(); ++line) {
+						blend_lines16(blended.data(), reinterpret_cast<const uint16_t*>(in.line(steps[line].top)),
+								reinterpret_cast<const uint16_t*>(in.line(steps[line].bottom)), input_size / 2, steps[line].y_ratio);
+						scale_line16(reinterpret_cast<uint16_t*>(out.line(line)), blended.data(), table);
+					}
+				}
+				double max_error = 0.0;
+				for (size_t y = 0; y < out_height; ++y) {
+					const double source_y = ((layout.sub_y * y + center) * unscale_y - center) / layout.sub_y;
+					for (size_t x = 0; x < out_width; ++x) {
+						const double source_x = x * unscale_x;
+						for (size_t c = 0; c < layout.components; ++c) {
+							double expected, value;
+							if (layout.sample_size == 1) {
+								expected = interpolate(in.data.data(), in.stride, layout.components, in_width, in_height, c, source_x, source_y);
+								value = out.line(y)[x * layout.components + c];
+							} else {
+								expected = interpolate(reinterpret_cast<const uint16_t*>(in.data.data()), in.stride / 2, 1, in_width, in_height, 0,
+										source_x, source_y);
+								value = reinterpret_cast<const uint16_t*>(out.line(y))[x];
+							}
+							// Truncation only lowers the value
+							max_error = std::max(max_error, std::max(expected - value - 1.0, value - expected));
+						}
+					}
+				}
+				if (max_error > tolerance) {
+					std::fprintf(stderr, "Planar %s %zux%zu -> %zux%zu differs from the reference by %.2f with %s kernels\n", plane.name, size.in_width,
+							size.in_height, size.out_width, size.out_height, max_error, name.c_str());
+					++check_failures();
+				}
+			}
+		}
+	}
+}
+
+// Continuous filter kernels, written from their definitions
+double reference_kernel(filter_t filter, double x) {
+	const double pi = 3.14159265358979323846;
+	x = std::abs(x);
+	if (filter == filter_t::bicubic) {
+		// Keys cubic convolution with a = -0.5
+		const double a = -0.5;
+		if (x < 1.0)
+			return (a + 2.0) * x * x * x - (a + 3.0) * x * x + 1.0;
+		if (x < 2.0)
+			return a * x * x * x - 5.0 * a * x * x + 8.0 * a * x - 4.0 * a;
+		return 0.0;
+	}
+	// Lanczos with 3 lobes
+	if (x < 1e-12)
+		return 1.0;
+	if (x >= 3.0)
+		return 0.0;
+	return std::sin(pi * x) / (pi * x) * std::sin(pi * x / 3.0) / (pi * x / 3.0);
+}
+
+// Normalized weights of the source samples for output sample index of a plane subsampled by sub. Positions are mapped through
+// luma: sample j lies at luma position sub * j + siting, and output luma position p samples source luma position (p + 0.5) * ratio - 0.5.
+// Filters are stretched by the ratio when downscaling, the area filter averages the source area covered by the output sample.
+// Samples outside of the plane are replaced by the edge ones.
+std::vector<std::pair<size_t, double>> reference_weights(filter_t filter, size_t old_size, size_t new_size, size_t sub, double siting, size_t index) {
+	const double ratio = static_cast<double>(old_size) / new_size;
+	if (filter == filter_t::automatic)
+		filter = ratio > 1.0 ? filter_t::area : filter_t::bicubic;
+	const double scale = std::max(ratio, 1.0);
+	const double center = (((sub * index + siting) + 0.5) * ratio - 0.5 - siting) / sub;
+	std::vector<std::pair<size_t, double>> weights;
+	double sum = 0.0;
+	const auto first = static_cast<int64_t>(std::floor(center - 3.0 * scale)) - 1;
+	const auto last = static_cast<int64_t>(std::ceil(center + 3.0 * scale)) + 1;
+	for (int64_t j = first; j <= last; ++j) {
+		double weight;
+		if (filter == filter_t::area)
+			weight = std::max(0.0, std::min(j + 0.5, center + scale / 2.0) - std::max(j - 0.5, center - scale / 2.0));
+		else
+			weight = reference_kernel(filter, (j - center) / scale);
+		if (weight == 0.0)
+			continue;
+		weights.emplace_back(static_cast<size_t>(std::min<int64_t>(std::max<int64_t>(j, 0), old_size - 1)), weight);
+		sum += weight;
+	}
+	for (auto& weight: weights)
+		weight.second /= sum;
+	return weights;
+}
+
+// Sampling of one byte of a line: its sample index, the channel it belongs to and the channel subsampling
+struct channel_sample_t {
+	size_t index;
+	size_t stride;
+	size_t offset;
+	size_t sub;
+};
+
+channel_sample_t get_channel_sample(line_layout_t layout, size_t byte) {
+	switch (layout) {
+	case line_layout_t::packed3:
+	case line_layout_t::packed4: {
+		const size_t pixel_size = get_pixel_size(layout);
+		return {byte / pixel_size, pixel_size, byte % pixel_size, 1};
+	}
+	case line_layout_t::yuyv:
+		return byte % 2 ? channel_sample_t{byte / 4, 4, byte % 4, 2} : channel_sample_t{byte / 2, 2, 0, 1};
+	default:
+		return byte % 2 ? channel_sample_t{byte / 2, 2, 1, 1} : channel_sample_t{byte / 4, 4, byte % 4, 2};
+	}
+}
+
+// Separable filtering in double precision, vertical weights are per output line, horizontal ones per output byte
+image_t reference_filter(const image_t& in, size_t out_width, size_t out_height, size_t line_size,
+		const std::vector<std::vector<std::pair<size_t, double>>>& vertical,
+		const std::vector<std::vector<std::pair<size_t, double>>>& horizontal) {
+	image_t out{out_width, out_height, line_size, std::vector<uint8_t>(line_size * out_height)};
+	std::vector<double> filtered(in.stride);
+	for (size_t y = 0; y < out_height; ++y) {
+		std::fill(filtered.begin(), filtered.end(), 0.0);
+		for (const auto& tap: vertical[y]) {
+			for (size_t i = 0; i < in.stride; ++i)
+				filtered[i] += tap.second * in.line(tap.first)[i];
+		}
+		for (size_t i = 0; i < line_size; ++i) {
+			double value = 0.0;
+			for (const auto& tap: horizontal[i])
+				value += tap.second * filtered[tap.first];
+			out.line(y)[i] = static_cast<uint8_t>(std::min(std::max(std::round(value), 0.0), 255.0));
+		}
+	}
+	return out;
+}
+
+// Filtered path of Scale::scale_image_filtered, source lines have one spare element for the vector kernels
+void scale_image_filtered(const image_t& in, image_t& out, const filter_table_t& vertical, const filter_table_t& horizontal, size_t input_size) {
+	std::vector<int16_t> filtered(in.stride + 1);
+	std::vector<const uint8_t*> lines(vertical.taps);
+	std::vector<int16_t> weights(vertical.taps);
+	for (size_t line = 0; line < vertical.size; ++line) {
+		for (size_t k = 0; k < vertical.taps; ++k) {
+			lines[k] = in.line(vertical.offsets[k * vertical.size + line]);
+			weights[k] = vertical.weights[k * vertical.size + line];
+		}
+		filter_lines(filtered.data(), lines.data(), weights.data(), vertical.taps, input_size);
+		filter_line(out.line(line), filtered.data(), horizontal);
+	}
+}
+
+// Output may differ from the reference by 1, the weights are quantized to 1/16384 and the vertical pass to 1/64
+bool compare_filtered(const image_t& out, const image_t& expected) {
+	for (size_t i = 0; i < out.data.size(); ++i) {
+		if (std::abs(static_cast<int>(out.data[i]) - expected.data[i]) > 1)
+			return false;
+	}
+	return true;
+}
+
+const filter_t filters[] = {filter_t::area, filter_t::bicubic, filter_t::lanczos, filter_t::automatic};
+
+const char* get_filter_name(filter_t filter) {
+	switch (filter) {
+	case filter_t::area:
+		return "area";
+	case filter_t::bicubic:
+		return "bicubic";
+	case filter_t::lanczos:
+		return "lanczos";
+	default:
+		return "auto";
+	}
+}
+
+const struct {
+	size_t in_width, in_height, out_width, out_height;
+} filter_sizes[] = {
+	{640, 360, 320, 180},
+	{320, 180, 480, 270},
+	{333, 201, 111, 77},
+	{64, 48, 8, 6},
+	{8, 6, 70, 50},
+	{100, 50, 100, 50},
+	{300, 200, 200, 300},
+};
+
+// Filters of packed formats and 8 bit planes, tables built the same way Scale::update_plan builds them
+void check_filters(const std::vector<std::string>& names) {
+	for (const auto& size: filter_sizes) {
+		for (auto filter: filters) {
+			std::vector<std::vector<std::pair<size_t, double>>> vertical(size.out_height);
+			for (size_t y = 0; y < size.out_height; ++y)
+				vertical[y] = reference_weights(filter, size.in_height, size.out_height, 1, 0.0, y);
+
+			for (auto layout: layouts) {
+				const size_t pixel_size = get_pixel_size(layout);
+				if (pixel_size == 2 && (size.in_width % 2 || size.out_width % 2))
+					continue;
+				const size_t input_size = pixel_size * size.in_width, output_size = pixel_size * size.out_width;
+				const auto in = random_image(size.in_width, size.in_height, input_size, 0);
+				std::vector<std::vector<std::pair<size_t, double>>> horizontal(output_size);
+				for (size_t i = 0; i < output_size; ++i) {
+					const auto sample = get_channel_sample(layout, i);
+					horizontal[i] = reference_weights(filter, size.in_width / sample.sub, size.out_width / sample.sub, sample.sub, 0.0, sample.index);
+					for (auto& tap: horizontal[i])
+						tap.first = tap.first * sample.stride + sample.offset;
+				}
+				const auto expected = reference_filter(in, size.out_width, size.out_height, output_size, vertical, horizontal);
+
+				filter_table_t vertical_table, horizontal_table;
+				std::vector<filter_channel_t> channels;
+				build_filter_table(vertical_table, filter, size.in_height, size.out_height, 1);
+				get_filter_channels(channels, layout, filter, size.in_width, size.out_width);
+				merge_filter_channels(horizontal_table, channels, output_size);
+				for (const auto& name: names) {
+					set_scale_kernels(name);
+					image_t out{size.out_width, size.out_height, output_size, std::vector<uint8_t>(output_size * size.out_height)};
+					scale_image_filtered(in, out, vertical_table, horizontal_table, input_size);
+					if (!compare_filtered(out, expected)) {
+						std::fprintf(stderr, "Filter %s %s %zux%zu -> %zux%zu differs from the reference with %s kernels\n", get_filter_name(filter),
+								get_layout_name(layout), size.in_width, size.in_height, size.out_width, size.out_height, name.c_str());
+						++check_failures();
+					}
+				}
+			}
+
+			for (const auto& plane: plane_cases) {
+				const auto& layout = plane.layout;
+				// 16 bit planes are always scaled bilinearly
+				if (layout.sample_size != 1)
+					continue;
+				const size_t in_width = size.in_width / layout.sub_x, in_height = size.in_height / layout.sub_y;
+				const size_t out_width = size.out_width / layout.sub_x, out_height = size.out_height / layout.sub_y;
+				const size_t input_size = in_width * layout.components, output_size = out_width * layout.components;
+				const auto in = random_image(in_width, in_height, input_size, 0);
+				const double siting_y = layout.centered_y ? (layout.sub_y - 1) / 2.0 : 0.0;
+				std::vector<std::vector<std::pair<size_t, double>>> plane_vertical(out_height), horizontal(output_size);
+				for (size_t y = 0; y < out_height; ++y)
+					plane_vertical[y] = reference_weights(filter, in_height, out_height, layout.sub_y, siting_y, y);
+				for (size_t i = 0; i < output_size; ++i) {
+					horizontal[i] = reference_weights(filter, in_width, out_width, layout.sub_x, 0.0, i / layout.components);
+					for (auto& tap: horizontal[i])
+						tap.first = tap.first * layout.components + i % layout.components;
+				}
+				const auto expected = reference_filter(in, out_width, out_height, output_size, plane_vertical, horizontal);
+
+				filter_table_t vertical_table, horizontal_table;
+				std::vector<filter_channel_t> channels(layout.components);
+				build_filter_table(vertical_table, filter, in_height, out_height, layout.centered_y ? 1 : layout.sub_y);
+				for (size_t c = 0; c < layout.components; ++c) {
+					build_filter_table(channels[c].table, filter, in_width, out_width, layout.sub_x);
+					channels[c].stride = layout.components;
+					channels[c].offset = c;
+				}
+				merge_filter_channels(horizontal_table, channels, output_size);
+				for (const auto& name: names) {
+					set_scale_kernels(name);
+					image_t out{out_width, out_height, output_size, std::vector<uint8_t>(output_size * out_height)};
+					scale_image_filtered(in, out, vertical_table, horizontal_table, input_size);
+					if (!compare_filtered(out, expected)) {
+						std::fprintf(stderr, "Filter %s %s %zux%zu -> %zux%zu differs from the reference with %s kernels\n", get_filter_name(filter),
+								plane.name, size.in_width, size.in_height, size.out_width, size.out_height, name.c_str());
+						++check_failures();
+					}
+				}
+			}
+		}
+	}
+}
+
+// Integer ratio kernels of Scale::scale_image_integer. Exact K:1 downscales average K x K blocks of every channel with rounding,
+// 2x upscales replicate every sample. Chroma of packed 4:2:2 formats is averaged and replicated in pairs of pixels.
+void check_integer() {
+	const struct {
+		size_t width, height;
+	} sizes[] = {{2, 2}, {10, 6}, {64, 36}, {34, 17}};
+	for (const auto& size: sizes) {
+		for (size_t ratio: {0, 2, 3, 4}) {
+			// Ratio 0 stands for the 2x upscale
+			const size_t in_width = ratio ? ratio * size.width : size.width, in_height = ratio ? ratio * size.height : size.height;
+			const size_t out_width = ratio ? size.width : 2 * size.width, out_height = ratio ? size.height : 2 * size.height;
+			auto scale = [&](const image_t& in, image_t& out, size_t input_size, const std::vector<integer_channel_t>& channels) {
+				if (ratio) {
+					std::vector<uint16_t> sums(input_size);
+					for (size_t line = 0; line < out.height; ++line)
+						downscale_line(out.line(line), in.line(line * ratio), in.stride, input_size, sums.data(), channels, ratio);
+				} else {
+					for (size_t line = 0; line < in.height; ++line) {
+						upscale_line(out.line(2 * line), in.line(line), channels);
+						std::copy(out.line(2 * line), out.line(2 * line) + out.stride, out.line(2 * line + 1));
+					}
+				}
+			};
+			// Value of output byte i of line y, channel samples are at offset + index * stride of the source line
+			auto reference = [&](const image_t& in, size_t y, size_t index, size_t stride, size_t offset) {
+				if (!ratio)
+					return in.line(y / 2)[index / 2 * stride + offset];
+				size_t sum = ratio * ratio / 2;
+				for (size_t n = 0; n < ratio; ++n) {
+					for (size_t m = 0; m < ratio; ++m)
+						sum += in.line(y * ratio + n)[(index * ratio + m) * stride + offset];
+				}
+				return static_cast<uint8_t>(sum / (ratio * ratio));
+			};
+
+			for (auto layout: layouts) {
+				const size_t pixel_size = get_pixel_size(layout);
+				if (pixel_size == 2 && (in_width % 2 || out_width % 2))
+					continue;
+				const size_t input_size = pixel_size * in_width, output_size = pixel_size * out_width;
+				const auto in = random_image(in_width, in_height, input_size, 0);
+				image_t out{out_width, out_height, output_size, std::vector<uint8_t>(output_size * out_height)};
+				scale(in, out, input_size, get_integer_channels(layout, in_width));
+				bool same = true;
+				for (size_t y = 0; y < out_height; ++y) {
+					for (size_t i = 0; i < output_size; ++i) {
+						const auto sample = get_channel_sample(layout, i);
+						same = same && out.line(y)[i] == reference(in, y, sample.index, sample.stride, sample.offset);
+					}
+				}
+				if (!same) {
+					std::fprintf(stderr, "Integer %s %zux%zu -> %zux%zu differs from the reference\n", get_layout_name(layout), in_width, in_height,
+							out_width, out_height);
+					++check_failures();
+				}
+			}
+
+			for (const auto& plane: plane_cases) {
+				const auto& layout = plane.layout;
+				// 16 bit planes are always scaled bilinearly
+				if (layout.sample_size != 1)
+					continue;
+				const size_t plane_in_width = in_width / layout.sub_x, plane_in_height = in_height / layout.sub_y;
+				const size_t plane_out_width = out_width / layout.sub_x, plane_out_height = out_height / layout.sub_y;
+				// Scale falls back to the other paths when the subsampled planes don't keep the ratio
+				if (ratio ? plane_in_width != ratio * plane_out_width || plane_in_height != ratio * plane_out_height
+						: plane_out_width != 2 * plane_in_width || plane_out_height != 2 * plane_in_height)
+					continue;
+				const size_t input_size = plane_in_width * layout.components, output_size = plane_out_width * layout.components;
+				const auto in = random_image(plane_in_width, plane_in_height, input_size, 0);
+				image_t out{plane_out_width, plane_out_height, output_size, std::vector<uint8_t>(output_size * plane_out_height)};
+				std::vector<integer_channel_t> channels;
+				for (size_t c = 0; c < layout.components; ++c)
+					channels.push_back({layout.components, c, plane_in_width});
+				scale(in, out, input_size, channels);
+				bool same = true;
+				for (size_t y = 0; y < plane_out_height; ++y) {
+					for (size_t i = 0; i < output_size; ++i)
+						same = same && out.line(y)[i] == reference(in, y, i / layout.components, layout.components, i % layout.components);
+				}
+				if (!same) {
+					std::fprintf(stderr, "Integer %s %zux%zu -> %zux%zu differs from the reference\n", plane.name, in_width, in_height, out_width,
+							out_height);
+					++check_failures();
+				}
+			}
+		}
+	}
+}
+
+}
+
+int main() {
+	const auto names = get_scale_kernel_names();
+	check_bilinear(names);
+	check_planar(names);
+	check_filters(names);
+	check_integer();
+	return check_failures() ? 1 : 0;
+}
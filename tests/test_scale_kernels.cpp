@@ -0,0 +1,199 @@
+#include "check.h"
+#include "../src/modules/ndi_scale/ScaleKernels.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Every vectorized kernel set supported by the CPU against the scalar kernels, outputs have to be identical.
+// Inputs end right before an inaccessible page, so any read past the documented spare element crashes the test.
+// Vector loads and gathers aren't instrumented by the sanitizers, the guard page catches them as well.
+
+using namespace yuri::scale;
+
+namespace {
+
+std::mt19937 random_engine(42);
+
+int random_int(int min, int max) {
+	return std::uniform_int_distribution<int>(min, max)(random_engine);
+}
+
+// Buffer of count elements followed by an inaccessible page
+template<class T>
+class guarded_buffer {
+public:
+	explicit guarded_buffer(size_t count) {
+		const size_t page = sysconf(_SC_PAGESIZE);
+		const size_t bytes = count * sizeof(T);
+		size_ = (bytes + page - 1) / page * page + page;
+		void* base = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED)
+			std::abort();
+		base_ = static_cast<uint8_t*>(base);
+		if (mprotect(base_ + size_ - page, page, PROT_NONE))
+			std::abort();
+		data_ = reinterpret_cast<T*>(base_ + size_ - page - bytes);
+	}
+	~guarded_buffer() {
+		munmap(base_, size_);
+	}
+	guarded_buffer(const guarded_buffer&) = delete;
+	guarded_buffer& operator=(const guarded_buffer&) = delete;
+	T* data() {
+		return data_;
+	}
+private:
+	uint8_t* base_;
+	size_t size_;
+	T* data_;
+};
+
+template<class T>
+void fill_random(T* data, size_t count, int min, int max) {
+	for (size_t i = 0; i < count; ++i)
+		data[i] = static_cast<T>(random_int(min, max));
+}
+
+// Weights of taps in 1/16384 with sum of 16384, negative lobes like the bicubic and Lanczos filters have
+std::vector<int16_t> random_weights(size_t taps) {
+	std::vector<int16_t> weights(taps, 0);
+	int sum = 0;
+	for (size_t k = 1; k < taps; ++k) {
+		weights[k] = static_cast<int16_t>(random_int(-1024, 16384 / static_cast<int>(taps)));
+		sum += weights[k];
+	}
+	weights[0] = static_cast<int16_t>(16384 - sum);
+	return weights;
+}
+
+// Runs fn with every vectorized kernel set and compares its output with the output of the scalar kernels
+template<class T>
+void compare_kernels(const std::vector<std::string>& names, size_t size, const std::function<void(T*)>& fn) {
+	std::vector<T> expected(size);
+	{
+		CHECK(set_scale_kernels("scalar"));
+		guarded_buffer<T> dst(size);
+		fn(dst.data());
+		std::copy(dst.data(), dst.data() + size, expected.begin());
+	}
+	for (const auto& name: names) {
+		if (name == "scalar")
+			continue;
+		CHECK(set_scale_kernels(name));
+		guarded_buffer<T> dst(size);
+		fn(dst.data());
+		if (!std::equal(expected.begin(), expected.end(), dst.data())) {
+			std::fprintf(stderr, "%s kernels differ for %zu outputs\n", name.c_str(), size);
+			++check_failures();
+		}
+	}
+}
+
+const size_t sizes[] = {1, 3, 4, 7, 8, 9, 15, 16, 17, 31, 32, 33, 100, 257, 1923};
+
+void check_blend_lines(const std::vector<std::string>& names) {
+	for (auto size: sizes) {
+		guarded_buffer<uint8_t> top(size), bottom(size);
+		fill_random(top.data(), size, 0, 255);
+		fill_random(bottom.data(), size, 0, 255);
+		for (uint32_t y_ratio: {0u, 1u, 127u, 128u, 255u, static_cast<uint32_t>(random_int(0, 255))}) {
+			compare_kernels<uint16_t>(names, size, [&](uint16_t* dst) {
+				blend_lines(dst, top.data(), bottom.data(), size, y_ratio);
+			});
+		}
+	}
+}
+
+void check_scale_line(const std::vector<std::string>& names) {
+	for (auto source_size: sizes) {
+		// Blended line has one spare element, its value mustn't get to the output
+		guarded_buffer<uint16_t> blended(source_size + 1);
+		fill_random(blended.data(), source_size + 1, 0, 255 * 256);
+		for (auto size: sizes) {
+			line_table_t table;
+			for (size_t i = 0; i < size; ++i) {
+				// The last sample is always used, so the gathers read the spare element
+				const uint32_t left = i % 5 ? random_int(0, source_size - 1) : source_size - 1;
+				table.left.push_back(left);
+				table.right.push_back(std::min<uint32_t>(left + random_int(0, 2), source_size - 1));
+				table.weight.push_back(static_cast<uint16_t>(random_int(0, 255)));
+			}
+			compare_kernels<uint8_t>(names, size, [&](uint8_t* dst) {
+				scale_line(dst, blended.data(), table);
+			});
+		}
+	}
+}
+
+void check_filter_lines(const std::vector<std::string>& names) {
+	for (auto size: sizes) {
+		for (size_t taps = 1; taps <= 9; ++taps) {
+			std::vector<std::unique_ptr<guarded_buffer<uint8_t>>> buffers;
+			std::vector<const uint8_t*> lines;
+			for (size_t k = 0; k < taps; ++k) {
+				buffers.emplace_back(new guarded_buffer<uint8_t>(size));
+				fill_random(buffers.back()->data(), size, 0, 255);
+				lines.push_back(buffers.back()->data());
+			}
+			const auto weights = random_weights(taps);
+			compare_kernels<int16_t>(names, size, [&](int16_t* dst) {
+				filter_lines(dst, lines.data(), weights.data(), taps, size);
+			});
+		}
+	}
+}
+
+void check_filter_line(const std::vector<std::string>& names) {
+	for (auto source_size: sizes) {
+		// Source has one spare element, values of the vertical pass are in 1/64 and overshoot a bit
+		guarded_buffer<int16_t> src(source_size + 1);
+		fill_random(src.data(), source_size + 1, -2048, 255 * 64 + 2048);
+		for (auto size: sizes) {
+			for (size_t taps: {1, 2, 4, 7, 12}) {
+				filter_table_t table;
+				table.size = size;
+				table.taps = taps;
+				table.offsets.resize(taps * size);
+				table.weights.resize(taps * size);
+				for (size_t i = 0; i < size; ++i) {
+					const auto weights = random_weights(taps);
+					for (size_t k = 0; k < taps; ++k) {
+						table.offsets[k * size + i] = (i + k) % 5 ? random_int(0, source_size - 1) : source_size - 1;
+						table.weights[k * size + i] = weights[k];
+					}
+				}
+				compare_kernels<uint8_t>(names, size, [&](uint8_t* dst) {
+					filter_line(dst, src.data(), table);
+				});
+			}
+		}
+	}
+}
+
+}
+
+int main() {
+	const auto names = get_scale_kernel_names();
+	CHECK(!names.empty());
+	CHECK(names.front() == scale_kernel_name());
+	CHECK(names.back() == "scalar");
+	CHECK(!set_scale_kernels("unknown"));
+	for (const auto& name: names)
+		std::printf("Checking %s kernels\n", name.c_str());
+
+	check_blend_lines(names);
+	check_scale_line(names);
+	check_filter_lines(names);
+	check_filter_line(names);
+	return check_failures() ? 1 : 0;
+}